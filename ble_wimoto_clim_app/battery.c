@@ -33,7 +33,10 @@
 #include "ble_stack_handler.h"
 #include "ble_bas.h"
 #include "battery.h"
+#include "wimoto_sensors.h"
 #include "app_util.h"
+#include "app_timer.h"
+#include "nrf_soc.h"
 
 #define ADC_REF_VOLTAGE_IN_MILLIVOLTS        1200                                      /**< Reference voltage (in milli volts) used by ADC while doing conversion. */
 #define ADC_PRE_SCALING_COMPENSATION         3                                         /**< The ADC is configured to use VDD with 1/3 prescaling as input. And hence the result of conversion is to be multiplied by 3 to get the actual value of the battery voltage.*/
@@ -49,42 +52,49 @@ extern ble_bas_t                             bas;
 * @retval     Result converted to millivolts.
 */
 #define ADC_RESULT_IN_MILLI_VOLTS(ADC_VALUE)\
-    ((((ADC_VALUE) * ADC_REF_VOLTAGE_IN_MILLIVOLTS) / 255) * ADC_PRE_SCALING_COMPENSATION)
+    ((((ADC_VALUE) * ADC_REF_VOLTAGE_IN_MILLIVOLTS) / ADC_RESULT_MAX) * ADC_PRE_SCALING_COMPENSATION)
 
 
-/**@brief    Function for reading Battery Level and express the result in terms of Percentage
-* @details  This function will fetch the conversion result from the ADC, convert the value into
-*           percentage and send it to peer.
+#define BATTERY_SAMPLE_UNLOADED              0x01                                      /**< Pending sample taken after a radio event. */
+#define BATTERY_SAMPLE_LOADED                0x02                                      /**< Pending sample taken during a radio event. */
+#define BATTERY_UNLOADED_OVERSAMPLING        8                                         /**< Conversions averaged for the unloaded sample, the radio is idle for at least the rest of the interval. */
+#define BATTERY_LOADED_OVERSAMPLING          1                                         /**< One conversion (68 us) for the loaded sample, it must end inside the radio event. */
+#define BATTERY_LOADED_DELAY                 152                                       /**< Delay from the radio active notification to the loaded sample (RTC1 ticks, 4.64 ms), just after the radio starts (NRF_RADIO_NOTIFICATION_DISTANCE_4560US). */
+#define BATTERY_FILTER_WEIGHT                4                                         /**< A new sample moves the filtered voltage by 1/4 of the difference. */
+
+static volatile uint8_t                      m_battery_pending      = 0;               /**< Samples still to be taken, BATTERY_SAMPLE_* */
+static volatile bool                         m_battery_radio_active = false;           /**< Last radio notification */
+static volatile bool                         m_battery_report       = false;           /**< The first unloaded sample is waiting to be sent to the peer */
+static app_timer_id_t                        m_battery_loaded_timer;                   /**< Timer of the loaded sample */
+volatile battery_voltage_t                   m_battery_voltage      = {0, 0};          /**< Filtered voltages, reported in the broadcast scan response */
+
+/**@brief Function for filtering the samples of a voltage.
+*
+* @param[in]  filtered_mv   Filtered voltage, 0 before the first sample.
+* @param[in]  sample_mv     New sample.
+* @retval     New filtered voltage.
 */
-void battery_start(void)
+static uint16_t battery_filter(uint16_t filtered_mv, uint16_t sample_mv)
 {
-    uint32_t err_code;
-    uint8_t  adc_result;
-    uint16_t batt_lvl_in_milli_volts;
-    uint8_t  percentage_batt_lvl;
-
-    // Configure ADC
-    NRF_ADC->CONFIG     = (ADC_CONFIG_RES_8bit                        << ADC_CONFIG_RES_Pos)     |
-    (ADC_CONFIG_INPSEL_SupplyOneThirdPrescaling << ADC_CONFIG_INPSEL_Pos)  |
-    (ADC_CONFIG_REFSEL_VBG                      << ADC_CONFIG_REFSEL_Pos)  |
-    (ADC_CONFIG_PSEL_Disabled                   << ADC_CONFIG_PSEL_Pos)    |
-    (ADC_CONFIG_EXTREFSEL_None                  << ADC_CONFIG_EXTREFSEL_Pos);
-    NRF_ADC->EVENTS_END = 0;
-    NRF_ADC->ENABLE     = ADC_ENABLE_ENABLE_Enabled;
+    if (filtered_mv == 0)
+    {
+        return sample_mv;
+    }
 
+    return (uint16_t)((int32_t)filtered_mv + (((int32_t)sample_mv - (int32_t)filtered_mv) / BATTERY_FILTER_WEIGHT));
+}
 
-    NRF_ADC->TASKS_START = 1;
-    while(NRF_ADC->EVENTS_END == 0);
-    NRF_ADC->EVENTS_END = 0;
-    adc_result = NRF_ADC->RESULT;                                                /* ADC result after conversion*/
-		NRF_ADC->TASKS_STOP = 1;
-	
-    NRF_ADC->ENABLE         = ADC_ENABLE_ENABLE_Disabled;		
 
+/**@brief Function for sending the battery level of an unloaded voltage to the peer.
+*
+* @param[in]  unloaded_mv   Filtered unloaded voltage.
+*/
+static void battery_level_report(uint16_t unloaded_mv)
+{
+    uint32_t err_code;
+    uint8_t  percentage_batt_lvl;
 
-    batt_lvl_in_milli_volts = ADC_RESULT_IN_MILLI_VOLTS(adc_result) +
-    DIODE_FWD_VOLT_DROP_MILLIVOLTS;
-    percentage_batt_lvl     = battery_level_in_percent(batt_lvl_in_milli_volts);
+    percentage_batt_lvl = battery_level_in_percent(unloaded_mv);
 
     err_code = ble_bas_battery_level_update(&bas, percentage_batt_lvl);
     if (
@@ -98,8 +108,184 @@ void battery_start(void)
             )
     {
         APP_ERROR_HANDLER(err_code);
-    }		
-    
+    }
+}
+
+
+/**@brief Function for handling the unloaded sample, called from the ADC interrupt.
+*
+* @details The ADC interrupt runs at APP_IRQ_PRIORITY_HIGH and can not call the SoftDevice, the
+*          level of the first sample is sent from SWI3 instead of waiting for the next
+*          battery_start().
+*/
+static void battery_unloaded_handler(uint16_t result)
+{
+    if (m_battery_voltage.unloaded_mv == 0)
+    {
+        m_battery_report = true;
+        NVIC_SetPendingIRQ(SWI3_IRQn);
+    }
+
+    m_battery_voltage.unloaded_mv = battery_filter(m_battery_voltage.unloaded_mv,
+                                                   ADC_RESULT_IN_MILLI_VOLTS(result) + DIODE_FWD_VOLT_DROP_MILLIVOLTS);
+}
+
+
+/**@brief Function for handling the loaded sample, called from the ADC interrupt.
+*/
+static void battery_loaded_handler(uint16_t result)
+{
+    m_battery_voltage.loaded_mv = battery_filter(m_battery_voltage.loaded_mv,
+                                                 ADC_RESULT_IN_MILLI_VOLTS(result) + DIODE_FWD_VOLT_DROP_MILLIVOLTS);
+}
+
+
+/**@brief Function for queuing a sample of the supply voltage.
+*
+* @retval     true if the sample is queued, false if the ADC queue is full.
+*/
+static bool battery_sample(uint8_t samples, adc_evt_handler_t evt_handler)
+{
+    adc_request_t request;
+
+    request.config        = ADC_CONFIG_SUPPLY;
+    request.samples       = samples;
+    request.p_result      = NULL;
+    request.evt_handler   = evt_handler;
+    request.start_handler = NULL;
+
+    return (adc_request(&request) == NRF_SUCCESS);
+}
+
+
+/**@brief Timer handler of the loaded sample, the radio is active.
+*/
+static void battery_loaded_timeout_handler(void * p_context)
+{
+    UNUSED_PARAMETER(p_context);
+
+    if (!battery_sample(BATTERY_LOADED_OVERSAMPLING, battery_loaded_handler))
+    {
+        m_battery_pending |= BATTERY_SAMPLE_LOADED;             /* Retry at the next radio event*/
+    }
+}
+
+
+/**@brief    Software interrupt starting the pending samples after a radio notification
+* @details  The radio notification runs at NRF_APP_PRIORITY_HIGH and can not call the SoftDevice,
+*           so the samples are started from SWI3 at APP_IRQ_PRIORITY_LOW.
+*           1.Radio inactive: the unloaded sample is converted at once, the next radio event is
+*              at least one advertising or connection interval away
+*           2.Radio active: the loaded sample is timed to start just after the radio
+*           3.Also sends the level of the first unloaded sample, pended by the ADC interrupt
+*/
+void SWI3_IRQHandler(void)
+{
+    uint32_t err_code;
+    battery_voltage_t voltage;
+
+    if (m_battery_report)
+    {
+        m_battery_report = false;
+        battery_voltage_get(&voltage);
+        battery_level_report(voltage.unloaded_mv);
+    }
+
+    if (m_battery_radio_active)
+    {
+        if (m_battery_pending & BATTERY_SAMPLE_LOADED)
+        {
+            err_code = app_timer_start(m_battery_loaded_timer, BATTERY_LOADED_DELAY, NULL);
+            if (err_code == NRF_SUCCESS)
+            {
+                m_battery_pending &= ~BATTERY_SAMPLE_LOADED;
+            }
+        }
+    }
+    else if (m_battery_pending & BATTERY_SAMPLE_UNLOADED)
+    {
+        if (battery_sample(BATTERY_UNLOADED_OVERSAMPLING, battery_unloaded_handler))
+        {
+            m_battery_pending &= ~BATTERY_SAMPLE_UNLOADED;
+        }
+    }
+}
+
+
+/**@brief    Function for initializing the battery measurement
+* @details  Creates the timer of the loaded sample and enables SWI3.
+*/
+void battery_init(void)
+{
+    uint32_t err_code;
+
+    err_code = app_timer_create(&m_battery_loaded_timer,
+    APP_TIMER_MODE_SINGLE_SHOT,
+    battery_loaded_timeout_handler);
+    APP_ERROR_CHECK(err_code);
+
+    NVIC_ClearPendingIRQ(SWI3_IRQn);
+    NVIC_SetPriority(SWI3_IRQn, APP_IRQ_PRIORITY_LOW);
+    NVIC_EnableIRQ(SWI3_IRQn);
+}
+
+
+/**@brief    Function for handling the radio notifications
+* @details  Called from the radio notification handler, only records the event and starts
+*           SWI3 if a sample is pending.
+*/
+void battery_on_radio_evt(bool radio_active)
+{
+    m_battery_radio_active = radio_active;
+
+    if (m_battery_pending != 0)
+    {
+        NVIC_SetPendingIRQ(SWI3_IRQn);
+    }
+}
+
+
+/**@brief    Function for reading Battery Level and express the result in terms of Percentage
+* @details  1.Sends the level of the filtered unloaded voltage to the peer, the level does not
+*              drop with the current of the radio
+*           2.Requests a new pair of samples, taken after and during the next radio events. Call
+*              at a low rate, the filter follows the slow discharge of the battery.
+*/
+void battery_start(void)
+{
+    battery_voltage_t voltage;
+
+    battery_voltage_get(&voltage);
+    battery_sample_request();
+
+    if (voltage.unloaded_mv == 0)
+    {
+        return;                                                  /* No sample yet, sent by SWI3 once it lands*/
+    }
+
+    battery_level_report(voltage.unloaded_mv);
+}
+
+
+/**@brief    Function for requesting a new pair of samples without reporting the battery level
+* @details  The samples are taken after and during the next radio events.
+*/
+void battery_sample_request(void)
+{
+    m_battery_pending = BATTERY_SAMPLE_UNLOADED | BATTERY_SAMPLE_LOADED;
+}
+
+
+/**@brief    Function for reading the filtered loaded and unloaded supply voltages
+*/
+void battery_voltage_get(battery_voltage_t * p_voltage)
+{
+    uint8_t nested;
+
+    (void)sd_nvic_critical_region_enter(&nested);              /* The ADC interrupt updates the voltages*/
+    p_voltage->unloaded_mv = m_battery_voltage.unloaded_mv;
+    p_voltage->loaded_mv   = m_battery_voltage.loaded_mv;
+    (void)sd_nvic_critical_region_exit(nested);
 }
 
 /**
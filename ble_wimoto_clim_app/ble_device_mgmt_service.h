@@ -21,6 +21,7 @@
 #include "ble.h"
 #include "ble_srv_common.h"
 #include "ble_date_time.h"
+#include "wimoto.h"
 
 
 /**@brief Device Management Service event type. */
@@ -41,7 +42,8 @@ typedef enum
 {
     BLE_DEVICE_DFU_WRITE,                                                /**< DFU write event. */
     BLE_DEVICE_SWITCH_MODE_WRITE,                                        /**< switch mode char write event. */
-    BLE_DEVICE_TIME_STAMP_WRITE	                                         /**< time stamp write event. */           
+    BLE_DEVICE_TIME_STAMP_WRITE,                                         /**< time stamp write event. */
+    BLE_DEVICE_ADV_POLICY_WRITE                                          /**< broadcast interval policy write event. */           
 } ble_device_write_evt_type_t;
 
 /**@brief Device Management Service value write event. */
@@ -86,9 +88,11 @@ typedef struct ble_device_s
     ble_gatts_char_handles_t          switch_mode_handles;            /**< Handles for Device Firmware Update characteristic. */
     ble_gatts_char_handles_t          dfu_mode_handles;             	/**< Handles for  Mode Switch characteristic. */
     ble_gatts_char_handles_t          time_stamp_handles;             /**< Handles for  time stamp characteristic. */
+    ble_gatts_char_handles_t          adv_policy_handles;             /**< Handles for broadcast interval policy characteristic. */
     uint8_t												    device_dfu_mode_set;            /**< Device Firmware Update mode set **/
     uint8_t												    device_mode_switch_set;   		  /**< Mode Switch mode set **/
     uint8_t												    device_time_stamp_set[7];       /**< time stamp set **/
+    uint8_t                           device_adv_policy_set[ADV_POLICY_CHAR_SIZE]; /**< broadcast interval policy set **/
     uint16_t                          report_ref_handle;              /**< Handle of the Report Reference descriptor. */
     uint16_t                          conn_handle;                    /**< Handle of the current connection (as provided by the BLE stack, is BLE_CONN_HANDLE_INVALID if not in a connection). */
     bool                              is_notification_supported;      /**< TRUE if notification of Device Management is supported.*/
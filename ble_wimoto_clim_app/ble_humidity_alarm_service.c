@@ -22,9 +22,11 @@
 #include "app_util.h"
 #include "wimoto.h"
 #include "wimoto_sensors.h"
+#include "sample_cache.h"
 
 extern bool 	  BROADCAST_MODE;               /*flag used to switch between broadcast and connectable modes defined in main.c*/
 extern bool     CHECK_ALARM_TIMEOUT;          /*Flag to indicate whether to check for alarm conditions defined in connect.c*/
+extern bool     HTU21D_PROFILE_SET;           /*Flag to indicate a new HTU21D resolution profile defined in connect.c*/
 bool HUMS_CONNECTED_STATE=false;              /*This flag indicates whether a client is connected to the peripheral in humidity service*/
 
 /**@brief Function for handling the Connect event.
@@ -245,6 +247,18 @@ static void on_write(ble_hums_t * p_hums, ble_evt_t * p_ble_evt)
             p_hums->write_evt_handler();
         }
 
+        // write event for resolution profile char value. 
+        if (
+                (p_evt_write->handle == p_hums->hum_resolution_handles.value_handle) 
+                && 
+                (p_evt_write->len == 1)
+                )
+        {
+            // update the humidity service structure, the profile is applied from the main loop
+            p_hums->hum_resolution_set =   p_evt_write->data[0];
+            HTU21D_PROFILE_SET         =   true;
+        }
+
 
     }
 }
@@ -529,6 +543,68 @@ static uint32_t hum_alarm_set_char_add(ble_hums_t * p_hums, const ble_hums_init_
     return NRF_SUCCESS;
 }
 
+/**@brief Function for adding the HTU21D resolution profile characteristics.
+*
+* @details The value is one of etHTU21Profile. Lower resolutions convert faster, see HTU21D_SetProfile().
+*
+* @param[in]   p_hums        Humidity Service structure.
+* @param[in]   p_hums_init   Information needed to initialize the service.
+*
+* @return      NRF_SUCCESS on success, otherwise an error code.
+*/
+
+static uint32_t hum_resolution_char_add(ble_hums_t * p_hums, const ble_hums_init_t * p_hums_init)
+{
+    uint32_t            err_code;
+    ble_gatts_char_md_t char_md;
+    ble_gatts_attr_t    attr_char_value;
+    ble_uuid_t          ble_uuid;
+    ble_gatts_attr_md_t attr_md;
+
+    memset(&char_md, 0, sizeof(char_md));
+
+    char_md.char_props.read   = 1;
+    char_md.char_props.write  = 1;
+    char_md.p_char_user_desc  =	NULL;
+    char_md.p_char_pf         = NULL;
+    char_md.p_user_desc_md    = NULL;
+    char_md.p_cccd_md         = NULL;
+    char_md.p_sccd_md         = NULL;
+
+    ble_uuid.type = p_hums->uuid_type;
+    ble_uuid.uuid = CLIMATE_PROFILE_HUMS_RESOLUTION_CHAR_UUID;     
+
+    memset(&attr_md, 0, sizeof(attr_md));
+
+    attr_md.read_perm  = p_hums_init->hums_char_attr_md.read_perm;
+    attr_md.write_perm = p_hums_init->hums_char_attr_md.write_perm;
+    attr_md.vloc       = BLE_GATTS_VLOC_USER;
+    attr_md.rd_auth    = 0;
+    attr_md.wr_auth    = 0;
+    attr_md.vlen       = 0;
+
+    p_hums->hum_resolution_set = HTU21D_GetProfile();
+
+    memset(&attr_char_value, 0, sizeof(attr_char_value));
+
+    attr_char_value.p_uuid       = &ble_uuid;
+    attr_char_value.p_attr_md    = &attr_md;
+    attr_char_value.init_len     = sizeof(uint8_t);
+    attr_char_value.init_offs    = 0;
+    attr_char_value.max_len      = sizeof(uint8_t);
+    attr_char_value.p_value      = &p_hums->hum_resolution_set;
+
+    err_code = sd_ble_gatts_characteristic_add(p_hums->service_handle, &char_md,
+    &attr_char_value,
+    &p_hums->hum_resolution_handles);
+    if (err_code != NRF_SUCCESS)
+    {
+        return err_code;
+    }
+
+    return NRF_SUCCESS;
+}
+
 /**@brief Function for adding the hum_level alarm characteristics.
 *
 * @param[in]   p_hums        Humidity Service structure.
@@ -674,6 +750,12 @@ uint32_t ble_hums_init(ble_hums_t * p_hums, const ble_hums_init_t * p_hums_init)
     {
         return err_code;
     }
+
+    err_code =  hum_resolution_char_add(p_hums, p_hums_init);  /* Add HTU21D resolution profile characteristic*/
+    if (err_code != NRF_SUCCESS)
+    {
+        return err_code;
+    }
     return NRF_SUCCESS;
 
 }
@@ -685,9 +767,20 @@ uint32_t ble_hums_init(ble_hums_t * p_hums, const ble_hums_init_t * p_hums_init)
 * @return      NRF_SUCCESS on success, otherwise an error code.
 */
 uint32_t ble_hums_level_alarm_check(ble_hums_t * p_hums)
+{
+    return ble_hums_level_alarm_update(p_hums, read_hum_level());
+}
+
+/**@brief Function updates the current humidity level with a measured value and checks for alarm condition.
+*
+* @param[in]   p_hums             Humidity Service structure.
+* @param[in]   current_hum_level  Humidity level measured by the application.
+*
+* @return      NRF_SUCCESS on success, otherwise an error code.
+*/
+uint32_t ble_hums_level_alarm_update(ble_hums_t * p_hums, uint16_t current_hum_level)
 {
     uint32_t err_code = NRF_SUCCESS;
-    uint16_t current_hum_level;
     uint8_t  current_hum_level_array[2];
 
     uint16_t hum_level_low_value;					   /*humidity low value set by user as uint16*/
@@ -700,7 +793,6 @@ uint32_t ble_hums_level_alarm_check(ble_hums_t * p_hums)
     uint16_t	len = sizeof(uint8_t);;
     uint16_t len1 = sizeof(current_hum_level_array);
 
-    current_hum_level = read_hum_level(); /* read the current hum_level*/
 
 
     if(current_hum_level != previous_hum_level)  /*Check whether hum_level value has changed*/
@@ -799,6 +891,9 @@ uint32_t ble_hums_level_alarm_check(ble_hums_t * p_hums)
 
 }
 
+static uint16_t       m_current_hum_level = 0x0000; /**< Last humidity sample*/
+static sample_cache_t m_hum_cache;                  /**< Age of the last humidity sample*/
+
 /**@brief Function to read humidity level from htu21d.
 *
 * @param[in]   void
@@ -806,15 +901,31 @@ uint32_t ble_hums_level_alarm_check(ble_hums_t * p_hums)
 */
 uint16_t read_hum_level()   
 {
-    static uint16_t current_hum_level = 0x0000;
+    if (sample_cache_fresh(&m_hum_cache))
+    {
+        return m_current_hum_level;                 /* Reuse the sample of this tick*/
+    }
 
     twi_turn_ON();
-    current_hum_level = eDRV_HTU21_MeasureHumidity();  /* Read Humidity from HTU21D sensor*/
+    m_current_hum_level = eDRV_HTU21_MeasureHumidity();  /* Read Humidity from HTU21D sensor*/
     twi_turn_OFF(); 
+    sample_cache_update(&m_hum_cache);
 
-    return current_hum_level;
+    return m_current_hum_level;
 }	
 
+/**@brief Function to store a humidity level measured without read_hum_level().
+*
+* @details read_hum_level() returns it while it is fresh instead of starting another conversion.
+*
+* @param[in]   current_hum_level   Humidity measured by the HTU21D.
+*/
+void store_hum_level(uint16_t current_hum_level)
+{
+    m_current_hum_level = current_hum_level;
+    sample_cache_update(&m_hum_cache);
+}
+
 
 
 
@@ -78,11 +78,13 @@ typedef struct ble_hums_s
     ble_gatts_char_handles_t      hum_high_level_handles;         /**< Handles for humidity high Level characteristic. */
     ble_gatts_char_handles_t      climate_hum_alarm_set_handles;  /**< Handles for humidity alarm set characteristic. */
     ble_gatts_char_handles_t      climate_hum_alarm_handles;      /**< Handles for humidity alarm characteristic. */
+    ble_gatts_char_handles_t      hum_resolution_handles;         /**< Handles for HTU21D resolution profile characteristic. */
     uint16_t                      report_ref_handle;              /**< Handle of the Report Reference descriptor. */
     uint8_t                       climate_hum_low_level[2];   	  /**< humidity low level for alarm for humidity Service. */
     uint8_t                       climate_hum_high_level[2];      /**< humidity high level for alarm for humidity Service. */
     uint8_t												climate_hum_alarm_set;   	      /**< Alarm set for humidity **/
     uint8_t												climate_hum_alarm;   			      /**< Alarm for humidity **/
+    uint8_t                       hum_resolution_set;             /**< HTU21D resolution profile, one of etHTU21Profile **/
     uint16_t                      conn_handle;                    /**< Handle of the current connection (as provided by the BLE stack, is BLE_CONN_HANDLE_INVALID if not in a connection). */
     bool                          is_notification_supported;      /**< TRUE if notification of Humidity Level is supported. */
 } ble_hums_t;
@@ -128,6 +130,17 @@ void ble_hums_on_ble_evt(ble_hums_t * p_hums, ble_evt_t * p_ble_evt);
 */
 uint32_t ble_hums_level_alarm_check(ble_hums_t *);
 
+/**@brief Function for updating the Humidity level with a value measured by the application.
+*
+* @details Same as ble_hums_level_alarm_check(), for measurements completed asynchronously.
+*
+* @param[in]   p_hums              Humidity Service structure.
+* @param[in]   current_hum_level   Measured humidity level.
+*
+* @return      NRF_SUCCESS on success, otherwise an error code.
+*/
+uint32_t ble_hums_level_alarm_update(ble_hums_t * p_hums, uint16_t current_hum_level);
+
 /**@brief Function to read humidity level from htu21d.
 *
 * @param[in]   void
@@ -135,6 +148,12 @@ uint32_t ble_hums_level_alarm_check(ble_hums_t *);
 */
 uint16_t read_hum_level(void);											/**@brief Function for reading humidity from sensor **/
 
+/**@brief Function to store a humidity level measured without read_hum_level(), returned by it while fresh.
+*
+* @param[in]   current_hum_level   Humidity measured by the HTU21D.
+*/
+void store_hum_level(uint16_t current_hum_level);
+
 #endif // BLE_HUMS_H__
 
 /** @} */
@@ -22,11 +22,13 @@
 #include "ble_srv_common.h"
 #include "app_util.h"
 #include "wimoto_sensors.h"
+#include "sample_cache.h"
 #include "wimoto.h"
 
 bool   LIGHTS_CONNECTED_STATE=false;          /*This flag indicates whether a client is connected to the peripheral or not*/
 extern bool 	  BROADCAST_MODE;               /*Flag used to switch between broadcast and connectable modes defined in main.c*/
 extern bool     CHECK_ALARM_TIMEOUT;          /*Flag to indicate whether to check for alarm conditions defined in connect.c*/
+extern bool     CHECK_LIGHT;                  /*Flag to indicate whether to check for the light alarm defined in connect.c*/
 
 
 /**@brief Function for handling the Connect event.
@@ -61,6 +63,7 @@ static void on_disconnect(ble_lights_t * p_lights, ble_evt_t * p_ble_evt)
 static void write_evt_handler(void)
 {   
     CHECK_ALARM_TIMEOUT = true; 
+    CHECK_LIGHT         = true;                       /* New levels also re-arm the ISL29023 interrupt*/
 }
 
 /**@brief Function for handling the Write event.
@@ -680,6 +683,43 @@ uint32_t ble_lights_init(ble_lights_t * p_lights, const ble_lights_init_t * p_li
 
 }
 
+/**@brief Function for arming the ISL29023 interrupt for the next change of the light alarm.
+*
+* @details The threshold window is the range of light levels of the current alarm state, so INT is
+*          asserted only when the alarm changes: between the levels while no alarm is raised, below
+*          the low level while it is low and above the high level while it is high. The interrupt
+*          is disabled and ISL29023 powered down while the alarm is not set. If arming fails, the
+*          periodic check still detects the alarm.
+*
+* @param[in]   p_lights        Light Service structure.
+* @param[in]   alarm           Current light alarm.
+* @param[in]   low_value       Light low level set by the user.
+* @param[in]   high_value      Light high level set by the user.
+*/
+static void light_interrupt_arm(ble_lights_t * p_lights, uint8_t alarm, uint16_t low_value, uint16_t high_value)
+{
+    twi_turn_ON();
+
+    if (p_lights->climate_light_alarm_set == 0x00)
+    {
+        (void)ISL29023_disable_interrupt();
+    }
+    else if (alarm == SET_ALARM_LOW)
+    {
+        (void)ISL29023_config_interrupt(0x0000, low_value - 1);      /* INT when the light level is back at the low level*/
+    }
+    else if (alarm == SET_ALARM_HIGH)
+    {
+        (void)ISL29023_config_interrupt(high_value + 1, 0xFFFF);     /* INT when the light level is back at the high level*/
+    }
+    else
+    {
+        (void)ISL29023_config_interrupt(low_value, high_value);      /* INT when the light level leaves the levels*/
+    }
+
+    twi_turn_OFF();
+}
+
 /**@brief Function reads and updates the current light_level and checks for alarm condition.
 *
 * @param[in]   p_lights        Light Service structure.
@@ -769,6 +809,8 @@ uint32_t ble_lights_level_alarm_check(ble_lights_t * p_lights)
     }		
 
 
+    light_interrupt_arm(p_lights, alarm, light_level_low_value, light_level_high_value);
+
     if(alarm != p_lights->climate_light_alarm)  /*check whether the alarm value has changed and send the change*/
     {	
 
@@ -805,20 +847,37 @@ uint32_t ble_lights_level_alarm_check(ble_lights_t * p_lights)
 
 
 
+static uint16_t       m_current_light_level = 0x0000; /**< Last light sample*/
+static sample_cache_t m_light_cache;                  /**< Age of the last light sample*/
+
 /**@brief Function to read light_level from isl29023.
 *
 * @param[in]    void
-* @param[out]   uint16_t current_light_level.
+* @param[out]   uint16_t current_light_level in lux.
 */
 uint16_t read_light_level()   
 {
-    static uint16_t current_light_level=0x0000;
+    if (sample_cache_fresh(&m_light_cache))
+    {
+        return m_current_light_level;               /* Reuse the sample of this tick*/
+    }
 
     twi_turn_ON();
-    current_light_level = ISL29023_get_one_time_ALS();
+    m_current_light_level = ISL29023_LUX_INTEGER(ISL29023_get_ALS());   /* Whole lux, last conversion while the interrupt is armed*/
     twi_turn_OFF();
+    sample_cache_update(&m_light_cache);
+
+    return m_current_light_level;
+}
 
-    return current_light_level;
+/**@brief Function to discard the cached light level, the next read_light_level() reads the ISL29023.
+*
+* @details Called on an ISL29023 INT, the cached sample may be from before the light level crossed
+*          the threshold window.
+*/
+void invalidate_light_level(void)
+{
+    sample_cache_invalidate(&m_light_cache);
 }	
 
 
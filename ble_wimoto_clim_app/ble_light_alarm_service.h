@@ -136,6 +136,10 @@ uint32_t ble_lights_level_alarm_check(ble_lights_t *);
 */
 uint16_t read_light_level(void);						
 
+/**@brief Function to discard the cached light level, the next read_light_level() reads the ISL29023.
+*/
+void invalidate_light_level(void);
+
 #endif // BLE_LIGHTS_H__
 
 /** @} */
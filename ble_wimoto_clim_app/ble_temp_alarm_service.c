@@ -24,6 +24,7 @@
 #include "app_util.h"
 #include "wimoto.h"
 #include "wimoto_sensors.h"
+#include "sample_cache.h"
 
 
 bool     	      TEMPS_CONNECTED_STATE=false;  /*Indicates whether the temperature service is connected or not*/
@@ -694,9 +695,19 @@ uint32_t ble_temps_init(ble_temps_t * p_temps, const ble_temps_init_t * p_temps_
 */
 uint32_t ble_temps_level_alarm_check(ble_temps_t * p_temps)
 {
-    uint32_t err_code = NRF_SUCCESS;
+    return ble_temps_level_alarm_update(p_temps, read_temperature());
+}
 
-    uint16_t current_temperature;
+/**@brief Function updates the current temperature with a measured value and checks for alarm condition.
+*
+* @param[in]   p_temps              Temperature Service structure.
+* @param[in]   current_temperature  Temperature measured by the application.
+*
+* @return      NRF_SUCCESS on success, otherwise an error code.
+*/
+uint32_t ble_temps_level_alarm_update(ble_temps_t * p_temps, uint16_t current_temperature)
+{
+    uint32_t err_code = NRF_SUCCESS;
 
     uint8_t  current_temperature_array[2];
 
@@ -711,8 +722,6 @@ uint32_t ble_temps_level_alarm_check(ble_temps_t * p_temps)
     uint16_t  len1 = sizeof(current_temperature_array);
     
 
-    current_temperature = read_temperature();        /* Read the current temperature*/
-
     if(current_temperature != previous_temperature)  /* Check whether temperature value has changed*/
     {
         previous_temperature         = current_temperature;
@@ -810,6 +819,9 @@ uint32_t ble_temps_level_alarm_check(ble_temps_t * p_temps)
 
 }
 
+static uint16_t       m_current_temperature = 0;   /**< Last temperature sample*/
+static sample_cache_t m_temperature_cache;         /**< Age of the last temperature sample*/
+
 /**@brief Function to read temperature from htu21d.
 *
 * @param[in]    void
@@ -817,12 +829,28 @@ uint32_t ble_temps_level_alarm_check(ble_temps_t * p_temps)
 */
 uint16_t read_temperature()   
 {
-    uint16_t current_temperature = 0;
+    if (sample_cache_fresh(&m_temperature_cache))
+    {
+        return m_current_temperature;               /* Reuse the sample of this tick*/
+    }
 
     twi_turn_ON();
-    current_temperature = eDRV_HTU21_MeasureTemperature();
+    m_current_temperature = eDRV_HTU21_MeasureTemperature();
     twi_turn_OFF();
+    sample_cache_update(&m_temperature_cache);
 
-    return current_temperature;
+    return m_current_temperature;
 }	
 
+/**@brief Function to store a temperature measured without read_temperature().
+*
+* @details read_temperature() returns it while it is fresh instead of starting another conversion.
+*
+* @param[in]    current_temperature   Temperature measured by the HTU21D.
+*/
+void store_temperature(uint16_t current_temperature)
+{
+    m_current_temperature = current_temperature;
+    sample_cache_update(&m_temperature_cache);
+}
+
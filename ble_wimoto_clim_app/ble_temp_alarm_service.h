@@ -128,6 +128,17 @@ void ble_temps_on_ble_evt(ble_temps_t * p_bas, ble_evt_t * p_ble_evt);
 */
 uint32_t ble_temps_level_alarm_check(ble_temps_t *);
 
+/**@brief Function for updating the Temperature level with a value measured by the application.
+*
+* @details Same as ble_temps_level_alarm_check(), for measurements completed asynchronously.
+*
+* @param[in]   p_temps               Temperature Service structure.
+* @param[in]   current_temperature   Measured temperature.
+*
+* @return      NRF_SUCCESS on success, otherwise an error code.
+*/
+uint32_t ble_temps_level_alarm_update(ble_temps_t * p_temps, uint16_t current_temperature);
+
 /**@brief Function to read temperature from htu21d.
 *
 * @param[in]    void
@@ -135,6 +146,12 @@ uint32_t ble_temps_level_alarm_check(ble_temps_t *);
 */
 uint16_t read_temperature(void);					
 
+/**@brief Function to store a temperature measured without read_temperature(), returned by it while fresh.
+*
+* @param[in]    current_temperature   Temperature measured by the HTU21D.
+*/
+void store_temperature(uint16_t current_temperature);
+
 #endif // BLE_TEMPS_H__
 
 /** @} */
@@ -49,6 +49,7 @@
 #include "wimoto.h"
 #include "ble_device_mgmt_service.h"
 #include "battery.h"
+#include "benchmark.h"
 
 #define SEND_MEAS_BUTTON_PIN_NO              16                                        /**< Button used for sending a measurement. */
 #define BONDMNGR_DELETE_BUTTON_PIN_NO        17                                        /**< Button used for deleting all bonded masters during startup. */
@@ -61,14 +62,17 @@
 
 #define APP_ADV_INTERVAL                     0x81A                                     /**< The advertising interval (in units of 0.625 ms. This value corresponds to 25 ms). */
 #define APP_ADV_TIMEOUT_IN_SECONDS           0x0000                                    /**< The advertising timeout in units of seconds. */
+#define LIVE_BEACON_ENABLE                   0x01                                       /**< 0x00 - Disabled 0x01 - Enabled, connectable advertising also carries the live sensor readings */
+#define BEACON_DATA_LEN                      6                                          /**< Length of the sensor readings carried in the advertising data. */
 
 #define APP_TIMER_PRESCALER                  0                                          /**< Value of the RTC1 PRESCALER register. */
-#define APP_TIMER_MAX_TIMERS                 5                                          /**< Maximum number of simultaneously created timers. */
+#define APP_TIMER_MAX_TIMERS                 6                                          /**< Maximum number of simultaneously created timers. */
 #define APP_TIMER_OP_QUEUE_SIZE              4                                          /**< Size of timer operation queues. */
 
 #define TEMPERATURE_LEVEL_MEAS_INTERVAL      APP_TIMER_TICKS(1000, APP_TIMER_PRESCALER)/**< temperature level measurement interval (ticks). */
 #define CONNECTED_MODE_TIMEOUT_INTERVAL      APP_TIMER_TICKS(30000, APP_TIMER_PRESCALER)/**< Connected mode timeout interval (ticks). */
 #define SECONDS_INTERVAL                     APP_TIMER_TICKS(1000, APP_TIMER_PRESCALER) /**< seconds measurement interval (ticks). */
+#define BATTERY_POLL_COUNT                   30                                         /**< The battery is measured on every 30th alarm check, one every 2 s (60 s), the samples are timed by the radio notifications. */
 
 #define TEMP_TYPE_AS_CHARACTERISTIC          0                                          /**< Determines if temperature type is given as characteristic (1) or as a field of measurement (0). */
 
@@ -85,7 +89,7 @@
 #define NEXT_CONN_PARAMS_UPDATE_DELAY        APP_TIMER_TICKS(5000, APP_TIMER_PRESCALER) /**< Time between each call to sd_ble_gap_conn_param_update after the first (30 seconds). */
 #define MAX_CONN_PARAMS_UPDATE_COUNT         3                                          /**< Number of attempts before giving up the connection parameter negotiation. */
 
-#define APP_GPIOTE_MAX_USERS                 1                                          /**< Maximum number of users of the GPIOTE handler. */
+#define APP_GPIOTE_MAX_USERS                 2                                          /**< Maximum number of users of the GPIOTE handler (buttons and ISL29023 INT). */
 
 #define BUTTON_DETECTION_DELAY               APP_TIMER_TICKS(50, APP_TIMER_PRESCALER)   /**< Delay from a GPIOTE event until a button is reported as pushed (in number of timer ticks). */
 
@@ -105,6 +109,12 @@
 static uint16_t                              m_conn_handle = BLE_CONN_HANDLE_INVALID;   /**< Handle of the current connection. */
 static ble_gap_sec_params_t                  m_sec_params;                              /**< Security requirements for this application. */
 static ble_gap_adv_params_t                  m_adv_params;                              /**< Parameters to be passed to the stack when starting advertising. */
+static ble_advdata_t                         m_advdata;                                 /**< Advertising data, kept so that it can be re-encoded with new readings. */
+static ble_advdata_t                         m_srdata;                                  /**< Scan response data. */
+#if (LIVE_BEACON_ENABLE == FEATURE_ENABLED)
+static ble_advdata_manuf_data_t              m_beacon_manuf_data;                       /**< Manufacturer data carrying the live sensor readings. */
+static uint8_t                               m_beacon_data[BEACON_DATA_LEN];            /**< Live sensor readings. */
+#endif
 static ble_temps_t                           m_temps;                                   /**< Structure used to identify the temperature value service. */
 static ble_lights_t                          m_lights;                                  /**< Structure used to identify the light alarm service. */
 static ble_hums_t                            m_hums;                                    /**< Structure used to identify the humidity alarm service. */
@@ -117,13 +127,19 @@ static app_timer_id_t                        real_time_timer;
 
 uint8_t 																		 battery_level=0; 
 ble_date_time_t                              m_time_stamp;                              /**< Time stamp. */
+uint32_t                                     m_uptime_seconds = 0;                      /**< Seconds since power on, counted in both modes. */
+volatile uint32_t                            m_sample_conversions = 0;                  /**< Sensor conversions done by the read functions, see sample_cache.h. */
+volatile uint32_t                            m_sample_cache_hits = 0;                   /**< Sensor conversions saved by the sample cache. */
 
 bool 																				 ENABLE_DATA_LOG=false;											/**< Flag to enable data logger */
 bool 																				 READ_DATA=false;
 bool 																				 START_DATA_READ=true;											/**<flag to start data logging*/
 bool 																				 TX_COMPLETE=false;
 bool                                         TIME_SET = false;                          /**< Flag to indicate user set time*/
+bool                                         HTU21D_PROFILE_SET = false;                /**< Flag to indicate a new HTU21D resolution profile written by the user*/
 bool                                         CHECK_ALARM_TIMEOUT=false;                 /**< Flag to indicate whether to check for alarm conditions*/
+static uint8_t                               m_battery_poll_count = BATTERY_POLL_COUNT; /**< Alarm checks since the last battery measurement*/
+bool                                         CHECK_LIGHT=false;                         /**< Flag to indicate whether to check for the light alarm, set on ISL29023 INT and level writes*/
 bool                                         DATA_LOG_CHECK=false;
 
 extern bool 	                               BROADCAST_MODE;                            /**< Flag used to switch between broacast and connectable modes*/    
@@ -135,6 +151,10 @@ extern bool                                  DEVICE_CONNECTED_STATE;
 extern bool																	 DLOGS_CONNECTED_STATE;                     /**< This flag indicates whether data logging service is in connected state*/ 
 
 volatile bool                                m_radio_event = false;                     /*This flag indicates a radio event*/ 
+static volatile bool                         m_htu21d_measuring = false;                /**< Set while the HTU21D conversions of an alarm check are in progress*/
+static volatile bool                         m_htu21d_measure_done = false;             /**< Set once the temperature and humidity conversions of an alarm check have completed*/
+static uint16_t                              m_htu21d_temperature;                      /**< Temperature of the last completed HTU21D measurement*/
+static uint16_t                              m_htu21d_humidity;                         /**< Humidity of the last completed HTU21D measurement*/
 
 static void device_init(void);
 static void temps_init(void);
@@ -187,9 +207,57 @@ static void app_error_handler(uint32_t error_code, uint32_t line_num, const uint
 app_error_handler(DEAD_BEEF, line_num, p_file_name);
 }*/
 
-/**@brief Function for performing check for the alarm condition.
+/**@brief Function for handling a completed HTU21D measurement.
+*
+* @details Called by HTU21D_MeasureProcess() in the main loop with TWI on. The humidity conversion
+*          is chained to the temperature conversion, and the main loop updates the services once
+*          both have completed.
 */
-static void alarm_check(void)
+static void htu21d_measure_handler(etHTU21MeasureType type, uint16_t result)
+{
+    if (type == TEMP)
+    {
+        m_htu21d_temperature = result;
+        if (result != 0)
+        {
+            store_temperature(result);                      /* Shared with the logger and the beacon, a failed read is not*/
+        }
+        if (HTU21D_MeasureAsync(HUMIDITY, htu21d_measure_handler) == NRF_SUCCESS)
+        {
+            return;                                         /* Completes on the humidity conversion*/
+        }
+        m_htu21d_humidity = 0;                              /* Same value as a failed read*/
+    }
+    else
+    {
+        m_htu21d_humidity = result;
+        if (result != 0)
+        {
+            store_hum_level(result);                        /* Shared with the logger and the beacon, a failed read is not*/
+        }
+    }
+
+    m_htu21d_measuring    = false;
+    m_htu21d_measure_done = true;
+}
+
+/**@brief Function for handling an assertion of the ISL29023 INT pin.
+*
+* @details Runs in the GPIOTE interrupt when the light level has left the threshold window armed
+*          by the light service. The main loop checks the light alarm with a new reading, the
+*          cached one may be from before the crossing.
+*/
+static void isl29023_int_handler(void)
+{
+    invalidate_light_level();
+    CHECK_LIGHT = true;
+}
+
+/**@brief Function for performing check for the light alarm condition.
+*
+* @details Also re-arms the ISL29023 interrupt for the next change of the alarm.
+*/
+static void light_alarm_check(void)
 {
     uint32_t err_code;
 
@@ -201,9 +269,64 @@ static void alarm_check(void)
             )
     {
         APP_ERROR_HANDLER(err_code);
-    } 
+    }
+}
 
-    err_code = ble_temps_level_alarm_check(&m_temps);    /* Check whether the temperature is out of range*/
+/**@brief Function for performing check for the alarm condition.
+*
+* @details The light level is checked right away, it is only converted while the ISL29023
+*          interrupt is not armed. Temperature and humidity are converted by the
+*          HTU21D in no hold master mode while the CPU sleeps. The main loop reads them with
+*          HTU21D_MeasureProcess(), and checks them with htu21d_alarm_check() once
+*          htu21d_measure_handler() has both results.
+*/
+static void alarm_check(void)
+{
+    uint32_t err_code;
+
+    light_alarm_check();
+
+    twi_turn_ON();
+    m_htu21d_measuring = true;
+    err_code = HTU21D_MeasureAsync(TEMP, htu21d_measure_handler);
+    twi_turn_OFF();                                      /* Turned on again to read the result*/
+    if (err_code != NRF_SUCCESS)
+    {
+        m_htu21d_measuring    = false;
+        m_htu21d_temperature  = 0;                       /* Same values as a failed read*/
+        m_htu21d_humidity     = 0;
+        m_htu21d_measure_done = true;
+    }
+}
+
+/**@brief Function for applying the HTU21D resolution profile written by the user.
+*
+* @details An unknown profile, or one the HTU21D did not take, is replaced in the characteristic
+*          by the profile in use.
+*/
+static void htu21d_profile_apply(void)
+{
+    uint16_t len = sizeof(uint8_t);
+    bool     profile_set;
+
+    twi_turn_ON();
+    profile_set = HTU21D_SetProfile((etHTU21Profile)m_hums.hum_resolution_set);
+    twi_turn_OFF();
+
+    if (!profile_set)
+    {
+        m_hums.hum_resolution_set = HTU21D_GetProfile();
+        (void)sd_ble_gatts_value_set(m_hums.hum_resolution_handles.value_handle, 0, &len, &m_hums.hum_resolution_set);
+    }
+}
+
+/**@brief Function for checking the alarm condition of the HTU21D readings.
+*/
+static void htu21d_alarm_check(void)
+{
+    uint32_t err_code;
+
+    err_code = ble_temps_level_alarm_update(&m_temps, m_htu21d_temperature);    /* Check whether the temperature is out of range*/
     if ((err_code != NRF_SUCCESS) &&
             (err_code != NRF_ERROR_INVALID_STATE) &&
             (err_code != BLE_ERROR_NO_TX_BUFFERS) &&
@@ -213,7 +336,7 @@ static void alarm_check(void)
         APP_ERROR_HANDLER(err_code);
     }
     
-    err_code = ble_hums_level_alarm_check(&m_hums);     /* Check whether the humidity level is out of range*/ 
+    err_code = ble_hums_level_alarm_update(&m_hums, m_htu21d_humidity);         /* Check whether the humidity level is out of range*/ 
     if ((err_code != NRF_SUCCESS) &&
             (err_code != NRF_ERROR_INVALID_STATE) &&
             (err_code != BLE_ERROR_NO_TX_BUFFERS) &&
@@ -227,6 +350,59 @@ static void alarm_check(void)
 
 
 
+/**@brief Function for comparing a reading with the levels set by the user.
+*
+* @return      RESET_ALARM, SET_ALARM_LOW or SET_ALARM_HIGH.
+*/
+static uint8_t level_alarm_get(uint8_t alarm_set, uint16_t value, uint16_t low_value, uint16_t high_value)
+{
+    if (alarm_set == 0x00)
+    {
+        return RESET_ALARM;
+    }
+    if (value < low_value)
+    {
+        return SET_ALARM_LOW;
+    }
+    if (value > high_value)
+    {
+        return SET_ALARM_HIGH;
+    }
+    return RESET_ALARM;
+}
+
+
+/**@brief Function for getting the alarm state of the readings taken in broadcast mode.
+*
+* @details The readings are compared with the levels and alarm set flags written over GATT in
+*          connectable mode, the same way the alarm services compare them. The alarm services
+*          themselves are not run in broadcast mode, so their alarm values are left unchanged.
+*
+* @param[in]   p_readings   Manufacturer data of the broadcast packet: temperature, light and
+*                           humidity, 2 bytes each MSB first.
+*
+* @return      Alarm byte, one BROADCAST_ALARM() per reading.
+*/
+uint8_t broadcast_alarm_get(const uint8_t * p_readings)
+{
+    uint8_t alarm = RESET_ALARM;
+
+    alarm |= BROADCAST_ALARM(0, level_alarm_get(m_temps.climate_temperature_alarm_set,
+                                                (p_readings[0] << 8) | p_readings[1],
+                                                (m_temps.climate_temperature_low_level[0] << 8) | m_temps.climate_temperature_low_level[1],
+                                                (m_temps.climate_temperature_high_level[0] << 8) | m_temps.climate_temperature_high_level[1]));
+    alarm |= BROADCAST_ALARM(1, level_alarm_get(m_lights.climate_light_alarm_set,
+                                                (p_readings[2] << 8) | p_readings[3],
+                                                (m_lights.climate_light_low_level[0] << 8) | m_lights.climate_light_low_level[1],
+                                                (m_lights.climate_light_high_level[0] << 8) | m_lights.climate_light_high_level[1]));
+    alarm |= BROADCAST_ALARM(2, level_alarm_get(m_hums.climate_hum_alarm_set,
+                                                (p_readings[4] << 8) | p_readings[5],
+                                                (m_hums.climate_hum_low_level[0] << 8) | m_hums.climate_hum_low_level[1],
+                                                (m_hums.climate_hum_high_level[0] << 8) | m_hums.climate_hum_high_level[1]));
+    return alarm;
+}
+
+
 /**@brief Function for performing a climate parmaters level measurement, and  check for the alarm condition.
 */
 
@@ -275,6 +451,7 @@ static void real_time_timeout_handler(void * p_context)
         days_in_month[2] = 28;
     }
     //Increment the time stamp
+    m_uptime_seconds++;
     m_time_stamp.seconds += 1;
     if (m_time_stamp.seconds > 59)
     {
@@ -337,6 +514,13 @@ static void timers_init(void)
     APP_TIMER_MODE_REPEATED,
     real_time_timeout_handler);
     APP_ERROR_CHECK(err_code);
+
+    // Create timer for the HTU21D conversions
+    err_code = HTU21D_MeasureAsyncInit();
+    APP_ERROR_CHECK(err_code);
+
+    battery_init();                                  /* Timer of the battery sample under radio load*/
+
 } 
 
 
@@ -396,17 +580,15 @@ static void gap_params_init(void)
 static void advertising_init(void)
 {
     uint32_t      err_code;
-    ble_advdata_t advdata;
-    ble_advdata_t advdata2;
-    uint8_t       flags = BLE_GAP_ADV_FLAGS_LE_ONLY_GENERAL_DISC_MODE;
+    static uint8_t flags = BLE_GAP_ADV_FLAGS_LE_ONLY_GENERAL_DISC_MODE;
     static uint8_t Vendor_Spec_Uuid[16] = {0xE0, 0x03, 0x56, 0x07, 0xEC, 0x48, 0x4E, 0xD0, 0x9F, 0x3B, 0x54, 0x19, 0xC0, 0x0A, 0x94, 0xFD};
-    ble_advdata_manuf_data_t   manuf_data;
+    static ble_advdata_manuf_data_t manuf_data;
 
     manuf_data.company_identifier = COMPANY_IDENTIFER; 
     manuf_data.data.size          = 16;
     manuf_data.data.p_data        = Vendor_Spec_Uuid;
 
-    ble_uuid_t adv_uuids[] = 
+    static ble_uuid_t adv_uuids[] = 
     {
         {CLIMATE_PROFILE_TEMPS_SERVICE_UUID,									BLE_UUID_TYPE_BLE}, 
         {CLIMATE_PROFILE_HUMS_SERVICE_UUID, 									BLE_UUID_TYPE_BLE},
@@ -414,24 +596,35 @@ static void advertising_init(void)
     };
 
     // Build and set advertising data
-    memset(&advdata, 0, sizeof(advdata));
-
-    advdata.name_type               = BLE_ADVDATA_FULL_NAME;
-    advdata.include_appearance      = true;
-    advdata.flags.size              = sizeof(flags);
-    advdata.flags.p_data            = &flags;
-    advdata.uuids_complete.uuid_cnt = sizeof(adv_uuids) / sizeof(adv_uuids[0]);
-    advdata.uuids_complete.p_uuids  = adv_uuids;
-
-    memset(&advdata2, 0, sizeof(advdata2));
-
-    advdata2.name_type               = BLE_ADVDATA_NO_NAME;
-    advdata2.include_appearance      = false;
-    advdata2.flags.size              = 0;
-    advdata2.p_manuf_specific_data   = &manuf_data; 
-
-
-    err_code = ble_advdata_set(&advdata, &advdata2);
+    memset(&m_advdata, 0, sizeof(m_advdata));
+
+    m_advdata.name_type               = BLE_ADVDATA_FULL_NAME;
+    m_advdata.flags.size              = sizeof(flags);
+    m_advdata.flags.p_data            = &flags;
+
+    memset(&m_srdata, 0, sizeof(m_srdata));
+
+    m_srdata.name_type                = BLE_ADVDATA_NO_NAME;
+    m_srdata.include_appearance       = false;
+    m_srdata.flags.size               = 0;
+    m_srdata.p_manuf_specific_data    = &manuf_data;
+
+#if (LIVE_BEACON_ENABLE == FEATURE_ENABLED)
+    // The sensor readings take the place of the appearance and the service UUIDs, which move to the scan response
+    m_beacon_manuf_data.company_identifier = COMPANY_IDENTIFER;
+    m_beacon_manuf_data.data.size          = sizeof(m_beacon_data);
+    m_beacon_manuf_data.data.p_data        = m_beacon_data;
+
+    m_advdata.p_manuf_specific_data   = &m_beacon_manuf_data;
+    m_srdata.uuids_complete.uuid_cnt  = sizeof(adv_uuids) / sizeof(adv_uuids[0]);
+    m_srdata.uuids_complete.p_uuids   = adv_uuids;
+#else
+    m_advdata.include_appearance      = true;
+    m_advdata.uuids_complete.uuid_cnt = sizeof(adv_uuids) / sizeof(adv_uuids[0]);
+    m_advdata.uuids_complete.p_uuids  = adv_uuids;
+#endif
+
+    err_code = ble_advdata_set(&m_advdata, &m_srdata);
     APP_ERROR_CHECK(err_code);
 
     // Initialize advertising parameters (used when starting advertising)
@@ -445,6 +638,33 @@ static void advertising_init(void)
 }
 
 
+#if (LIVE_BEACON_ENABLE == FEATURE_ENABLED)
+/**@brief Function for refreshing the sensor readings carried in the advertising data.
+*
+* @details The readings go through the sample cache, so the samples of the alarm check are reused.
+*          Must not be called while the HTU21D conversions of an alarm check are in progress.
+*/
+static void beacon_update(void)
+{
+    uint32_t err_code;
+    uint16_t current_temperature    = read_temperature();
+    uint16_t current_light_level    = read_light_level();
+    uint16_t current_humidity_level = read_hum_level();
+
+    // Same layout as the manufacturer data in broadcast mode
+    m_beacon_data[0] = current_temperature >> 8;
+    m_beacon_data[1] = current_temperature & LOWER_BYTE_MASK;
+    m_beacon_data[2] = current_light_level >> 8;
+    m_beacon_data[3] = current_light_level & LOWER_BYTE_MASK;
+    m_beacon_data[4] = current_humidity_level >> 8;
+    m_beacon_data[5] = current_humidity_level & LOWER_BYTE_MASK;
+
+    err_code = ble_advdata_set(&m_advdata, &m_srdata);
+    APP_ERROR_CHECK(err_code);
+}
+#endif
+
+
 /**@brief Function for initializing services that will be used by the application.
 *
 * @details Initialize the Temperature alarm and Device Information services.
@@ -905,7 +1125,12 @@ static void button_event_handler(uint8_t pin_no)
 */
 static void gpiote_init(void)
 {
+    uint32_t err_code;
+
     APP_GPIOTE_INIT(APP_GPIOTE_MAX_USERS);
+
+    err_code = ISL29023_init_interrupt(isl29023_int_handler);   /* Register ISL29023 INT, armed by the light alarm check*/
+    APP_ERROR_CHECK(err_code);
 }
 
 
@@ -991,6 +1216,8 @@ void radio_active_evt_handler(bool radio_active)
 {
     m_radio_event = radio_active;
     ble_flash_on_radio_active_evt(m_radio_event);   /*call the event handler in ble_flash.c*/
+    radio_notification_callback(radio_active);      /* Schedule a refresh of the broadcast packet*/
+    battery_on_radio_evt(radio_active);             /* Start the pending battery samples*/
 }
 
 
@@ -1047,12 +1274,14 @@ static void data_log_check()
         write_data_flash(log_data);	                      /*log the data to flash */
     }
 }
-/**@brief Function for application main entry.
+/**@brief Function for initializing the stack, timers, sensors and services.
+*
+* @details Called once at start-up. Both modes share the SoftDevice, the BLE event dispatch,
+*          Radio Notification, the application timers and the sensor configuration, so
+*          switching modes only swaps the advertising data and parameters.
 */
-void connectable_mode(void)
+void connectable_mode_init(void)
 {
-    uint32_t err_code;
-
     // Initialize.
     ble_stack_init();
     twi_master_init();                     /* Configure twi*/
@@ -1062,21 +1291,49 @@ void connectable_mode(void)
     buttons_init();
     bond_manager_init();
     gap_params_init();
-    advertising_init();
     services_init();
     conn_params_init();
     sec_params_init();
     radio_notification_init();
+#if (HTU21D_CRC_BENCHMARK_ENABLE == FEATURE_ENABLED)
+    HTU21D_CrcBenchmark();                 /* Cycles of the HTU21D CRC, read from the debugger */
+#endif
     twi_turn_OFF();
+}
+
+
+/**@brief Function for application main entry.
+*
+* @details Expects connectable_mode_init() to have been called. Returns once BROADCAST_MODE is
+*          set and no client is connected, with advertising and the measurement timer stopped.
+*/
+void connectable_mode(void)
+{
+    uint32_t err_code;
+
+    gap_params_init();                    /* Restore the name and advertising data replaced in broadcast mode*/
+    advertising_init();
     application_timers_start();           /* Start execution.*/
+#if (LIVE_BEACON_ENABLE == FEATURE_ENABLED)
+    beacon_update();
+#endif
     advertising_start();
 
     // Enter main loop.
     for (;;)
     {
-        if((BROADCAST_MODE) && (!TEMPS_CONNECTED_STATE) && (!LIGHTS_CONNECTED_STATE) && (!HUMS_CONNECTED_STATE)) /*If the broadcast mode flag is true and services are not connected stop advertising and exit*/
+        if((BROADCAST_MODE) && (!m_htu21d_measuring) && (!TEMPS_CONNECTED_STATE) && (!LIGHTS_CONNECTED_STATE) && (!HUMS_CONNECTED_STATE)) /*If the broadcast mode flag is true, the HTU21D is idle and services are not connected stop advertising and exit*/
         {                          
+#if (MODE_SWITCH_BENCHMARK_ENABLE == FEATURE_ENABLED)
+            benchmark_start_prescaled(BENCHMARK_PRESCALER_32US);
+#endif
             sd_ble_gap_adv_stop();		   	/* Stop advertising */
+            err_code = app_timer_stop(sensor_meas_timer);   /* Only the broadcast refresh samples the sensors*/
+            APP_ERROR_CHECK(err_code);
+            twi_turn_ON();
+            (void)ISL29023_disable_interrupt();             /* Broadcast mode compares the readings itself, re-armed by the next alarm check*/
+            twi_turn_OFF();
+            CHECK_LIGHT = true;
             break;
         }
         
@@ -1086,12 +1343,6 @@ void connectable_mode(void)
             sd_nvic_SystemReset();        /* Apply a system reset for jumping into bootloader*/
         }
         
-        if (DATA_LOG_CHECK)
-        {
-            data_log_check();
-            DATA_LOG_CHECK= false;
-        }
-        
         if(READ_DATA)																			    /* If enabled, start sending data to the connected device*/
         {
             err_code=app_timer_stop(sensor_meas_timer);		    /* Stop the timers before start sending the historical data*/
@@ -1109,13 +1360,56 @@ void connectable_mode(void)
             TIME_SET = false;                                 /* Reset the flag*/
             
         }                                                                  
+
+        if (HTU21D_PROFILE_SET && (!m_htu21d_measuring))      /* If set, apply the new resolution profile between conversions*/
+        {
+            htu21d_profile_apply();
+            HTU21D_PROFILE_SET = false;                       /* Reset the flag*/
+        }
         
+        if (CHECK_LIGHT)                                      /* Check for ISL29023 INT or new light levels*/
+        {
+            CHECK_LIGHT=false;                                /* Reset the flag before the check, INT may be asserted again*/
+            light_alarm_check();                              /* Checks for alarm in light service, re-arms INT*/
+#if (LIVE_BEACON_ENABLE == FEATURE_ENABLED)
+            if (!m_htu21d_measuring)                          /* Otherwise refreshed once the HTU21D conversions complete*/
+            {
+                beacon_update();                              /* Refresh the readings in the advertising data*/
+            }
+#endif
+        }
+
         if (CHECK_ALARM_TIMEOUT)                              /* Check for sensor measurement timeout*/
         {
             alarm_check();                                    /* Checks for alarm in all services*/
-            battery_start();		                              /* Measure battery level*/    
+            if (++m_battery_poll_count >= BATTERY_POLL_COUNT)
+            {
+                m_battery_poll_count = 0;
+                battery_start();                             /* Report the battery level, sample it at the next radio events*/
+            }
             CHECK_ALARM_TIMEOUT=false;                        /* Reset the flag*/
         }
+
+        if (HTU21D_MeasureElapsed())                          /* HTU21D conversion time has passed, read it here as TWI is not reentrant*/
+        {
+            twi_turn_ON();
+            HTU21D_MeasureProcess();                          /* Reads the result, htu21d_measure_handler() chains the humidity conversion*/
+            twi_turn_OFF();
+        }
+
+        if (m_htu21d_measure_done)                            /* Temperature and humidity conversions have completed*/
+        {
+            m_htu21d_measure_done = false;
+            htu21d_alarm_check();                             /* Checks for alarm in temperature and humidity services*/
+#if (LIVE_BEACON_ENABLE == FEATURE_ENABLED)
+            beacon_update();                                  /* Refresh the readings in the advertising data*/
+#endif
+            if (DATA_LOG_CHECK)                               /* Log the samples of this alarm check*/
+            {
+                data_log_check();
+                DATA_LOG_CHECK= false;
+            }
+        }
         power_manage(); 
     }
 }
@@ -7,54 +7,75 @@
 
 
 #include "wimoto_sensors.h"
+#include "app_timer.h"
+#include "nrf_error.h"
+#if (HTU21D_CRC_BENCHMARK_ENABLE == FEATURE_ENABLED)
+#include "benchmark.h"
+#endif
 
 
 
+/********************************************************************************************/
+/* PRIVATE VARIABLES																		*/
+/********************************************************************************************/
+/* CRC-8 of every byte value, polynomial x^8 + x^5 + x^4 + 1 (0x131), initial value 0 */
+static const uint8_t m_htu21d_crc_table[256] =
+{
+    0x00, 0x31, 0x62, 0x53, 0xC4, 0xF5, 0xA6, 0x97, 0xB9, 0x88, 0xDB, 0xEA, 0x7D, 0x4C, 0x1F, 0x2E,
+    0x43, 0x72, 0x21, 0x10, 0x87, 0xB6, 0xE5, 0xD4, 0xFA, 0xCB, 0x98, 0xA9, 0x3E, 0x0F, 0x5C, 0x6D,
+    0x86, 0xB7, 0xE4, 0xD5, 0x42, 0x73, 0x20, 0x11, 0x3F, 0x0E, 0x5D, 0x6C, 0xFB, 0xCA, 0x99, 0xA8,
+    0xC5, 0xF4, 0xA7, 0x96, 0x01, 0x30, 0x63, 0x52, 0x7C, 0x4D, 0x1E, 0x2F, 0xB8, 0x89, 0xDA, 0xEB,
+    0x3D, 0x0C, 0x5F, 0x6E, 0xF9, 0xC8, 0x9B, 0xAA, 0x84, 0xB5, 0xE6, 0xD7, 0x40, 0x71, 0x22, 0x13,
+    0x7E, 0x4F, 0x1C, 0x2D, 0xBA, 0x8B, 0xD8, 0xE9, 0xC7, 0xF6, 0xA5, 0x94, 0x03, 0x32, 0x61, 0x50,
+    0xBB, 0x8A, 0xD9, 0xE8, 0x7F, 0x4E, 0x1D, 0x2C, 0x02, 0x33, 0x60, 0x51, 0xC6, 0xF7, 0xA4, 0x95,
+    0xF8, 0xC9, 0x9A, 0xAB, 0x3C, 0x0D, 0x5E, 0x6F, 0x41, 0x70, 0x23, 0x12, 0x85, 0xB4, 0xE7, 0xD6,
+    0x7A, 0x4B, 0x18, 0x29, 0xBE, 0x8F, 0xDC, 0xED, 0xC3, 0xF2, 0xA1, 0x90, 0x07, 0x36, 0x65, 0x54,
+    0x39, 0x08, 0x5B, 0x6A, 0xFD, 0xCC, 0x9F, 0xAE, 0x80, 0xB1, 0xE2, 0xD3, 0x44, 0x75, 0x26, 0x17,
+    0xFC, 0xCD, 0x9E, 0xAF, 0x38, 0x09, 0x5A, 0x6B, 0x45, 0x74, 0x27, 0x16, 0x81, 0xB0, 0xE3, 0xD2,
+    0xBF, 0x8E, 0xDD, 0xEC, 0x7B, 0x4A, 0x19, 0x28, 0x06, 0x37, 0x64, 0x55, 0xC2, 0xF3, 0xA0, 0x91,
+    0x47, 0x76, 0x25, 0x14, 0x83, 0xB2, 0xE1, 0xD0, 0xFE, 0xCF, 0x9C, 0xAD, 0x3A, 0x0B, 0x58, 0x69,
+    0x04, 0x35, 0x66, 0x57, 0xC0, 0xF1, 0xA2, 0x93, 0xBD, 0x8C, 0xDF, 0xEE, 0x79, 0x48, 0x1B, 0x2A,
+    0xC1, 0xF0, 0xA3, 0x92, 0x05, 0x34, 0x67, 0x56, 0x78, 0x49, 0x1A, 0x2B, 0xBC, 0x8D, 0xDE, 0xEF,
+    0x82, 0xB3, 0xE0, 0xD1, 0x46, 0x77, 0x24, 0x15, 0x3B, 0x0A, 0x59, 0x68, 0xFF, 0xCE, 0x9D, 0xAC
+};
+
+static uint32_t           m_htu21d_crc_errors = 0;                    /**< Number of CRC mismatches since power on */
+static etHTU21MeasureType m_htu21d_conversion_type = TEMP;            /**< Type of the last conversion started with HTU21D_StartConversion() */
+
+#if (HTU21D_CRC_BENCHMARK_ENABLE == FEATURE_ENABLED)
+volatile uint32_t m_bench_crc_bitwise_cycles = 0;                     /**< Cycles of the bit-serial CRC of one measurement. */
+volatile uint32_t m_bench_crc_table_cycles   = 0;                     /**< Cycles of the table-driven CRC of one measurement. */
+#endif
+
 /********************************************************************************************/
 /* PRIVATE FUNCTIONS																		*/
 /********************************************************************************************/
 
 /**
 *@brief   Checks for CRC errors
-*@details Function takes the 16 bit data and calculates CRC value from it , checks with the
-*          received CRC value ,if the values matches,a boolean value true is returned
-*          otherwise false
+*@details Function calculates the CRC-8 of the data bytes in the order they were received, with one table
+*          lookup per byte, and checks it with the received CRC value. If the values match a boolean
+*          value true is returned, otherwise the CRC error counter is incremented and false is returned.
+*          The data is not modified
 */
 /*------------------------------------------------------------------------------------------*/
-bool HTU21D_CheckCrc(uint8_t data[], uint8_t nbrOfBytes, uint8_t checksum)
+bool HTU21D_CheckCrc(const uint8_t data[], uint8_t nbrOfBytes, uint8_t checksum)
 /*------------------------------------------------------------------------------------------*/
 {
-    uint8_t crc = 0,_bit,byteCtr;
-    uint8_t swap_variable;
-    swap_variable = data[0];            /*Re-arranging input data for CRC calculation*/
-    data[0]       = data[1];
-    data[1]       = swap_variable;
+    uint8_t crc = 0, byteCtr;
 
     for (byteCtr = 0; byteCtr < nbrOfBytes; ++byteCtr)
     {
-        crc ^= (data[nbrOfBytes-1-byteCtr]);
-        for (_bit = 8; _bit > 0; --_bit)
-        {
-            if (crc & 0x80)
-            {
-                crc = (crc << 1) ^ 0x0131;
-            }
-            else
-            {
-                crc = (crc << 1);
-            }
-        }
+        crc = m_htu21d_crc_table[crc ^ data[byteCtr]];
     }
 
     if (crc != checksum)
     {
+        m_htu21d_crc_errors++;
         return false; /*if there is  CRC error it returns a false value */
     }
-    else
-    {
-        return true;
-    }
 
+    return true;
 }
 
 
@@ -63,57 +84,40 @@ bool HTU21D_CheckCrc(uint8_t data[], uint8_t nbrOfBytes, uint8_t checksum)
 *@brief   Function to read the data using HOLD MASTER mode
 *@details The argument of the function is
 *             (1)Command to trigger what type of measurement
-*         Function reads the 16 bit data along with the 8 bit CRC code and checks for CRC errors(if error checking is enabled) , if no error is found the
-*            16 bit variable is returned
+*         Function reads the 16 bit data along with the 8 bit CRC code and checks for CRC errors(if error checking is enabled). On a CRC
+*            error the measurement is repeated up to HTU21D_CRC_RETRY_COUNT times. If no error is found the 16 bit variable is returned,
+*            otherwise 0
 */
 /*------------------------------------------------------------------------------------------*/
 uint16_t HTU21D_MeasureHM(etHTU21MeasureType eHTU21MeasureType)
 /*------------------------------------------------------------------------------------------*/
 {
-
-    uint8_t CRC_value, reg_val_array[2]={0x00,0x00};
-    uint16_t Reg_value = 0;
-    uint32_t temporary_value = 0;
+    uint8_t  command, attempt, reg_val_array[2];
+    uint32_t temporary_value;
 
     switch(eHTU21MeasureType)
     {
-    case HUMIDITY:  temporary_value = HTU21D_ReadMeasurementValue (TRIG_RH_MEASUREMENT_HM); /*Relative humidity measurement trigger*/
-        CRC_value = (temporary_value & 0x000000FF);                             /* Last 8 bit is CRC */
-        Reg_value = (uint16_t)((temporary_value & 0x00FFFF00) >> 8);            /* RH as 16 bit data(including status bits) */
-        reg_val_array[1]=(uint8_t)Reg_value;
-        reg_val_array[0]=(uint8_t)(Reg_value >> 8);                             /* If CRC checking is enabled check for CRC errors */
-
-        if (HTU21D_CRC_CHECK_ENABLE == FEATURE_ENABLED)
-        {
-            if(false == HTU21D_CheckCrc((uint8_t*)reg_val_array,2,CRC_value))   /* Checks for CRC errors */
-            {
-                return 0;                                                       /* If the returned value is 0 it indicates CRC error */
-            }
-        }
-
+    case HUMIDITY:  command = TRIG_RH_MEASUREMENT_HM;                          /*Relative humidity measurement trigger*/
         break;
+    case TEMP   :   command = TRIG_T_MEASUREMENT_HM;                           /* temperature measurement trigger */
+        break;
+        default      :   return 0;
+    }
 
-    case TEMP   :   temporary_value = HTU21D_ReadMeasurementValue (TRIG_T_MEASUREMENT_HM);  /* temperature measurement trigger */
-        CRC_value =  (temporary_value & 0x000000FF);                            /* Last 8 bit is CRC */
-        Reg_value = ((temporary_value & 0x00FFFF00) >> 8);                      /* T as 16 bit data(including status bits) */
-        reg_val_array[1] = (uint8_t)Reg_value;
-        reg_val_array[0] = (uint8_t)(Reg_value >> 8);
+    for (attempt = 0; attempt <= HTU21D_CRC_RETRY_COUNT; attempt++)
+    {
+        temporary_value  = HTU21D_ReadMeasurementValue(command);
+        reg_val_array[0] = (uint8_t)(temporary_value >> 16);                   /* MSB and LSB of the data, as received */
+        reg_val_array[1] = (uint8_t)(temporary_value >> 8);
 
-        if (HTU21D_CRC_CHECK_ENABLE == FEATURE_ENABLED)                                   /* If CRC checking is enabled check for CRC errors */
+        if ((HTU21D_CRC_CHECK_ENABLE != FEATURE_ENABLED) ||
+            HTU21D_CheckCrc(reg_val_array, 2, (uint8_t)temporary_value))      /* Last 8 bit is CRC */
         {
-            if(false == HTU21D_CheckCrc((uint8_t*)reg_val_array,2,CRC_value))  /* Checks for CRC errors */
-            {
-                return 0;                                                      /* if the returned value is 0 it indicates CRC error */
-            }
+            return (uint16_t)((temporary_value & 0x00FFFF00) >> 8);           /* T or RH as 16 bit data(including status bits) */
         }
-
-        break;
-
-        default      :   return 0;
     }
 
-    return Reg_value;
-
+    return 0;                                                                  /* If the returned value is 0 it indicates CRC error */
 }
 
 /**
@@ -134,9 +138,9 @@ uint32_t HTU21D_ReadMeasurementValue(uint8_t Command_for_activity)
     if (twi_master_transfer(HTU21D_ADDRESS ,(uint8_t*)&Command_for_activity,1,TWI_DONT_ISSUE_STOP))
     {
         if(Command_for_activity == TRIG_RH_MEASUREMENT_HM)
-        nrf_delay_ms(20);
+        nrf_delay_ms(HTU21D_ConversionTimeMs(HUMIDITY));
         else
-        nrf_delay_ms(50);
+        nrf_delay_ms(HTU21D_ConversionTimeMs(TEMP));
         if (twi_master_transfer(HTU21D_ADDRESS | TWI_READ_BIT ,data_buffer ,3 ,TWI_ISSUE_STOP))
         {
             temporary_variable1 = ((data_buffer[0] << 16) | (data_buffer[1]<<8) | data_buffer[2]);
@@ -178,47 +182,46 @@ uint16_t HTU21D_MeasurePOLL(etHTU21MeasureType eHTU21MeasureType)
 
 /**
 *@brief   Function to assist HTU21D_MeasurePOLL function
-*@details Function reads 16 bit data and 8 bit CRC, after that and checks for CRC errors(if error checking is enabled) , if no error is found the
-*            16 bit variable is returned
+*@details Function reads 16 bit data and 8 bit CRC, after that and checks for CRC errors(if error checking is enabled). On a CRC error
+*            the measurement is repeated up to HTU21D_CRC_RETRY_COUNT times. If no error is found the 16 bit variable is returned, otherwise 0
 */
 /*------------------------------------------------------------------------------------------*/
 uint16_t HTU21D_PollMasterTransfer(uint8_t MeasurementType)
 /*------------------------------------------------------------------------------------------*/
 {
+    uint8_t  data_buffer[3];
+    uint8_t  attempt;
+    uint16_t timeout;
 
-    uint8_t CRC_value;
-    uint16_t Reg_value = 0;
-    uint8_t data_buffer[3];
-    uint16_t timeout = 200;  /* 100ms */
-    uint8_t reg_val_array[2]={0x00,0x00};
-
-    if(twi_master_transfer(HTU21D_ADDRESS ,(uint8_t*)&MeasurementType ,1 ,TWI_DONT_ISSUE_STOP))
+    for (attempt = 0; attempt <= HTU21D_CRC_RETRY_COUNT; attempt++)
     {
+        if(!twi_master_transfer(HTU21D_ADDRESS ,(uint8_t*)&MeasurementType ,1 ,TWI_DONT_ISSUE_STOP))
+        {
+            return 0;
+        }
+
+        timeout = 200;  /* 100ms */
         while((--timeout))
         {
             if(twi_master_transfer(HTU21D_ADDRESS | TWI_READ_BIT ,(uint8_t*)data_buffer ,3 ,TWI_ISSUE_STOP))
             {
-                Reg_value = ((data_buffer[0] << 8) | data_buffer[1]);    /* 16 bit reg value */
                 break;
             }
         }
 
-        reg_val_array[1] = (uint8_t)Reg_value;
-        reg_val_array[0] = (uint8_t)(Reg_value >> 8);
-        CRC_value        =  data_buffer[2];                            /* Last 8 bit is CRC   */
-
-        if (HTU21D_CRC_CHECK_ENABLE == FEATURE_ENABLED)                           /* If CRC checking is enabled check for CRC errors */
+        if (timeout == 0)
         {
-            if(false == HTU21D_CheckCrc((uint8_t*)reg_val_array ,2 ,CRC_value))   /* checks for CRC errors */
-            {
-                return 0;                                             /* CRC error occurred */
-            }
+            return 0;                                                 /* conversion did not complete */
         }
 
+        if ((HTU21D_CRC_CHECK_ENABLE != FEATURE_ENABLED) ||
+            HTU21D_CheckCrc(data_buffer ,2 ,data_buffer[2]))            /* Last 8 bit is CRC   */
+        {
+            return ((data_buffer[0] << 8) | data_buffer[1]);          /* if success returns the 16bit register value */
+        }
     }
 
-    return Reg_value;                                                /* if success returns the 16bit register value */
-
+    return 0;                                                         /* CRC error occurred */
 }
 
 /**
@@ -301,6 +304,287 @@ uint16_t eDRV_HTU21_MeasureTemperature()
     return (result);
 }
 
+/**
+*@brief   Function to start a temperature or humidity conversion without waiting for it
+*@details Sends the NO HOLD MASTER trigger command and returns, so other sensors can be used on the
+*           bus while the HTU21D converts. The result is read with HTU21D_ReadConversion() once
+*           HTU21D_ConversionTimeMs() has passed
+*/
+/*------------------------------------------------------------------------------------------*/
+bool HTU21D_StartConversion(etHTU21MeasureType eHTU21MeasureType)
+/*------------------------------------------------------------------------------------------*/
+{
+    uint8_t command;
+
+    command = (eHTU21MeasureType == TEMP) ? TRIG_T_MEASUREMENT_POLL : TRIG_RH_MEASUREMENT_POLL;
+    m_htu21d_conversion_type = eHTU21MeasureType;
+
+    return twi_master_transfer(HTU21D_ADDRESS ,&command ,1 ,TWI_ISSUE_STOP);
+}
+
+/**
+*@brief   Function to read the result of a conversion once, without retrying
+*@details Returns NRF_ERROR_INTERNAL if the read is not acknowledged (still converting) and
+*           NRF_ERROR_INVALID_DATA on a CRC error (if error checking is enabled)
+*/
+/*------------------------------------------------------------------------------------------*/
+static uint32_t HTU21D_ReadResult(uint16_t * p_value)
+/*------------------------------------------------------------------------------------------*/
+{
+    uint8_t data_buffer[3] = {0x00, 0x00, 0x00};
+
+    if (!twi_master_transfer(HTU21D_ADDRESS | TWI_READ_BIT ,data_buffer ,3 ,TWI_ISSUE_STOP))
+    {
+        return NRF_ERROR_INTERNAL;
+    }
+
+    if (HTU21D_CRC_CHECK_ENABLE == FEATURE_ENABLED)                   /* If CRC checking is enabled check for CRC errors */
+    {
+        if(false == HTU21D_CheckCrc(data_buffer ,2 ,data_buffer[2]))
+        {
+            return NRF_ERROR_INVALID_DATA;                            /* CRC error occurred */
+        }
+    }
+
+    *p_value = ((data_buffer[0] << 8) | data_buffer[1]) & ~0x0003;   /* Clearing status bits (0th and 1st bit of 16 bit data)*/
+    return NRF_SUCCESS;
+}
+
+/**
+*@brief   Function to read the result of a conversion started with HTU21D_StartConversion()
+*@details Returns the 16 bit value with the status bits cleared, or 0 if the HTU21D is still 
+*           converting (read is not acknowledged) or on a CRC error (if error checking is enabled).
+*           On a CRC error the conversion is started again and waited for, up to HTU21D_CRC_RETRY_COUNT times
+*/
+/*------------------------------------------------------------------------------------------*/
+uint16_t HTU21D_ReadConversion(void)
+/*------------------------------------------------------------------------------------------*/
+{
+    uint16_t value;
+    uint8_t  attempt;
+
+    for (attempt = 0; attempt <= HTU21D_CRC_RETRY_COUNT; attempt++)
+    {
+        switch (HTU21D_ReadResult(&value))
+        {
+        case NRF_SUCCESS:
+            return value;
+        case NRF_ERROR_INVALID_DATA:
+            if (!HTU21D_StartConversion(m_htu21d_conversion_type))
+            {
+                return 0;
+            }
+            nrf_delay_ms(HTU21D_ConversionTimeMs(m_htu21d_conversion_type));
+            break;
+        default:
+            return 0;
+        }
+    }
+
+    return 0;
+}
+
+
+/********************************************************************************************/
+/* ASYNCHRONOUS MEASUREMENT																	*/
+/********************************************************************************************/
+static app_timer_id_t           m_htu21d_timer_id;                    /**< Timer completing a NO HOLD MASTER measurement */
+static htu21d_measure_handler_t m_htu21d_handler = NULL;              /**< Handler of the measurement in progress, NULL when idle */
+static etHTU21MeasureType       m_htu21d_measure_type;                /**< Type of the measurement in progress */
+static uint8_t                  m_htu21d_retries;                     /**< Conversions repeated after a CRC error */
+static volatile bool            m_htu21d_elapsed = false;             /**< Set by the timer once the conversion time has passed */
+
+/**
+*@brief   Timeout handler of a measurement started with HTU21D_MeasureAsync()
+*@details Runs in the app_timer interrupt and only flags the conversion, the TWI driver is not
+*           reentrant so the result is read by HTU21D_MeasureProcess() in the main loop
+*/
+/*------------------------------------------------------------------------------------------*/
+static void HTU21D_MeasureTimeoutHandler(void * p_context)
+/*------------------------------------------------------------------------------------------*/
+{
+    (void)p_context;
+    m_htu21d_elapsed = true;
+}
+
+/**
+*@brief   Function to check whether HTU21D_MeasureProcess() has a result to read
+*/
+/*------------------------------------------------------------------------------------------*/
+bool HTU21D_MeasureElapsed(void)
+/*------------------------------------------------------------------------------------------*/
+{
+    return m_htu21d_elapsed;
+}
+
+/**
+*@brief   Function to complete a measurement started with HTU21D_MeasureAsync()
+*@details Called from the main loop, which the app_timer interrupt wakes once the conversion time has
+*           passed. TWI must be on. Reads the result and passes it to the handler. On a CRC error the
+*           conversion is started again, up to HTU21D_CRC_RETRY_COUNT times, without blocking.
+*           The driver is idle again before the handler is called, so the handler can start the next measurement
+*/
+/*------------------------------------------------------------------------------------------*/
+void HTU21D_MeasureProcess(void)
+/*------------------------------------------------------------------------------------------*/
+{
+    htu21d_measure_handler_t handler = m_htu21d_handler;
+    uint16_t                 result  = 0;
+    uint32_t                 err_code;
+
+    if ((!m_htu21d_elapsed) || (handler == NULL))
+    {
+        return;
+    }
+    m_htu21d_elapsed = false;
+
+    err_code = HTU21D_ReadResult(&result);
+
+    if ((err_code == NRF_ERROR_INVALID_DATA) &&
+        (m_htu21d_retries < HTU21D_CRC_RETRY_COUNT) &&
+        HTU21D_StartConversion(m_htu21d_measure_type) &&
+        (app_timer_start(m_htu21d_timer_id,
+                         APP_TIMER_TICKS(HTU21D_ConversionTimeMs(m_htu21d_measure_type), HTU21D_APP_TIMER_PRESCALER),
+                         NULL) == NRF_SUCCESS))
+    {
+        m_htu21d_retries++;
+        return;                                                       /* Read again after the repeated conversion */
+    }
+
+    m_htu21d_handler = NULL;
+    handler(m_htu21d_measure_type, (err_code == NRF_SUCCESS) ? result : 0);
+}
+
+/**
+*@brief   Function to create the timer used by HTU21D_MeasureAsync()
+*@details Must be called once after APP_TIMER_INIT, and counts as one of the APP_TIMER_MAX_TIMERS
+*           of the application
+*/
+/*------------------------------------------------------------------------------------------*/
+uint32_t HTU21D_MeasureAsyncInit(void)
+/*------------------------------------------------------------------------------------------*/
+{
+    return app_timer_create(&m_htu21d_timer_id, APP_TIMER_MODE_SINGLE_SHOT, HTU21D_MeasureTimeoutHandler);
+}
+
+/**
+*@brief   Function to measure temperature or humidity without blocking
+*@details Sends the NO HOLD MASTER trigger command and returns. The CPU can sleep and other sensors
+*           can use the bus during the conversion, TWI can be turned off meanwhile. The result is read
+*           by HTU21D_MeasureProcess() in the main loop once the app_timer has timed out, and passed
+*           to the handler there. The HTU21D must not be read otherwise until then.
+*           Returns NRF_ERROR_BUSY if a measurement is in progress and NRF_ERROR_INTERNAL if the
+*           trigger command is not acknowledged
+*/
+/*------------------------------------------------------------------------------------------*/
+uint32_t HTU21D_MeasureAsync(etHTU21MeasureType eHTU21MeasureType, htu21d_measure_handler_t handler)
+/*------------------------------------------------------------------------------------------*/
+{
+    uint32_t err_code;
+    uint32_t conversion_time_ms;
+
+    if (m_htu21d_handler != NULL)
+    {
+        return NRF_ERROR_BUSY;
+    }
+
+    if (!HTU21D_StartConversion(eHTU21MeasureType))
+    {
+        return NRF_ERROR_INTERNAL;
+    }
+
+    conversion_time_ms    = HTU21D_ConversionTimeMs(eHTU21MeasureType);
+    m_htu21d_measure_type = eHTU21MeasureType;
+    m_htu21d_handler      = handler;
+    m_htu21d_retries      = 0;
+    m_htu21d_elapsed      = false;
+
+    err_code = app_timer_start(m_htu21d_timer_id, APP_TIMER_TICKS(conversion_time_ms, HTU21D_APP_TIMER_PRESCALER), NULL);
+    if (err_code != NRF_SUCCESS)
+    {
+        m_htu21d_handler = NULL;
+    }
+
+    return err_code;
+}
+
+/********************************************************************************************/
+/* RESOLUTION PROFILES																		*/
+/********************************************************************************************/
+/* resolution and conversion times of a profile */
+typedef struct
+{
+    uint8_t resolution;                                               /**< Resolution bits of the user register */
+    uint8_t t_conversion_time_ms;                                     /**< Temperature conversion time in ms */
+    uint8_t rh_conversion_time_ms;                                    /**< Humidity conversion time in ms */
+}htu21d_profile_t;
+
+/* conversion times are the datasheet maxima. The HTU21D draws about 450 uA while converting,
+   so the charge of a temperature and humidity pair follows the sum of the two times */
+static const htu21d_profile_t m_htu21d_profiles[HTU21_PROFILE_COUNT] =
+{
+    {HTU21_RES_12_14BIT, 50, 20},                                     /**< ~32 uC, RH time with the margin used in hold master mode */
+    {HTU21_RES_10_13BIT, 25,  5},                                     /**< ~14 uC */
+    {HTU21_RES_8_12BIT,  13,  3},                                     /**< ~7 uC  */
+    {HTU21_RES_11_11BIT,  7,  8}                                      /**< ~7 uC  */
+};
+
+static etHTU21Profile m_htu21d_profile = HTU21_PROFILE_RH12_T14;     /**< Profile in use, the power on default */
+
+/**
+*@brief   Function to set the resolution profile
+*@details Writes the resolution bits of the user register and keeps the other bits. The conversion
+*           times of the profile are used from the next measurement on. Returns false if the profile
+*           is unknown, a NO HOLD MASTER measurement is in progress or the HTU21D does not respond
+*/
+/*------------------------------------------------------------------------------------------*/
+bool HTU21D_SetProfile(etHTU21Profile eHTU21Profile)
+/*------------------------------------------------------------------------------------------*/
+{
+    uint8_t user_reg;
+
+    if ((eHTU21Profile >= HTU21_PROFILE_COUNT) || (m_htu21d_handler != NULL))
+    {
+        return false;
+    }
+
+    user_reg = HTU21D_ReadUserRegister();
+    user_reg = (user_reg & ~HTU21_RES_MASK) | m_htu21d_profiles[eHTU21Profile].resolution;
+
+    if (!HTU21D_WriteToUserRegister(user_reg))
+    {
+        return false;
+    }
+
+    m_htu21d_profile = eHTU21Profile;
+    return true;
+}
+
+/**
+*@brief   Function to get the resolution profile in use
+*/
+/*------------------------------------------------------------------------------------------*/
+etHTU21Profile HTU21D_GetProfile(void)
+/*------------------------------------------------------------------------------------------*/
+{
+    return m_htu21d_profile;
+}
+
+/**
+*@brief   Function to get the conversion time in ms of a measurement at the resolution profile in use
+*/
+/*------------------------------------------------------------------------------------------*/
+uint8_t HTU21D_ConversionTimeMs(etHTU21MeasureType eHTU21MeasureType)
+/*------------------------------------------------------------------------------------------*/
+{
+    if (eHTU21MeasureType == TEMP)
+    {
+        return m_htu21d_profiles[m_htu21d_profile].t_conversion_time_ms;
+    }
+
+    return m_htu21d_profiles[m_htu21d_profile].rh_conversion_time_ms;
+}
+
 /**
 *@brief   Function for Soft reset (Power on reset value)
 */
@@ -323,39 +607,32 @@ bool eDRV_HTU21_Reset(void)
 
 /**
 *@brief   Function to read the user register
-*@details Function reads the user register and checks for CRC errors(if error checking is enabled), if no CRC error occurred the 8 bit
-*           user register data is returned
+*@details The HTU21D sends the user register without a CRC, so only the 8 bit user register data is read and
+*           returned, or 0 if the read is not acknowledged
 */
 /*------------------------------------------------------------------------------------------*/
 uint8_t  HTU21D_ReadUserRegister()
 /*------------------------------------------------------------------------------------------*/
 {
-    uint8_t checksum=0,user_reg_val[1],data_buffer[2];
-    data_buffer[0]  = 0x00;   /* Initializing data buffers used for reception of data */
-    data_buffer[1]  = 0x00;
-    user_reg_val[0] = 0;      /* Register to hold User Register data*/
+    uint8_t command      = USER_REG_R;             /* User register read command*/
+    uint8_t user_reg_val = 0;                      /* Register to hold User Register data*/
 
-    if (twi_master_transfer(HTU21D_ADDRESS ,(uint8_t*)USER_REG_R ,1 ,TWI_DONT_ISSUE_STOP))
+    if (twi_master_transfer(HTU21D_ADDRESS ,&command ,1 ,TWI_DONT_ISSUE_STOP))
     {
-
-        if (twi_master_transfer(HTU21D_ADDRESS | TWI_READ_BIT ,data_buffer ,2 ,TWI_ISSUE_STOP))
-        {
-            user_reg_val[0] = data_buffer[0];
-            checksum        = data_buffer[1];
-        }
-
+        (void)twi_master_transfer(HTU21D_ADDRESS | TWI_READ_BIT ,&user_reg_val ,1 ,TWI_ISSUE_STOP);
     }
 
-    if (HTU21D_CRC_CHECK_ENABLE == FEATURE_ENABLED)   /* If CRC checking is enabled check for CRC errors */
-    {
-        if(false == HTU21D_CheckCrc(user_reg_val,1,checksum))   /* Checks for CRC errors */
-        {
-            return 0;                       /* If there is  CRC error it returns a false value*/
-        }
-    }
-
-    return user_reg_val[0];          /* returns the user register content (if there is no CRC errors) */
+    return user_reg_val;          /* returns the user register content */
+}
 
+/**
+*@brief   Function to get the number of CRC errors since power on
+*/
+/*------------------------------------------------------------------------------------------*/
+uint32_t HTU21D_CrcErrorCount(void)
+/*------------------------------------------------------------------------------------------*/
+{
+    return m_htu21d_crc_errors;
 }
 
 /**
@@ -381,5 +658,58 @@ bool HTU21D_WriteToUserRegister(uint8_t data)
 
 }
 
+#if (HTU21D_CRC_BENCHMARK_ENABLE == FEATURE_ENABLED)
+/**
+*@brief   Bit-serial CRC-8 the driver used before the table, kept as the benchmark reference
+*/
+/*------------------------------------------------------------------------------------------*/
+static uint8_t HTU21D_CrcBitwise(const uint8_t data[], uint8_t nbrOfBytes)
+/*------------------------------------------------------------------------------------------*/
+{
+    uint8_t crc = 0,_bit,byteCtr;
+
+    for (byteCtr = 0; byteCtr < nbrOfBytes; ++byteCtr)
+    {
+        crc ^= data[byteCtr];
+        for (_bit = 8; _bit > 0; --_bit)
+        {
+            if (crc & 0x80)
+            {
+                crc = (crc << 1) ^ 0x0131;
+            }
+            else
+            {
+                crc = (crc << 1);
+            }
+        }
+    }
+
+    return crc;
+}
+
+/**
+*@brief   Function to measure the cycles of the CRC of one measurement
+*@details Checks the datasheet example 0x683A, CRC 0x7C, with the bit-serial reference and with
+*           HTU21D_CheckCrc(), and leaves the cycles in m_bench_crc_bitwise_cycles and
+*           m_bench_crc_table_cycles for reading with the debugger. Uses TIMER1, see benchmark.h
+*/
+/*------------------------------------------------------------------------------------------*/
+void HTU21D_CrcBenchmark(void)
+/*------------------------------------------------------------------------------------------*/
+{
+    static const uint8_t sample[2] = {0x68, 0x3A};
+    volatile uint8_t     crc;
+    volatile bool        crc_ok;
+
+    benchmark_start();
+    crc = HTU21D_CrcBitwise(sample, 2);
+    m_bench_crc_bitwise_cycles = benchmark_stop();
 
+    benchmark_start();
+    crc_ok = HTU21D_CheckCrc(sample, 2, 0x7C);
+    m_bench_crc_table_cycles = benchmark_stop();
 
+    (void)crc;
+    (void)crc_ok;
+}
+#endif
@@ -10,41 +10,23 @@
 
 
 /**
-*@brief Function for ADC initialization
-*/
-void adc_init(void)
-{	
-
-    NRF_ADC->CONFIG = ADC_CONFIG_RES_8bit << ADC_CONFIG_RES_Pos |                                 /*!< 8bit ADC resolution. */ 
-                      ADC_CONFIG_INPSEL_AnalogInputOneThirdPrescaling << ADC_CONFIG_INPSEL_Pos |  /*!< Analog input specified by PSEL with no prescaling used as input for the conversion. */
-                      ADC_CONFIG_REFSEL_SupplyOneThirdPrescaling << ADC_CONFIG_REFSEL_Pos |       /*!< Use internal 1.2V bandgap voltage as reference for conversion. */
-                      (1 << ADC_SOIL_MOISTURE_PIN) << ADC_CONFIG_PSEL_Pos;                        /*!< Use P0.02 as analog input. ) */
-                      NRF_ADC->ENABLE = ADC_ENABLE_ENABLE_Enabled; 
-}
-
-
-/**
-*@brief  Function to read the sensor output value after using ADC (conversion of analog data into digital data using ADC)
-*@retval 8 bit data from the ADC , after conversion 
+*@brief   Function to read the sensor output value after using ADC (conversion of analog data into digital data using ADC)
+*@details The 1Mhz excitation runs only for ONE_MHZ_SETTLE_US and the conversion. TIMER1 starts the
+*         ADC at a fixed phase of the excitation over PPI and the ADC END event stops it, the CPU
+*         sleeps meanwhile.
+*@retval  8 bit data, average of SOIL_MOISTURE_OVERSAMPLING 10 bit conversions
 */
 uint8_t do_soil_moisture_measurement()
 {
 
-    uint8_t adc_result;            /* Result after ADC convertion*/
+    uint16_t adc_result;           /* Result after ADC convertion*/
 
-    adc_init();                    /* Initialize ADC for probe temperature measurement */
-    one_mhz_start();               /* Start 1Mhz timer*/
-    nrf_delay_ms(10); 
+    one_mhz_sync_init();           /* Prepare the 1Mhz wave, started by the ADC driver for each conversion*/
 
-    NRF_ADC->TASKS_START = START_ADC;
-    while(NRF_ADC->EVENTS_END == 0);
-    NRF_ADC->EVENTS_END = STOP_RUNNING_CONVERTION;
-    adc_result = NRF_ADC->RESULT;                   /* ADC result after conversion*/
-    NRF_ADC->TASKS_STOP     = STOP_ADC;             /* Stop ADC */
-    NRF_ADC->ENABLE         = ADC_ENABLE_ENABLE_Disabled;
+    adc_result = adc_measure_triggered(ADC_CONFIG_ANALOG_INPUT(ADC_SOIL_MOISTURE_PIN), SOIL_MOISTURE_OVERSAMPLING, one_mhz_sync_start);
 
-    NRF_TIMER2->TASKS_STOP  = 1; 	                  /* Stop TIMER 2 after conversion*/		
+    one_mhz_stop();                /* Already stopped by the ADC END event, release the resources*/
 
-    return adc_result;		
+    return ADC_RESULT_TO_8BIT(adc_result);
 
 }
@@ -24,11 +24,44 @@
 #ifndef BATTERY_H__
 #define BATTERY_H__
 
+#include <stdint.h>
+#include <stdbool.h>
 
-/**@brief Function for making the ADC start a battery level conversion.
+/**@brief Filtered supply voltage between and during radio events, the difference is the sag
+ *        of the battery under the radio load.
+ */
+typedef struct
+{
+    uint16_t unloaded_mv;                     /**< Supply voltage sampled after a radio event (millivolts), 0 until the first sample. */
+    uint16_t loaded_mv;                       /**< Supply voltage sampled during a radio event (millivolts), 0 until the first sample. */
+} battery_voltage_t;
+
+/**@brief Function for creating the timer of the loaded sample, call after APP_TIMER_INIT.
+ */
+void battery_init(void);
+
+/**@brief Function for reporting the battery level and requesting the next pair of samples,
+ *        the samples are taken at the next radio notifications.
  */
 void battery_start(void);
 
+/**@brief Function for requesting the next pair of samples without reporting the battery level,
+ *        the samples are taken at the next radio notifications.
+ */
+void battery_sample_request(void);
+
+/**@brief Function for passing the radio notifications to the battery measurement.
+ *
+ * @param[in]  radio_active   true before a radio event, false after it.
+ */
+void battery_on_radio_evt(bool radio_active);
+
+/**@brief Function for reading the filtered loaded and unloaded supply voltages.
+ *
+ * @param[out] p_voltage      Filtered voltages.
+ */
+void battery_voltage_get(battery_voltage_t * p_voltage);
+
 #endif // BATTERY_H__
 
 /** @} */
@@ -26,6 +26,7 @@ bool   DFU_ENABLE             = false;                  /* Flah to check whether
 extern ble_date_time_t m_time_stamp;                    /* Time stamp defined in connect.c. */
 extern bool TIME_SET;                                   /* Flag to start time updation, defined in connect.c*/
 extern bool BROADCAST_MODE;                             /*Flag used to switch between broadcast and connectable modes*/   
+extern adv_policy_t m_adv_policy;                       /* Broadcast interval policy defined in broadcast.c*/
 
 
 /**@brief Function for handling the Connect event.
@@ -52,6 +53,50 @@ static void on_disconnect(ble_device_t * p_device, ble_evt_t * p_ble_evt)
     p_device->conn_handle = BLE_CONN_HANDLE_INVALID; 
 }
 
+/**@brief Function for encoding the broadcast interval policy as the characteristic value.
+*
+* @param[out]  p_data    Buffer of ADV_POLICY_CHAR_SIZE bytes.
+*/
+static void adv_policy_encode(uint8_t * p_data)
+{
+    p_data[0] = m_adv_policy.fast_interval >> 8;
+    p_data[1] = m_adv_policy.fast_interval;
+    p_data[2] = m_adv_policy.slow_interval >> 8;
+    p_data[3] = m_adv_policy.slow_interval;
+    p_data[4] = m_adv_policy.threshold >> 8;
+    p_data[5] = m_adv_policy.threshold;
+}
+
+/**@brief Function for applying a broadcast interval policy written by the client.
+*
+* @details The policy is only taken if the fast interval is allowed for non-connectable
+*          advertising and is not above the slow interval. Otherwise the characteristic is
+*          set back to the policy in use.
+*
+* @param[in]   p_device    Device Management Service structure.
+*/
+static void adv_policy_set(ble_device_t * p_device)
+{
+    uint16_t fast_interval = (p_device->device_adv_policy_set[0] << 8) | p_device->device_adv_policy_set[1];
+    uint16_t slow_interval = (p_device->device_adv_policy_set[2] << 8) | p_device->device_adv_policy_set[3];
+    uint16_t threshold     = (p_device->device_adv_policy_set[4] << 8) | p_device->device_adv_policy_set[5];
+    uint16_t len           = ADV_POLICY_CHAR_SIZE;
+
+    if ((fast_interval >= BLE_GAP_ADV_NONCON_INTERVAL_MIN) &&
+        (fast_interval <= slow_interval) &&
+        (slow_interval <= BLE_GAP_ADV_INTERVAL_MAX))
+    {
+        m_adv_policy.fast_interval = fast_interval;
+        m_adv_policy.slow_interval = slow_interval;
+        m_adv_policy.threshold     = threshold;
+    }
+    else
+    {
+        adv_policy_encode(p_device->device_adv_policy_set);
+        (void)sd_ble_gatts_value_set(p_device->adv_policy_handles.value_handle, 0, &len, p_device->device_adv_policy_set);
+    }
+}
+
 /**@brief Function for handling the write event.
 *
 * @param[in]   p_device    Device Management Service structure.
@@ -85,6 +130,9 @@ static void write_evt_handler (ble_device_t * p_device, ble_device_write_evt_t *
     case BLE_DEVICE_TIME_STAMP_WRITE:
         TIME_SET = true;
         break;  
+    case BLE_DEVICE_ADV_POLICY_WRITE:
+        adv_policy_set(p_device);
+        break;
     default:
         break;
     }
@@ -248,6 +296,25 @@ static void on_write(ble_device_t * p_device, ble_evt_t * p_ble_evt)
         // call application event handler
         p_device->write_evt_handler(p_device, &evt);
     }
+
+    /*Write event for broadcast interval policy characteristics value*/
+    if (
+            (p_evt_write->handle == p_device->adv_policy_handles.value_handle)
+            &&
+            (p_evt_write->len == ADV_POLICY_CHAR_SIZE)
+            &&
+            (p_device->write_evt_handler != NULL)
+            )
+    {  
+        ble_device_write_evt_t evt;
+        evt.evt_type           = BLE_DEVICE_ADV_POLICY_WRITE;
+
+        // update the service structure
+        memcpy(p_device->device_adv_policy_set, p_evt_write->data, ADV_POLICY_CHAR_SIZE);
+
+        // call application event handler
+        p_device->write_evt_handler(p_device, &evt);
+    }
 }
 void ble_device_on_ble_evt(ble_device_t * p_device, ble_evt_t * p_ble_evt)
 {
@@ -472,6 +539,66 @@ static uint32_t time_stamp_char_add(ble_device_t * p_device, const ble_device_in
 
 
 
+/**@brief Function for adding the characteristics for the broadcast interval policy.
+*
+* @param[in]   p_device       Device Management Service structure.
+* @param[in]   p_device_init  Information needed to initialize the service.
+*
+* @return      NRF_SUCCESS on success, otherwise an error code.
+*/
+static uint32_t adv_policy_char_add(ble_device_t * p_device, const ble_device_init_t * p_device_init)
+{
+    uint32_t            err_code;
+    ble_gatts_char_md_t char_md;
+    ble_gatts_attr_t    attr_char_value;
+    ble_uuid_t          ble_uuid;
+    ble_gatts_attr_md_t attr_md;
+
+    memset(&char_md, 0, sizeof(char_md));
+
+    char_md.char_props.read   = 1;
+    char_md.char_props.write  = 1;
+    char_md.p_char_user_desc  =	NULL;
+    char_md.p_char_pf         = NULL;
+    char_md.p_user_desc_md    = NULL;
+    char_md.p_cccd_md         = NULL;
+    char_md.p_sccd_md         = NULL;
+
+    ble_uuid.type = p_device->uuid_type;
+    ble_uuid.uuid = GROW_PROFILE_DEVICE_ADV_POLICY_CHAR_UUID;
+
+    memset(&attr_md, 0, sizeof(attr_md));
+
+    attr_md.read_perm  = p_device_init->device_char_attr_md.read_perm;
+    attr_md.write_perm = p_device_init->device_char_attr_md.write_perm;
+    attr_md.vloc       = BLE_GATTS_VLOC_USER;
+    attr_md.rd_auth    = 0;
+    attr_md.wr_auth    = 0;
+    attr_md.vlen       = 0;
+
+    adv_policy_encode(p_device->device_adv_policy_set);
+
+    memset(&attr_char_value, 0, sizeof(attr_char_value));
+
+    attr_char_value.p_uuid       = &ble_uuid;
+    attr_char_value.p_attr_md    = &attr_md;
+    attr_char_value.init_len     = ADV_POLICY_CHAR_SIZE;
+    attr_char_value.init_offs    = 0;
+    attr_char_value.max_len      = ADV_POLICY_CHAR_SIZE;
+    attr_char_value.p_value      = p_device->device_adv_policy_set;
+
+    err_code = sd_ble_gatts_characteristic_add(p_device->service_handle, &char_md,
+    &attr_char_value,
+    &p_device->adv_policy_handles);
+    if (err_code != NRF_SUCCESS)
+    {
+        return err_code;
+    }
+
+    return NRF_SUCCESS;
+}
+
+
 /**@brief Function for initializing the Device management service.
 *
 * @param[in]   p_device        Device Management Service structure.
@@ -527,6 +654,11 @@ uint32_t ble_device_init(ble_device_t * p_device, const ble_device_init_t * p_de
     {
         return err_code;
     }
+    err_code =  adv_policy_char_add(p_device, p_device_init);  /* Add broadcast interval policy characteristic */
+    if (err_code != NRF_SUCCESS)
+    {
+        return err_code;
+    }
 
     return NRF_SUCCESS;
 
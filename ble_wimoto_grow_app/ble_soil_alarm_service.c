@@ -21,6 +21,7 @@
 #include "app_util.h"
 #include "wimoto.h"
 #include "wimoto_sensors.h"
+#include "sample_cache.h"
 
 bool SOILS_CONNECTED_STATE=false;             /*This flag indicates whether a client is connected to the peripheral in soil moisture service*/
 extern bool 	  BROADCAST_MODE;               /*flag used to switch between broadcast and connectable modes defined in main.c*/
@@ -773,8 +774,15 @@ uint32_t ble_soils_level_alarm_check(ble_soils_t * p_soils)
 uint8_t read_soil_mois_level()   
 {
     static uint8_t current_soil_mois_level=0x00;
+    static sample_cache_t soil_mois_cache;
+
+    if (sample_cache_fresh(&soil_mois_cache))
+    {
+        return current_soil_mois_level;             /* Reuse the sample of this tick*/
+    }
 
     current_soil_mois_level = do_soil_moisture_measurement();  /* Read soil moisture level from ADC */
+    sample_cache_update(&soil_mois_cache);
 
     return current_soil_mois_level;
 }	
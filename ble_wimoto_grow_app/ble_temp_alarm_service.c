@@ -24,10 +24,12 @@
 #include "app_util.h"
 #include "wimoto.h"
 #include "wimoto_sensors.h"
+#include "sample_cache.h"
 
 bool     	      TEMPS_CONNECTED_STATE=false;  /*Indicates whether the temperature service is connected or not*/
 extern bool 	  BROADCAST_MODE;               /*flag used to switch between broadcast and connectable modes defined in main.c*/
 extern bool 	  CHECK_ALARM_TIMEOUT;
+extern bool 	  CHECK_TEMPERATURE;
 
 /**@brief Function for handling the Connect event.
 *
@@ -60,6 +62,7 @@ static void on_disconnect(ble_temps_t * p_temps, ble_evt_t * p_ble_evt)
 static void write_evt_handler(void)
 {   
     CHECK_ALARM_TIMEOUT = true; 
+    CHECK_TEMPERATURE   = true;                       /* New levels also re-arm the TMP102 ALERT*/
 }
 /**@brief Function for handling the Write event.
 *
@@ -679,6 +682,67 @@ uint32_t ble_temps_init(ble_temps_t * p_temps, const ble_temps_init_t * p_temps_
 
 }
 
+/**@brief Function for sign extending a 12-bit temperature value.
+*
+* @param[in]   temp_unsigned  Signed 12 bit temperature value received from tmp102.
+*
+* @return      Temperature in 0.0625 degrees C.
+*/
+int16_t temperature_to_signed(uint16_t temp_unsigned)
+{
+    if (temp_unsigned & TWELTH_BIT_SIGN_MASK)       /* Check whether 12th bit is set to find negative values*/
+    {
+        return (int16_t)(temp_unsigned | 0xF000);
+    }
+    return (int16_t)temp_unsigned;
+}
+
+/**@brief Function for arming the TMP102 ALERT for the next change of the temperature alarm.
+*
+* @details TMP102 compares each conversion with a single threshold, so ALERT changes when the
+*          temperature crosses it and the application does not poll for the crossing. Out of
+*          range, the threshold is the level that ends the alarm. In range, it is the nearer of
+*          the two levels, the other one is caught by the periodic check, which also moves the
+*          threshold as the temperature drifts. Without an alarm set, TMP102 stays in
+*          shut-down mode and is read in one-shot mode.
+*
+* @param[in]   p_temps              Temperature Service structure.
+* @param[in]   current_temperature  Signed 12 bit temperature.
+* @param[in]   low_value            Signed 12 bit temperature low value set by user.
+* @param[in]   high_value           Signed 12 bit temperature high value set by user.
+*/
+static void temperature_alert_arm(ble_temps_t * p_temps, int16_t current_temperature, int16_t low_value, int16_t high_value)
+{
+    uint16_t threshold;
+
+    if (p_temps->temperature_alarm_set == 0x00)
+    {
+        threshold = TMP102_ALERT_THRESHOLD_NONE;
+    }
+    else if (current_temperature < low_value)
+    {
+        threshold = (uint16_t)low_value;            /* ALERT changes when the temperature is back at the low value*/
+    }
+    else if ((current_temperature > high_value) ||
+             (((high_value - current_temperature) < (current_temperature - low_value)) && (high_value < TMP102_TEMP_MAX)))
+    {
+        threshold = (uint16_t)(high_value + 1);     /* ALERT changes when the temperature goes above, or back to, the high value*/
+    }
+    else
+    {
+        threshold = (uint16_t)low_value;            /* ALERT changes when the temperature goes below the low value*/
+    }
+
+    if (threshold != TMP102_ALERT_THRESHOLD_NONE)
+    {
+        threshold &= 0x0FFF;
+    }
+
+    twi_turn_ON();
+    (void)config_tmp102_alert_mode(threshold);      /* Not armed on failure, the periodic check still detects the alarm*/
+    twi_turn_OFF();
+}
+
 /**@brief Function reads and updates the current temperature and checks for alarm condition.
 *
 * @param[in]   p_temps        Temperature Service structure.
@@ -746,7 +810,7 @@ uint32_t ble_temps_level_alarm_check(ble_temps_t * p_temps)
 
     // Get the temperature high value set by the user from the service 
     temperature_high_value            = 	(p_temps->temperature_high_level[0])<<8;	/*convert the 8 bit arrays to a 16 bit data*/
-    temperature_high_value 			 			= 	temperature_high_value | (p_temps->temperature_low_level[1]);
+    temperature_high_value 			 			= 	temperature_high_value | (p_temps->temperature_high_level[1]);
     temperature_user_high_value_float	=  	convert_temperature_to_float(temperature_high_value);
 
 
@@ -775,6 +839,11 @@ uint32_t ble_temps_level_alarm_check(ble_temps_t * p_temps)
         alarm = RESET_ALARM;				 /* Reset alarm to 0x00*/
     }		
 
+    temperature_alert_arm(p_temps,
+                          temperature_to_signed(current_temperature),
+                          temperature_to_signed(temperature_low_value),
+                          temperature_to_signed(temperature_high_value));
+
 
     if(alarm != p_temps->temperature_alarm )  /* Check whether the alarm value has changed and send the change*/
     {	
@@ -815,11 +884,18 @@ uint32_t ble_temps_level_alarm_check(ble_temps_t * p_temps)
 */
 uint16_t read_temperature()   
 {
-    uint16_t current_temperature;
+    static uint16_t current_temperature = 0;
+    static sample_cache_t temperature_cache;
+
+    if (sample_cache_fresh(&temperature_cache))
+    {
+        return current_temperature;                 /* Reuse the sample of this tick*/
+    }
 
     twi_turn_ON();
-    current_temperature = get_tmp102_oneshot_temp();
+    current_temperature = get_tmp102_temp();     /* Last conversion while ALERT is armed, one-shot otherwise*/
     twi_turn_OFF();
+    sample_cache_update(&temperature_cache);
 
     return current_temperature;
 }	
@@ -831,19 +907,9 @@ uint16_t read_temperature()
 */
 float convert_temperature_to_float(uint16_t temp_unsigned)
 {
-    int16_t temp_signed;
     float temp_float;
 
-    if(temp_unsigned & TWELTH_BIT_SIGN_MASK)				/* Check whether 12th bit is set to find negative values*/
-    {
-        temp_signed = temp_unsigned | 0xF000;       /* If negative, sign extend the 12 bit unsigned int to 16 bit signed int*/
-    }
-    else
-    {
-        temp_signed = temp_unsigned;
-    }	
-
-    temp_float = (float)temp_signed * TMP102_RESOLUTION;   /* Multiply with resolution of tmp102 (0.0625) to convert to float*/
+    temp_float = (float)temperature_to_signed(temp_unsigned) * TMP102_RESOLUTION;   /* Multiply with resolution of tmp102 (0.0625) to convert to float*/
 
     return temp_float;
 }
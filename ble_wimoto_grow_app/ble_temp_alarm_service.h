@@ -139,6 +139,14 @@ uint16_t read_temperature(void);									 /** Function for reading temperature f
 */
 float    convert_temperature_to_float(uint16_t );  /*function for converting 12-bit temperature to float*/
 
+/**@brief Function for sign extending a 12-bit temperature value.
+*
+* @param[in]   temp_unsigned  Signed 12 bit temperature value received from tmp102.
+*
+* @return      Temperature in 0.0625 degrees C.
+*/
+int16_t  temperature_to_signed(uint16_t temp_unsigned);
+
 #endif // BLE_TEMPS_H__
 
 /** @} */
@@ -48,6 +48,7 @@
 #include "wimoto.h"
 #include "ble_device_mgmt_service.h"
 #include "battery.h"
+#include "benchmark.h"
 
 #define SEND_MEAS_BUTTON_PIN_NO              16                                        /**< Button used for sending a measurement. */
 #define BONDMNGR_DELETE_BUTTON_PIN_NO        17                                        /**< Button used for deleting all bonded masters during startup. */
@@ -60,14 +61,18 @@
 
 #define APP_ADV_INTERVAL                     0x81A                                      /**< The advertising interval (in units of 0.625 ms. This value corresponds to 25 ms). */
 #define APP_ADV_TIMEOUT_IN_SECONDS           0x0000                                     /**< The advertising timeout in units of seconds. */
+#define LIVE_BEACON_ENABLE                   0x01                                       /**< 0x00 - Disabled 0x01 - Enabled, connectable advertising also carries the live sensor readings */
+#define BEACON_DATA_LEN                      5                                          /**< Length of the sensor readings carried in the advertising data. */
 
 #define APP_TIMER_PRESCALER                  0                                          /**< Value of the RTC1 PRESCALER register. */
-#define APP_TIMER_MAX_TIMERS                 5                                          /**< Maximum number of simultaneously created timers. */
+#define APP_TIMER_MAX_TIMERS                 6                                          /**< Maximum number of simultaneously created timers. */
 #define APP_TIMER_OP_QUEUE_SIZE              4                                          /**< Size of timer operation queues. */
 
 #define TEMPERATURE_LEVEL_MEAS_INTERVAL      APP_TIMER_TICKS(2000, APP_TIMER_PRESCALER)/**< temperature level measurement interval (ticks). */
+#define TEMPERATURE_POLL_COUNT               15                                         /**< The temperature is polled on every 15th alarm check (60 s), crossings of the levels are reported by the TMP102 ALERT. */
 #define CONNECTED_MODE_TIMEOUT_INTERVAL      APP_TIMER_TICKS(30000, APP_TIMER_PRESCALER)/**< Connected mode timeout interval (ticks). */
 #define SECONDS_INTERVAL                     APP_TIMER_TICKS(1000, APP_TIMER_PRESCALER) /**< seconds measurement interval (ticks). */
+#define BATTERY_POLL_COUNT                   15                                         /**< The battery is measured on every 15th alarm check, one every 4 s (60 s), the samples are timed by the radio notifications. */
 
 #define TEMP_TYPE_AS_CHARACTERISTIC          0                                          /**< Determines if temperature type is given as characteristic (1) or as a field of measurement (0). */
 
@@ -84,7 +89,7 @@
 #define NEXT_CONN_PARAMS_UPDATE_DELAY        APP_TIMER_TICKS(5000, APP_TIMER_PRESCALER) /**< Time between each call to sd_ble_gap_conn_param_update after the first (30 seconds). */
 #define MAX_CONN_PARAMS_UPDATE_COUNT         3                                          /**< Number of attempts before giving up the connection parameter negotiation. */
 
-#define APP_GPIOTE_MAX_USERS                 1                                          /**< Maximum number of users of the GPIOTE handler. */
+#define APP_GPIOTE_MAX_USERS                 3                                          /**< Maximum number of users of the GPIOTE handler (buttons, TMP102 ALERT and ISL29023 INT). */
 
 #define BUTTON_DETECTION_DELAY               APP_TIMER_TICKS(50, APP_TIMER_PRESCALER)   /**< Delay from a GPIOTE event until a button is reported as pushed (in number of timer ticks). */
 
@@ -104,6 +109,12 @@
 static uint16_t                              m_conn_handle = BLE_CONN_HANDLE_INVALID;   /**< Handle of the current connection. */
 static ble_gap_sec_params_t                  m_sec_params;                              /**< Security requirements for this application. */
 static ble_gap_adv_params_t                  m_adv_params;                              /**< Parameters to be passed to the stack when starting advertising. */
+static ble_advdata_t                         m_advdata;                                 /**< Advertising data, kept so that it can be re-encoded with new readings. */
+static ble_advdata_t                         m_srdata;                                  /**< Scan response data. */
+#if (LIVE_BEACON_ENABLE == FEATURE_ENABLED)
+static ble_advdata_manuf_data_t              m_beacon_manuf_data;                       /**< Manufacturer data carrying the live sensor readings. */
+static uint8_t                               m_beacon_data[BEACON_DATA_LEN];            /**< Live sensor readings. */
+#endif
 static ble_temps_t                           m_temps;                                   /**< Structure used to identify the temperature value service. */
 static ble_lights_t                          m_lights;                                  /**< Structure used to identify the light alarm service. */
 static ble_soils_t                           m_soils;                                   /**< Structure used to identify the humidity alarm service. */
@@ -113,6 +124,9 @@ static app_timer_id_t                        sensor_meas_timer;
 static app_timer_id_t                        real_time_timer;                           /**< Time keeping timer. */
 
 ble_date_time_t                              m_time_stamp;                              /**< Time stamp. */
+uint32_t                                     m_uptime_seconds = 0;                      /**< Seconds since power on, counted in both modes. */
+volatile uint32_t                            m_sample_conversions = 0;                  /**< Sensor conversions done by the read functions, see sample_cache.h. */
+volatile uint32_t                            m_sample_cache_hits = 0;                   /**< Sensor conversions saved by the sample cache. */
 
 uint8_t 																		 battery_level=0; 
 ble_bas_t                             			 bas;                                       /**< Structure used to identify the battery service. */
@@ -123,6 +137,9 @@ bool 																				 READ_DATA=false;
 bool 																				 START_DATA_READ=true;											/**< Flag to start data logging*/
 bool 																				 TX_COMPLETE=false;
 bool                                         CHECK_ALARM_TIMEOUT=false;                 /**< Flag to indicate whether to check for alarm conditions*/
+static uint8_t                               m_battery_poll_count = BATTERY_POLL_COUNT; /**< Alarm checks since the last battery measurement*/
+bool                                         CHECK_TEMPERATURE=false;                   /**< Flag to indicate whether to check for the temperature alarm, set on TMP102 ALERT and level writes*/
+bool                                         CHECK_LIGHT=false;                         /**< Flag to indicate whether to check for the light alarm, set on ISL29023 INT and level writes*/
 bool                                         DATA_LOG_CHECK=false;
 bool                                         TIME_SET = false;                          /**< Flag to indicate user set time*/
 
@@ -189,13 +206,35 @@ app_error_handler(DEAD_BEEF, line_num, p_file_name);
 }*/
 
 
-/**@brief Function for performing check for the alarm condition.
+/**@brief Function for handling a change of the TMP102 ALERT pin.
+*
+* @details Runs in the GPIOTE interrupt when the temperature crosses the threshold armed by the
+*          temperature service. The main loop checks the temperature alarm.
 */
-static void alarm_check(void)
+static void tmp102_alert_handler(void)
+{
+    CHECK_TEMPERATURE = true;
+}
+
+/**@brief Function for handling an assertion of the ISL29023 INT pin.
+*
+* @details Runs in the GPIOTE interrupt when the light level has left the threshold window armed
+*          by the light service. The main loop checks the light alarm.
+*/
+static void isl29023_int_handler(void)
+{
+    CHECK_LIGHT = true;
+}
+
+/**@brief Function for performing check for the light alarm condition.
+*
+* @details Also re-arms the ISL29023 interrupt for the next change of the alarm.
+*/
+static void light_alarm_check(void)
 {
     uint32_t err_code;
 
-    err_code = ble_temps_level_alarm_check(&m_temps);    /* Check whether the temperature is out of range*/
+    err_code = ble_lights_level_alarm_check(&m_lights);  /* Check whether the light level is out of range*/
     if ((err_code != NRF_SUCCESS) &&
             (err_code != NRF_ERROR_INVALID_STATE) &&
             (err_code != BLE_ERROR_NO_TX_BUFFERS) &&
@@ -204,8 +243,17 @@ static void alarm_check(void)
     {
         APP_ERROR_HANDLER(err_code);
     }
+}
 
-    err_code = ble_lights_level_alarm_check(&m_lights);  /* Check whether the light level is out of range*/
+/**@brief Function for performing check for the temperature alarm condition.
+*
+* @details Also re-arms the TMP102 ALERT for the next change of the alarm.
+*/
+static void temperature_alarm_check(void)
+{
+    uint32_t err_code;
+
+    err_code = ble_temps_level_alarm_check(&m_temps);    /* Check whether the temperature is out of range*/
     if ((err_code != NRF_SUCCESS) &&
             (err_code != NRF_ERROR_INVALID_STATE) &&
             (err_code != BLE_ERROR_NO_TX_BUFFERS) &&
@@ -213,7 +261,27 @@ static void alarm_check(void)
             )
     {
         APP_ERROR_HANDLER(err_code);
-    }                       
+    }
+}
+
+/**@brief Function for performing check for the alarm condition.
+*
+* @details The temperature is only polled every TEMPERATURE_POLL_COUNT checks, its alarm is
+*          checked on the TMP102 ALERT. The light alarm is checked on the ISL29023 INT as well.
+*/
+static void alarm_check(void)
+{
+    uint32_t err_code;
+    static uint8_t temperature_poll_count = TEMPERATURE_POLL_COUNT;
+
+    if (++temperature_poll_count >= TEMPERATURE_POLL_COUNT)
+    {
+        temperature_poll_count = 0;
+        temperature_alarm_check();
+    }
+
+    light_alarm_check();                                 /* Reads the last conversion while the ISL29023 interrupt is armed*/
+
     err_code = ble_soils_level_alarm_check(&m_soils);    /* Check whether the soil moisture level is out of range*/  
     if ((err_code != NRF_SUCCESS) &&
             (err_code != NRF_ERROR_INVALID_STATE) &&
@@ -225,6 +293,63 @@ static void alarm_check(void)
     } 
 }
 
+/**@brief Function for comparing a reading with the levels set by the user.
+*
+* @details The comparison is signed, the temperature is sign extended by the caller and the
+*          unsigned 16 bit readings keep their value in 32 bits.
+*
+* @return      RESET_ALARM, SET_ALARM_LOW or SET_ALARM_HIGH.
+*/
+static uint8_t level_alarm_get(uint8_t alarm_set, int32_t value, int32_t low_value, int32_t high_value)
+{
+    if (alarm_set == 0x00)
+    {
+        return RESET_ALARM;
+    }
+    if (value < low_value)
+    {
+        return SET_ALARM_LOW;
+    }
+    if (value > high_value)
+    {
+        return SET_ALARM_HIGH;
+    }
+    return RESET_ALARM;
+}
+
+
+/**@brief Function for getting the alarm state of the readings taken in broadcast mode.
+*
+* @details The readings are compared with the levels and alarm set flags written over GATT in
+*          connectable mode, the same way the alarm services compare them. The alarm services
+*          themselves are not run in broadcast mode, so their alarm values are left unchanged.
+*
+* @param[in]   p_readings   Manufacturer data of the broadcast packet: temperature and light (2
+*                           bytes each MSB first) and soil moisture (1 byte). The temperature and
+*                           its levels are signed 12 bit TMP102 values, see temperature_to_signed().
+*
+* @return      Alarm byte, one BROADCAST_ALARM() per reading.
+*/
+uint8_t broadcast_alarm_get(const uint8_t * p_readings)
+{
+    uint8_t alarm = RESET_ALARM;
+
+    alarm |= BROADCAST_ALARM(0, level_alarm_get(m_temps.temperature_alarm_set,
+                                                temperature_to_signed((p_readings[0] << 8) | p_readings[1]),
+                                                temperature_to_signed((m_temps.temperature_low_level[0] << 8) | m_temps.temperature_low_level[1]),
+                                                temperature_to_signed((m_temps.temperature_high_level[0] << 8) | m_temps.temperature_high_level[1])));
+    alarm |= BROADCAST_ALARM(1, level_alarm_get(m_lights.light_alarm_set,
+                                                (p_readings[2] << 8) | p_readings[3],
+                                                (m_lights.light_low_level[0] << 8) | m_lights.light_low_level[1],
+                                                (m_lights.light_high_level[0] << 8) | m_lights.light_high_level[1]));
+    alarm |= BROADCAST_ALARM(2, level_alarm_get(m_soils.soil_mois_alarm_set,
+                                                p_readings[4],
+                                                m_soils.soil_mois_low_level,
+                                                m_soils.soil_mois_high_level));
+    return alarm;
+}
+
+
 /**@brief Function for performing a Grow Profile parmaters level measurement, and  check for the alarm condition.
 */
 
@@ -276,6 +401,7 @@ static void real_time_timeout_handler(void * p_context)
     }
 
     // Increment time stamp
+    m_uptime_seconds++;
     m_time_stamp.seconds += 1;
     if (m_time_stamp.seconds > 59)
     {
@@ -338,6 +464,9 @@ static void timers_init(void)
     APP_TIMER_MODE_REPEATED,
     real_time_timeout_handler);
     APP_ERROR_CHECK(err_code);	 
+
+    battery_init();                                  /* Timer of the battery sample under radio load*/
+
 } 
 
 
@@ -396,20 +525,18 @@ static void gap_params_init(void)
 static void advertising_init(void)
 {
     uint32_t      err_code;
-    ble_advdata_t advdata;
-    ble_advdata_t advdata2;
-    uint8_t       flags = BLE_GAP_ADV_FLAGS_LE_ONLY_GENERAL_DISC_MODE;
+    static uint8_t flags = BLE_GAP_ADV_FLAGS_LE_ONLY_GENERAL_DISC_MODE;
 
     // Base UUID of Grow Profile
     static uint8_t Vendor_Spec_Uuid[16] = {0xDA, 0xF4, 0x47, 0x06, 0xBF, 0xB0, 0x4D, 0xD8, 0x92, 0x93, 0x62, 0xAF, 0x5F, 0x54, 0x5E, 0x31};
-    ble_advdata_manuf_data_t   manuf_data;
+    static ble_advdata_manuf_data_t manuf_data;
 
     // Setting up base UUID as manufacturing data
     manuf_data.company_identifier = COMPANY_IDENTIFER;                                  /* Company Identifier */
     manuf_data.data.size          = 16;
     manuf_data.data.p_data        = Vendor_Spec_Uuid;  
 
-    ble_uuid_t adv_uuids[] = 
+    static ble_uuid_t adv_uuids[] = 
     {
         {GROW_PROFILE_TEMP_SERVICE_UUID,									BLE_UUID_TYPE_BLE}, 
         {GROW_PROFILE_LIGHTS_SERVICE_UUID, 							  BLE_UUID_TYPE_BLE},
@@ -417,23 +544,35 @@ static void advertising_init(void)
     };
 
     // Build and set advertising data
-    memset(&advdata, 0, sizeof(advdata));
-
-    advdata.name_type               = BLE_ADVDATA_FULL_NAME;
-    advdata.include_appearance      = true;
-    advdata.flags.size              = sizeof(flags);
-    advdata.flags.p_data            = &flags;
-    advdata.uuids_complete.uuid_cnt = sizeof(adv_uuids) / sizeof(adv_uuids[0]);
-    advdata.uuids_complete.p_uuids  = adv_uuids;
-
-    memset(&advdata2, 0, sizeof(advdata2));
-
-    advdata2.name_type               = BLE_ADVDATA_NO_NAME;
-    advdata2.include_appearance      = false;
-    advdata2.flags.size              = 0;
-    advdata2.p_manuf_specific_data   = &manuf_data; 
-
-    err_code = ble_advdata_set(&advdata, &advdata2);
+    memset(&m_advdata, 0, sizeof(m_advdata));
+
+    m_advdata.name_type               = BLE_ADVDATA_FULL_NAME;
+    m_advdata.flags.size              = sizeof(flags);
+    m_advdata.flags.p_data            = &flags;
+
+    memset(&m_srdata, 0, sizeof(m_srdata));
+
+    m_srdata.name_type                = BLE_ADVDATA_NO_NAME;
+    m_srdata.include_appearance       = false;
+    m_srdata.flags.size               = 0;
+    m_srdata.p_manuf_specific_data    = &manuf_data;
+
+#if (LIVE_BEACON_ENABLE == FEATURE_ENABLED)
+    // The sensor readings take the place of the appearance and the service UUIDs, which move to the scan response
+    m_beacon_manuf_data.company_identifier = COMPANY_IDENTIFER;
+    m_beacon_manuf_data.data.size          = sizeof(m_beacon_data);
+    m_beacon_manuf_data.data.p_data        = m_beacon_data;
+
+    m_advdata.p_manuf_specific_data   = &m_beacon_manuf_data;
+    m_srdata.uuids_complete.uuid_cnt  = sizeof(adv_uuids) / sizeof(adv_uuids[0]);
+    m_srdata.uuids_complete.p_uuids   = adv_uuids;
+#else
+    m_advdata.include_appearance      = true;
+    m_advdata.uuids_complete.uuid_cnt = sizeof(adv_uuids) / sizeof(adv_uuids[0]);
+    m_advdata.uuids_complete.p_uuids  = adv_uuids;
+#endif
+
+    err_code = ble_advdata_set(&m_advdata, &m_srdata);
     APP_ERROR_CHECK(err_code);
 
     // Initialize advertising parameters (used when starting advertising)
@@ -448,6 +587,28 @@ static void advertising_init(void)
 }
 
 
+#if (LIVE_BEACON_ENABLE == FEATURE_ENABLED)
+/**@brief Function for refreshing the sensor readings carried in the advertising data.
+*/
+static void beacon_update(void)
+{
+    uint32_t err_code;
+    uint16_t current_temperature    = read_temperature();
+    uint16_t current_light_level    = read_light_level();
+
+    // Same layout as the manufacturer data in broadcast mode
+    m_beacon_data[0] = current_temperature >> 8;
+    m_beacon_data[1] = current_temperature & LOWER_BYTE_MASK;
+    m_beacon_data[2] = current_light_level >> 8;
+    m_beacon_data[3] = current_light_level & LOWER_BYTE_MASK;
+    m_beacon_data[4] = read_soil_mois_level();
+
+    err_code = ble_advdata_set(&m_advdata, &m_srdata);
+    APP_ERROR_CHECK(err_code);
+}
+#endif
+
+
 /**@brief Function for initializing services that will be used by the application.
 *
 * @details Initialize the Temperature alarm and Device Information services.
@@ -900,7 +1061,15 @@ static void button_event_handler(uint8_t pin_no)
 */
 static void gpiote_init(void)
 {
+    uint32_t err_code;
+
     APP_GPIOTE_INIT(APP_GPIOTE_MAX_USERS);
+
+    err_code = init_tmp102_alert(tmp102_alert_handler);   /* Register TMP102 ALERT, armed by the temperature alarm check*/
+    APP_ERROR_CHECK(err_code);
+
+    err_code = ISL29023_init_interrupt(isl29023_int_handler);   /* Register ISL29023 INT, armed by the light alarm check*/
+    APP_ERROR_CHECK(err_code);
 }
 
 
@@ -983,6 +1152,8 @@ void radio_active_evt_handler(bool radio_active)
 {
     m_radio_event = radio_active;
     ble_flash_on_radio_active_evt(m_radio_event);									/*call the event handler */
+    radio_notification_callback(radio_active);      /* Schedule a refresh of the broadcast packet*/
+    battery_on_radio_evt(radio_active);             /* Start the pending battery samples*/
 }
 
 
@@ -1038,29 +1209,48 @@ static void data_log_check()
         write_data_flash(log_data);	                      /* Log the data to flash */
     }
 }
-/**@brief Function for application main entry.
+/**@brief Function for initializing the stack, timers, sensors and services.
+*
+* @details Called once at start-up. Both modes share the SoftDevice, the BLE event dispatch,
+*          Radio Notification, the application timers and the sensor configuration, so
+*          switching modes only swaps the advertising data and parameters.
 */
-void connectable_mode(void)
+void connectable_mode_init(void)
 {
-    uint32_t err_code;
     // Initialize.
     ble_stack_init();
     twi_master_init();                    /* Configure twi*/
     config_tmp102_shutdown_mode();        /* Configure tmp102 in shut-down mode*/
     ISL29023_config_FSR_and_powerdown();  /* Configure isl29023 */
-    adc_init();												  	/* Initialize ADC for interfacing soil moisture sensor*/
+    adc_init();												  	/* Enable the ADC interrupt for the soil moisture sensor and the battery*/
     timers_init();
     gpiote_init();
     buttons_init();
     bond_manager_init();
     gap_params_init();
-    advertising_init();
     services_init();
     conn_params_init();
     sec_params_init();
     radio_notification_init();
     twi_turn_OFF();
+}
+
+
+/**@brief Function for application main entry.
+*
+* @details Expects connectable_mode_init() to have been called. Returns once BROADCAST_MODE is
+*          set and no client is connected, with advertising and the measurement timer stopped.
+*/
+void connectable_mode(void)
+{
+    uint32_t err_code;
+
+    gap_params_init();                    /* Restore the name and advertising data replaced in broadcast mode*/
+    advertising_init();
     application_timers_start();    
+#if (LIVE_BEACON_ENABLE == FEATURE_ENABLED)
+    beacon_update();
+#endif
     advertising_start();
 
     // Enter main loop.
@@ -1069,7 +1259,18 @@ void connectable_mode(void)
 
         if((BROADCAST_MODE) && (!TEMPS_CONNECTED_STATE) && (!LIGHTS_CONNECTED_STATE) && (!SOILS_CONNECTED_STATE)&&(!DLOGS_CONNECTED_STATE)) /*If the broadcast mode flag is true and services are not connected stop advertising and exit*/
         {                          
+#if (MODE_SWITCH_BENCHMARK_ENABLE == FEATURE_ENABLED)
+            benchmark_start_prescaled(BENCHMARK_PRESCALER_32US);
+#endif
             sd_ble_gap_adv_stop();			                      /* Stop advertising */
+            err_code = app_timer_stop(sensor_meas_timer);   /* Only the broadcast refresh samples the sensors*/
+            APP_ERROR_CHECK(err_code);
+            twi_turn_ON();
+            (void)config_tmp102_alert_mode(TMP102_ALERT_THRESHOLD_NONE);  /* Broadcast mode compares the readings itself, re-armed by the next alarm check*/
+            (void)ISL29023_disable_interrupt();
+            twi_turn_OFF();
+            CHECK_TEMPERATURE = true;
+            CHECK_LIGHT       = true;
             break;
         }
 
@@ -1101,11 +1302,34 @@ void connectable_mode(void)
             create_time_stamp(&m_device, &m_time_stamp);     /* Create new time stamp from user set time*/
             TIME_SET = false;                                /* Reset the flag*/
 
+        }
+        if (CHECK_TEMPERATURE)                               /*Check for TMP102 ALERT or new temperature levels*/
+        {
+            CHECK_TEMPERATURE=false;                         /* Reset the flag before the check, ALERT may change again*/
+            temperature_alarm_check();                       /* Checks for alarm in temperature service, re-arms ALERT*/
+#if (LIVE_BEACON_ENABLE == FEATURE_ENABLED)
+            beacon_update();                                  /* Refresh the readings in the advertising data*/
+#endif
+        }
+        if (CHECK_LIGHT)                                     /*Check for ISL29023 INT or new light levels*/
+        {
+            CHECK_LIGHT=false;                               /* Reset the flag before the check, INT may be asserted again*/
+            light_alarm_check();                             /* Checks for alarm in light service, re-arms INT*/
+#if (LIVE_BEACON_ENABLE == FEATURE_ENABLED)
+            beacon_update();                                  /* Refresh the readings in the advertising data*/
+#endif
         }
         if (CHECK_ALARM_TIMEOUT)                             /*Check for sensor measurement time-out*/
         {
             alarm_check();                                   /* Checks for alarm in all services*/
-            battery_start();		                             /* Measure battery level*/    
+            if (++m_battery_poll_count >= BATTERY_POLL_COUNT)
+            {
+                m_battery_poll_count = 0;
+                battery_start();                             /* Report the battery level, sample it at the next radio events*/
+            }
+#if (LIVE_BEACON_ENABLE == FEATURE_ENABLED)
+            beacon_update();                                  /* Refresh the readings in the advertising data*/
+#endif
             CHECK_ALARM_TIMEOUT=false;                       /* Reset the flag*/
         }
         power_manage();             												 /* Switch to a low power state*/
@@ -7,6 +7,41 @@
 
 
 #include "wimoto_sensors.h"
+#include "wimoto.h"
+#include "nordic_common.h"
+#include "app_gpiote.h"
+#include "nrf_gpio.h"
+#include "nrf_error.h"
+
+/********************************************************************************************/
+/* PRIVATE VARIABLES																		*/
+/********************************************************************************************/
+typedef struct
+{
+    uint16_t fsr_lux;                                    /**< Full Scale Range in lux */
+    uint8_t  command_reg_2;                              /**< Content of Command Register 2 */
+    uint8_t  adc_bits;                                   /**< ADC resolution in bits */
+} isl29023_range_t;
+
+/* Only dim light needs the 90 ms of a 16 bit conversion, above 900 lux a 12 bit conversion
+   (5.6 ms) resolves better than 0.15 % of the reading */
+static const isl29023_range_t m_isl29023_ranges[ISL29023_RANGE_COUNT] =
+{
+    { 1000, ISL29023_USE_1K_LUX_FSR  | ISL29023_RES_16_BIT, 16},   /* 0.015 lux per count */
+    { 4000, ISL29023_USE_4K_LUX_FSR  | ISL29023_RES_12_BIT, 12},   /* 0.98 lux per count  */
+    {16000, ISL29023_USE_16K_LUX_FSR | ISL29023_RES_12_BIT, 12},   /* 3.9 lux per count   */
+    {64000, ISL29023_USE_64K_LUX_FSR | ISL29023_RES_12_BIT, 12}    /* 15.6 lux per count  */
+};
+
+static uint8_t                m_isl29023_range = ISL29023_RANGE_COUNT - 1;   /**< Range of the next conversion, chosen from the previous reading */
+static uint8_t                m_isl29023_range_set = ISL29023_RANGE_COUNT;   /**< Range in Command Register 2, ISL29023_RANGE_COUNT if unknown */
+static bool                   m_isl29023_int_armed = false;                  /**< ALS continuous mode with INT enabled */
+static uint16_t               m_isl29023_low_threshold;                      /**< Content of the interrupt low threshold registers, in counts */
+static uint16_t               m_isl29023_high_threshold;                     /**< Content of the interrupt high threshold registers, in counts */
+static app_gpiote_user_id_t   m_isl29023_int_gpiote;                         /**< GPIOTE user of the INT pin */
+static isl29023_int_handler_t m_isl29023_int_handler = NULL;                 /**< Handler of an INT assertion */
+
+
 
 /********************************************************************************************/
 /* PRIVATE FUNCTIONS																		*/
@@ -58,6 +93,143 @@ bool ISL29023_write_to_reg(uint8_t base_Address,uint8_t data)
 
 }
 
+/**
+*@brief   Function to write a 16 bit threshold to a pair of interrupt threshold registers
+*@details 1.The arguments of the function are
+*            (1)Base address of the LSB register
+*            (2)Base address of the MSB register
+*            (3)16 bit threshold
+*         2.Returns a true value on the success of the function otherwise a false value
+*/
+static bool ISL29023_write_threshold(uint8_t lsb_address, uint8_t msb_address, uint16_t threshold)
+{
+    return (ISL29023_write_to_reg (lsb_address , (uint8_t)(threshold & 0xFF)) &&
+            ISL29023_write_to_reg (msb_address , (uint8_t)(threshold >> 8)));
+}
+
+/**
+*@brief   Function to configure the FSR and ADC resolution of a range in Command Register 2
+*@details 1.Nothing is written if the range is already configured
+*         2.Returns a true value on the success of the function otherwise a false value
+*/
+static bool ISL29023_range_apply(uint8_t range)
+{
+    uint8_t command_reg_2 = m_isl29023_ranges[range].command_reg_2;
+
+    if (range == m_isl29023_range_set)
+    {
+        return true;
+    }
+
+    m_isl29023_range_set = ISL29023_RANGE_COUNT;
+
+    if (ISL29023_write_to_reg (ISL29023_COMMAND_REG_2 , command_reg_2) &&
+        (ISL29023_read_register (ISL29023_COMMAND_REG_2) == command_reg_2))
+    {
+        m_isl29023_range_set = range;
+        return true;
+    }
+
+    return false;
+}
+
+/**
+*@brief   Function to convert the content of the data registers to lux
+*@details 1.lux = counts * FSR / 2^bits, returned in 16.16 fixed point. The product is at most
+*           64000 * 2^16, so it is computed in 32 bits without a division
+*/
+static uint32_t ISL29023_counts_to_lux(uint16_t counts, uint8_t range)
+{
+    const isl29023_range_t * p_range = &m_isl29023_ranges[range];
+
+    counts &= (uint16_t)((1UL << p_range->adc_bits) - 1);
+
+    return ((uint32_t)counts * p_range->fsr_lux) << (ISL29023_LUX_FRACTION_BITS - p_range->adc_bits);
+}
+
+/**
+*@brief   Function to convert whole lux to counts of the data registers, for the thresholds
+*@details 1.Thresholds above the FSR are returned as 0xFFFF, which the data registers never exceed
+*/
+static uint16_t ISL29023_lux_to_counts(uint16_t lux, uint8_t range)
+{
+    const isl29023_range_t * p_range = &m_isl29023_ranges[range];
+    uint32_t counts;
+
+    counts = ((uint32_t)lux << p_range->adc_bits) / p_range->fsr_lux;
+
+    return (counts > 0xFFFF) ? 0xFFFF : (uint16_t)counts;
+}
+
+/**
+*@brief   Function to check whether a light level is too high for a range
+*/
+static bool ISL29023_above_range(uint32_t lux_integer, uint8_t range)
+{
+    return ((lux_integer * 100) > ((uint32_t)m_isl29023_ranges[range].fsr_lux * ISL29023_RANGE_UP_PERCENT));
+}
+
+/**
+*@brief   Function to choose the range of the next conversion from a reading
+*@details 1.The next range is used once a reading is above ISL29023_RANGE_UP_PERCENT of the FSR,
+*           a clipped reading included
+*         2.The previous range is used once a reading is below ISL29023_RANGE_DOWN_PERCENT of
+*           its FSR. The gap between both keeps a steady light level from switching ranges
+*/
+static void ISL29023_range_update(uint32_t lux)
+{
+    uint32_t lux_integer = lux >> ISL29023_LUX_FRACTION_BITS;
+
+    while ((m_isl29023_range < (ISL29023_RANGE_COUNT - 1)) && ISL29023_above_range(lux_integer, m_isl29023_range))
+    {
+        m_isl29023_range++;
+    }
+
+    while ((m_isl29023_range > 0) &&
+           ((lux_integer * 100) < ((uint32_t)m_isl29023_ranges[m_isl29023_range - 1].fsr_lux * ISL29023_RANGE_DOWN_PERCENT)))
+    {
+        m_isl29023_range--;
+    }
+}
+
+/**
+*@brief   Function to get the INT persistence of a range for Command Register 1
+*@details 1.A 16 bit range converts in 90 ms, ISL29023_INT_PERSISTENCE conversions are 360 ms
+*         2.A 12 bit range converts in 5.6 ms, ISL29023_INT_12_BIT_PERSISTENCE conversions are
+*           90 ms, so a shadow passing over a brightly lit sensor may still raise an alarm
+*/
+static uint8_t ISL29023_int_persistence(uint8_t range)
+{
+    if (m_isl29023_ranges[range].adc_bits == 16)
+    {
+        return ISL29023_INT_PERSISTENCE;
+    }
+
+    return ISL29023_INT_12_BIT_PERSISTENCE;
+}
+
+/**
+*@brief   GPIOTE handler of the INT pin
+*@details 1.Runs in the GPIOTE interrupt on the falling edge of INT, that is when the light level
+*           has been out of the threshold window for the persistence of the range, see
+*           ISL29023_int_persistence()
+*         2.INT stays low until Command Register 1 is read, see ISL29023_config_interrupt()
+*/
+static void ISL29023_int_gpiote_handler(uint32_t event_pins_low_to_high, uint32_t event_pins_high_to_low)
+{
+    UNUSED_PARAMETER(event_pins_low_to_high);
+
+    if ((event_pins_high_to_low & ISL29023_INT_PINS_HIGH_TO_LOW_MASK) == 0)
+    {
+        return;
+    }
+
+    if (m_isl29023_int_handler != NULL)
+    {
+        m_isl29023_int_handler();
+    }
+}
+
 
 
 /********************************************************************************************/
@@ -66,20 +238,18 @@ bool ISL29023_write_to_reg(uint8_t base_Address,uint8_t data)
 
 /**
 *@brief   Function to change Full Scale Reading of LUX and enable Power down mode of ISL29023 
-*@details 1.FSR value is configured as 64000 for Full Scale Reading considering the lighting conditions
-*           where the device will be used 
-*         2.16 bit data register mode is enabled by default condition and used it  
-*         3.Power down mode is enabled for power saving considerations (on demand based data)
-*         4.Function returns a true value on the success of the function            
+*@details 1.FSR value and ADC resolution are those of the range chosen by auto-ranging, 64000 lux
+*           until the first reading
+*         2.Power down mode is enabled for power saving considerations (on demand based data)
+*         3.Function returns a true value on the success of the function            
 */
 bool ISL29023_config_FSR_and_powerdown(void)
 {
-    uint8_t test_cmd_reg1 = 0 ,test_cmd_reg2 = 0;;
+    uint8_t test_cmd_reg1 = 0;
 
-    ISL29023_write_to_reg (ISL29023_COMMAND_REG_2 , ISL29023_USE_64K_LUX_FSR);
-    test_cmd_reg2 = ISL29023_read_register (ISL29023_COMMAND_REG_2);
+    m_isl29023_int_armed = false;
 
-    if (test_cmd_reg2 & ISL29023_USE_64K_LUX_FSR) 
+    if (ISL29023_range_apply (m_isl29023_range))
     {
         ISL29023_write_to_reg (ISL29023_COMMAND_REG_1 , ISL29023_ENABLE_POWER_DOWN);
         test_cmd_reg1 = ISL29023_read_register (ISL29023_COMMAND_REG_1);
@@ -100,28 +270,235 @@ bool ISL29023_config_FSR_and_powerdown(void)
 *@details 1.it will start ADC conversion with light sensing. It will go to the power-down mode 
 *             automatically  after one conversion is finished and keep the conversion data available 
 *             in data registers
-*         2.Returns the 16 bit value in the data register after the light sensing and conversion
-*              has been finished
+*         2.A reading above the range is measured again in the next range, so a sudden change
+*             to bright light is not returned clipped
+*         3.Returns the light level in lux, 16.16 fixed point, after the light sensing and
+*             conversion has been finished
 */
-uint16_t ISL29023_get_one_time_ALS()
+uint32_t ISL29023_get_one_time_ALS()
 {
-    uint8_t data_reg_LSB = 0 ,data_reg_MSB = 0 ,reg_content;
-    uint32_t combined_val;
+    uint32_t lux = 0;
+    uint8_t  range;
+    uint8_t  attempt;
+
+    for (attempt = 0; attempt < ISL29023_RANGE_COUNT; attempt++)
+    {
+        range = m_isl29023_range;
+
+        if (!ISL29023_start_one_time_ALS())
+        {
+            return 0;                                                /* On failure return 0                            */
+        }
+
+        nrf_delay_ms(ISL29023_conversion_time_ms());                 /* Integration time of the range                  */
+        lux = ISL29023_read_ALS();
+
+        if (m_isl29023_range <= range)
+        {
+            break;                                                   /* Not above the range                            */
+        }
+    }
+
+    return lux;
+
+}
+
+/**
+*@brief   Function to start One time Ambient Light Sensing without waiting for the conversion
+*@details 1.Other sensors can be used while the ISL29023 integrates, the result is read with 
+*             ISL29023_read_ALS() once ISL29023_conversion_time_ms() has passed
+*         2.Returns a true value if the conversion has been started otherwise a false value
+*/
+bool ISL29023_start_one_time_ALS(void)
+{
+    uint8_t reg_content;
+
+    m_isl29023_int_armed = false;                                    /* ALS once also ends continuous mode */
+
+    if (!ISL29023_range_apply (m_isl29023_range))
+    {
+        return false;
+    }
 
     ISL29023_write_to_reg (ISL29023_COMMAND_REG_1 , ISL29023_ENABLE_ALS_ONCE);
     reg_content = ISL29023_read_register (ISL29023_COMMAND_REG_1);
 
-    if (reg_content & ISL29023_ENABLE_ALS_ONCE) 
-    {  
-        nrf_delay_ms(90);                                     /* Integration time required for 16bit conversion */		
-        data_reg_LSB =   ISL29023_read_register (ISL29023_DATA_REG_LSB); /* Least Significant Byte of Data Register        */
-        data_reg_MSB =   ISL29023_read_register (ISL29023_DATA_REG_MSB); /* Most Significant Byte of Data Register         */ 
-        combined_val = ((data_reg_MSB << 8) | data_reg_LSB);
-        return combined_val;                                        /* Return two 8 bit data as a 16 bit data         */  
-    } 
+    return ((reg_content & ISL29023_ENABLE_ALS_ONCE) != 0);
+}
 
-    return 0;		                                             /* On failure return 0                            */
+/**
+*@brief   Function to read the result of One time Ambient Light Sensing
+*@details 1.Returns the light level in lux, 16.16 fixed point
+*         2.The range of the next conversion is chosen from this reading
+*/
+uint32_t ISL29023_read_ALS(void)
+{
+    uint8_t  data_reg_LSB = 0 ,data_reg_MSB = 0;
+    uint32_t lux;
+
+    if (m_isl29023_range_set >= ISL29023_RANGE_COUNT)
+    {
+        return 0;                                                    /* Range of the conversion unknown                */
+    }
 
+    data_reg_LSB = ISL29023_read_register (ISL29023_DATA_REG_LSB);   /* Least Significant Byte of Data Register        */
+    data_reg_MSB = ISL29023_read_register (ISL29023_DATA_REG_MSB);   /* Most Significant Byte of Data Register         */
+
+    lux = ISL29023_counts_to_lux((uint16_t)((data_reg_MSB << 8) | data_reg_LSB), m_isl29023_range_set);
+    ISL29023_range_update(lux);
+
+    return lux;
 }
 
+/**
+*@brief   Function to get the integration time of the next conversion
+*@details Returns ISL29023_ALS_CONVERSION_TIME_MS for a 16 bit range, otherwise
+*         ISL29023_ALS_12_BIT_CONVERSION_TIME_MS
+*/
+uint8_t ISL29023_conversion_time_ms(void)
+{
+    if (m_isl29023_ranges[m_isl29023_range].adc_bits == 16)
+    {
+        return ISL29023_ALS_CONVERSION_TIME_MS;
+    }
+
+    return ISL29023_ALS_12_BIT_CONVERSION_TIME_MS;
+}
+
+/**
+*@brief   Function to register the INT pin of ISL29023 with the GPIOTE handler
+*@details 1.INT is open drain, the pin is configured with a pull-up
+*         2.The handler is called from the GPIOTE interrupt when INT is asserted, see
+*           ISL29023_config_interrupt(). Must be called after APP_GPIOTE_INIT()
+*/
+uint32_t ISL29023_init_interrupt(isl29023_int_handler_t handler)
+{
+    uint32_t err_code;
+
+    m_isl29023_int_handler = handler;
+
+    nrf_gpio_cfg_input(ISL29023_INT_GPIOTE_PIN, NRF_GPIO_PIN_PULLUP);
+
+    err_code = app_gpiote_user_register(&m_isl29023_int_gpiote,
+                                        0,
+                                        ISL29023_INT_PINS_HIGH_TO_LOW_MASK,
+                                        ISL29023_int_gpiote_handler);
+    if (err_code != NRF_SUCCESS)
+    {
+        return err_code;
+    }
+
+    return app_gpiote_user_enable(m_isl29023_int_gpiote);
+}
+
+/**
+*@brief   Function to enable continuous Ambient Light Sensing with an interrupt threshold window
+*@details 1.The arguments of the function are the low and high thresholds in lux, 0xFFFF for no
+*           high threshold. INT is asserted when the light level stays below the low threshold
+*           or above the high threshold for the persistence of the range, so the MCU does not
+*           have to start and wait for conversions to detect it
+*         2.The range is the wider of the one chosen by auto-ranging and the one the window fits
+*           in. The threshold registers are only written if they have changed
+*         3.Command Register 1 is always read back, which clears a pending INT
+*         4.Returns a true value on the success of the function otherwise a false value
+*/
+bool ISL29023_config_interrupt(uint16_t low_lux, uint16_t high_lux)
+{
+    uint8_t  reg_content;
+    uint8_t  range        = m_isl29023_range;
+    uint16_t window_top   = (high_lux != 0xFFFF) ? high_lux : low_lux;
+    uint16_t low_threshold;
+    uint16_t high_threshold;
+
+    while ((range < (ISL29023_RANGE_COUNT - 1)) && ISL29023_above_range(window_top, range))
+    {
+        range++;
+    }
 
+    if (range != m_isl29023_range_set)
+    {
+        m_isl29023_int_armed = false;                                /* Thresholds are in counts of the range          */
+    }
+
+    if (!ISL29023_range_apply (range))
+    {
+        m_isl29023_int_armed = false;
+        return false;
+    }
+
+    low_threshold  = ISL29023_lux_to_counts(low_lux, range);
+    high_threshold = (high_lux != 0xFFFF) ? ISL29023_lux_to_counts(high_lux, range) : 0xFFFF;
+
+    if (!m_isl29023_int_armed || (low_threshold != m_isl29023_low_threshold))
+    {
+        if (!ISL29023_write_threshold (ISL29023_INT_LT_LSB , ISL29023_INT_LT_MSB , low_threshold))
+        {
+            m_isl29023_int_armed = false;
+            return false;
+        }
+        m_isl29023_low_threshold = low_threshold;
+    }
+
+    if (!m_isl29023_int_armed || (high_threshold != m_isl29023_high_threshold))
+    {
+        if (!ISL29023_write_threshold (ISL29023_INT_HT_LSB , ISL29023_INT_HT_MSB , high_threshold))
+        {
+            m_isl29023_int_armed = false;
+            return false;
+        }
+        m_isl29023_high_threshold = high_threshold;
+    }
+
+    if (!m_isl29023_int_armed)
+    {
+        ISL29023_write_to_reg (ISL29023_COMMAND_REG_1 , ISL29023_ENABLE_ALS_CONTINUOUS | ISL29023_int_persistence(range));
+    }
+
+    reg_content = ISL29023_read_register (ISL29023_COMMAND_REG_1);   /* Reading Command Register 1 clears INT */
+
+    m_isl29023_int_armed = ((reg_content & ISL29023_ENABLE_ALS_CONTINUOUS) == ISL29023_ENABLE_ALS_CONTINUOUS);
+
+    return m_isl29023_int_armed;
+}
+
+/**
+*@brief   Function to disable the interrupt and go back to power down mode
+*@details Returns a true value on the success of the function otherwise a false value
+*/
+bool ISL29023_disable_interrupt(void)
+{
+    if (!m_isl29023_int_armed)
+    {
+        return true;
+    }
+
+    return ISL29023_config_FSR_and_powerdown();
+}
+
+/**
+*@brief   Function to get the light level in lux, 16.16 fixed point
+*@details 1.While INT is armed, ISL29023 converts continuously and the data registers are read
+*           without starting a conversion
+*         2.Otherwise, or if the light level is above the armed range, a One time Ambient Light
+*           Sensing conversion is done. It walks up the ranges so the reading is not clipped at
+*           the FSR, and ends continuous mode until ISL29023_config_interrupt() arms INT again in
+*           the wider range
+*/
+uint32_t ISL29023_get_ALS(void)
+{
+    uint32_t lux;
+
+    if (!m_isl29023_int_armed)
+    {
+        return ISL29023_get_one_time_ALS();
+    }
+
+    lux = ISL29023_read_ALS();
+
+    if (m_isl29023_range > m_isl29023_range_set)
+    {
+        lux = ISL29023_get_one_time_ALS();                           /* Clipped at the FSR of the armed range          */
+    }
+
+    return lux;
+}
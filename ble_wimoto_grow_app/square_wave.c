@@ -27,7 +27,7 @@
 void timer2_init(void)
 {
     uint8_t  softdevice_enabled,err_code;
-    uint32_t ret_val;
+    uint32_t ret_val = 0;
     err_code = sd_softdevice_is_enabled(&softdevice_enabled);
     APP_ERROR_CHECK(err_code);
 
@@ -118,6 +118,31 @@ void ppi_init(void)
 }
 
 
+/** @brief Function for assigning and enabling a PPI channel, through the SoftDevice when it is enabled.
+*/
+static void one_mhz_ppi_assign(uint8_t channel, const volatile void * p_event, const volatile void * p_task)
+{
+    uint8_t  softdevice_enabled,err_code;
+
+    err_code = sd_softdevice_is_enabled(&softdevice_enabled);
+    APP_ERROR_CHECK(err_code);
+
+    if (softdevice_enabled == 0)
+    {
+        NRF_PPI->CH[channel].EEP = (uint32_t)p_event;
+        NRF_PPI->CH[channel].TEP = (uint32_t)p_task;
+        NRF_PPI->CHENSET = (1UL << channel);
+    }
+    else
+    {
+        err_code = sd_ppi_channel_assign(channel, p_event, p_task);
+        APP_ERROR_CHECK(err_code);
+        err_code = sd_ppi_channel_enable_set(1UL << channel);
+        APP_ERROR_CHECK(err_code);
+    }
+}
+
+
 /**
 * @brief Function for application main entry.
 */
@@ -132,6 +157,87 @@ int one_mhz_start(void)
     return 0;		
 }
 
+
+/**
+* @brief Function for preparing the 1Mhz wave for an ADC conversion at a fixed phase.
+*
+* @details TIMER1 counts the toggles of the output. After ONE_MHZ_SETTLE_TOGGLES its compare event
+*          starts the ADC and the ADC END event stops TIMER2, so the sensor is only excited for the
+*          settling time and the conversion. Nothing runs until one_mhz_sync_start().
+*/
+void one_mhz_sync_init(void)
+{
+    timer2_init();
+
+    NRF_TIMER1->TASKS_STOP  = 1;
+    NRF_TIMER1->MODE        = TIMER_MODE_MODE_Counter;
+    NRF_TIMER1->BITMODE     = TIMER_BITMODE_BITMODE_16Bit << TIMER_BITMODE_BITMODE_Pos;
+    NRF_TIMER1->SHORTS      = 0;
+    NRF_TIMER1->CC[0]       = ONE_MHZ_SETTLE_TOGGLES;
+
+    one_mhz_ppi_assign(ONE_MHZ_PPI_CH_TOGGLE,    &NRF_TIMER2->EVENTS_COMPARE[0], &NRF_GPIOTE->TASKS_OUT[0]);
+    one_mhz_ppi_assign(ONE_MHZ_PPI_CH_COUNT,     &NRF_TIMER2->EVENTS_COMPARE[0], &NRF_TIMER1->TASKS_COUNT);
+    one_mhz_ppi_assign(ONE_MHZ_PPI_CH_ADC_START, &NRF_TIMER1->EVENTS_COMPARE[0], &NRF_ADC->TASKS_START);
+    one_mhz_ppi_assign(ONE_MHZ_PPI_CH_STOP,      &NRF_ADC->EVENTS_END,           &NRF_TIMER2->TASKS_STOP);
+}
+
+
+/**
+* @brief Function for starting the 1Mhz wave for one ADC conversion.
+*
+* @details Used as the start handler of the ADC request, called once the ADC is configured for
+*          the soil moisture input (also from the ADC interrupt for the next conversion).
+*/
+void one_mhz_sync_start(void)
+{
+    NRF_TIMER2->TASKS_STOP  = 1;
+    NRF_TIMER2->TASKS_CLEAR = 1;
+    NRF_TIMER1->TASKS_CLEAR = 1;
+
+    // Restart the output low, so the settling time always ends at the same edge
+    NRF_GPIOTE->CONFIG[0] = GPIOTE_CONFIG_MODE_Disabled << GPIOTE_CONFIG_MODE_Pos;
+    NRF_GPIOTE->CONFIG[0] = GPIOTE_CONFIG_MODE_Task << GPIOTE_CONFIG_MODE_Pos |
+    GPIOTE_CONFIG_POLARITY_Toggle << GPIOTE_CONFIG_POLARITY_Pos |
+    PWM_OUTPUT_PIN_NUMBER << GPIOTE_CONFIG_PSEL_Pos |
+    GPIOTE_CONFIG_OUTINIT_Low << GPIOTE_CONFIG_OUTINIT_Pos;
+
+    NRF_TIMER1->TASKS_START = 1;
+    NRF_TIMER2->TASKS_START = 1;
+}
+
+
+/**
+* @brief Function for stopping the 1Mhz wave and releasing TIMER1, the PPI channels and the 16 MHz crystal.
+*/
+void one_mhz_stop(void)
+{
+    uint8_t  softdevice_enabled,err_code;
+    uint32_t channels = (1UL << ONE_MHZ_PPI_CH_TOGGLE) | (1UL << ONE_MHZ_PPI_CH_COUNT) |
+                        (1UL << ONE_MHZ_PPI_CH_ADC_START) | (1UL << ONE_MHZ_PPI_CH_STOP);
+
+    NRF_TIMER2->TASKS_STOP = 1;
+    NRF_TIMER1->TASKS_STOP = 1;
+
+    NRF_GPIOTE->CONFIG[0] = GPIOTE_CONFIG_MODE_Disabled << GPIOTE_CONFIG_MODE_Pos;
+    nrf_gpio_pin_clear(PWM_OUTPUT_PIN_NUMBER);
+
+    err_code = sd_softdevice_is_enabled(&softdevice_enabled);
+    APP_ERROR_CHECK(err_code);
+
+    if (softdevice_enabled == 0)
+    {
+        NRF_PPI->CHENCLR          = channels;
+        NRF_CLOCK->TASKS_HFCLKSTOP = 1;
+    }
+    else
+    {
+        err_code = sd_ppi_channel_enable_clr(channels);
+        APP_ERROR_CHECK(err_code);
+        err_code = sd_clock_hfclk_release();
+        APP_ERROR_CHECK(err_code);
+    }
+}
+
 /** @} */
 
 
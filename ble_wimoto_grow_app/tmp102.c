@@ -7,6 +7,17 @@
 
 
 #include "wimoto_sensors.h"
+#include "wimoto.h"
+#include "app_gpiote.h"
+#include "nrf_gpio.h"
+#include "nrf_error.h"
+
+/********************************************************************************************/
+/* PRIVATE VARIABLES																		*/
+/********************************************************************************************/
+static uint16_t               m_tmp102_alert_threshold = TMP102_ALERT_THRESHOLD_NONE;  /**< Threshold in T-LOW and T-HIGH, TMP102_ALERT_THRESHOLD_NONE in shut-down mode */
+static app_gpiote_user_id_t   m_tmp102_alert_gpiote;                                    /**< GPIOTE user of the ALERT pin */
+static tmp102_alert_handler_t m_tmp102_alert_handler = NULL;                            /**< Handler of an ALERT change */
 
 
 
@@ -79,6 +90,25 @@ bool write_to_register(uint8_t base_Address,uint8_t MSB,uint8_t LSB)
 
 }
 
+/**
+*@brief    GPIOTE handler of the ALERT pin.
+*@features 1. Runs in the GPIOTE interrupt on both edges of ALERT, that is whenever a
+*             conversion crosses the threshold in either direction.
+**/
+static void tmp102_alert_gpiote_handler(uint32_t event_pins_low_to_high, uint32_t event_pins_high_to_low)
+{
+    if (((event_pins_low_to_high & TMP102_ALERT_PINS_LOW_TO_HIGH_MASK) == 0) &&
+        ((event_pins_high_to_low & TMP102_ALERT_PINS_HIGH_TO_LOW_MASK) == 0))
+    {
+        return;
+    }
+
+    if (m_tmp102_alert_handler != NULL)
+    {
+        m_tmp102_alert_handler();
+    }
+}
+
 /********************************************************************************************/
 /* PUBLIC FUNCTIONS																			*/
 /********************************************************************************************/
@@ -108,6 +138,8 @@ bool config_tmp102_shutdown_mode (void)
 
 
 
+    m_tmp102_alert_threshold = TMP102_ALERT_THRESHOLD_NONE;   /* ALERT is no longer updated */
+
     /* Write operation to the configuration register for setting SD bit                      */
     if (twi_master_transfer(TMP102_ADDRESS ,(uint8_t*)data_buffer,3,TWI_ISSUE_STOP))
     {
@@ -161,7 +193,7 @@ uint16_t get_tmp102_oneshot_temp (void)
 
     data_buffer[2]      = TMP102_CONFIG_REG_DEFAULT_LSB; /* Default Least Significant Byte  */
 
-
+    m_tmp102_alert_threshold = TMP102_ALERT_THRESHOLD_NONE;  /* SD = 1 also ends continuous conversion */
 
     /* Start one-shot conversion by writing OS =1                                           */
     if (twi_master_transfer(TMP102_ADDRESS ,(uint8_t*)data_buffer,3,TWI_ISSUE_STOP))
@@ -191,3 +223,89 @@ uint16_t get_tmp102_oneshot_temp (void)
 }
 
 
+/**
+*@brief    This function registers the ALERT pin of TMP102 with the GPIOTE handler.
+*@features 1. ALERT is open drain, the pin is configured with a pull-up.
+*          2. The handler is called from the GPIOTE interrupt whenever ALERT changes, see
+*             config_tmp102_alert_mode(). Must be called after APP_GPIOTE_INIT().
+**/
+uint32_t init_tmp102_alert(tmp102_alert_handler_t handler)
+{
+    uint32_t err_code;
+
+    m_tmp102_alert_handler = handler;
+
+    nrf_gpio_cfg_input(TMP102_ALERT_GPIOTE_PIN, NRF_GPIO_PIN_PULLUP);
+
+    err_code = app_gpiote_user_register(&m_tmp102_alert_gpiote,
+                                        TMP102_ALERT_PINS_LOW_TO_HIGH_MASK,
+                                        TMP102_ALERT_PINS_HIGH_TO_LOW_MASK,
+                                        tmp102_alert_gpiote_handler);
+    if (err_code != NRF_SUCCESS)
+    {
+        return err_code;
+    }
+
+    return app_gpiote_user_enable(m_tmp102_alert_gpiote);
+}
+
+
+/**
+*@brief    This function arms the ALERT pin of TMP102 at a temperature threshold.
+*@features 1. The 12 bit threshold is written to both T-LOW and T-HIGH and TMP102 is put in
+*             continuous conversion, comparator mode. ALERT is then low while the temperature
+*             is at or above the threshold and high below it, so it changes on every crossing
+*             and the MCU does not have to poll the temperature to detect it.
+*          2. With TMP102_ALERT_THRESHOLD_NONE, TMP102 is put back in shut-down mode.
+*          3. Nothing is written if TMP102 is already armed at the threshold.
+*          4. If the operation was successful , function returns a TRUE value
+*             otherwise a FALSE value.
+**/
+bool config_tmp102_alert_mode(uint16_t threshold)
+{
+    uint8_t threshold_msb;
+    uint8_t threshold_lsb;
+
+    if (threshold == m_tmp102_alert_threshold)
+    {
+        return true;
+    }
+
+    if (threshold == TMP102_ALERT_THRESHOLD_NONE)
+    {
+        return config_tmp102_shutdown_mode();
+    }
+
+    /* Threshold registers are 12 bit left aligned, like the temperature register           */
+    threshold_msb = (uint8_t)((threshold >> 4) & 0xFF);
+    threshold_lsb = (uint8_t)((threshold << 4) & 0xF0);
+
+    if (!write_to_register(TMP102_LOW_REG,    threshold_msb, threshold_lsb) ||
+        !write_to_register(TMP102_HIGH_REG,   threshold_msb, threshold_lsb) ||
+        !write_to_register(TMP102_CONFIG_REG, TMP102_CONFIG_REG_ALERT_MSB, TMP102_CONFIG_REG_ALERT_LSB))
+    {
+        m_tmp102_alert_threshold = TMP102_ALERT_THRESHOLD_NONE;
+        return false;
+    }
+
+    m_tmp102_alert_threshold = threshold;
+    return true;
+}
+
+
+/**
+*@brief    This function returns the temperature value to the calling function.
+*@features 1. While ALERT is armed, TMP102 converts continuously and the temperature register
+*             is read without starting a conversion, so ALERT stays armed.
+*          2. Otherwise the temperature is measured in one-shot mode.
+**/
+uint16_t get_tmp102_temp(void)
+{
+    if (m_tmp102_alert_threshold == TMP102_ALERT_THRESHOLD_NONE)
+    {
+        return get_tmp102_oneshot_temp();
+    }
+
+    /* Remove four '0' bits in the Least Significant Byte                                   */
+    return (uint16_t)((read_register_content(TMP102_TEMP_REG) >> 4) & 0x0FFF);
+}
@@ -9,6 +9,7 @@
 
 #include <stdint.h>
 #include <stdio.h>
+#include <stdbool.h>
 
 
 ////////////////////////////////////////////  CLIMATE PROFILE CUSTOM UUID  ////////////////////////////////////////////
@@ -35,6 +36,7 @@
 #define CLIMATE_PROFILE_HUMS_HUM_HIGH_CHAR_UUID           0x5617
 #define CLIMATE_PROFILE_HUMS_HUM_ALARM_SET_CHAR_UUID      0x5618
 #define CLIMATE_PROFILE_HUMS_HUM_ALARM_CHAR_UUID          0x5619
+#define CLIMATE_PROFILE_HUMS_RESOLUTION_CHAR_UUID       0x5622
 /*custom UUID definitions for Data logger service*/
 #define CLIMATE_PROFILE_DLOGS_SERVICE_UUID                0x561A
 #define CLIMATE_PROFILE_DLOGS_DLOGS_EN_UUID               0x561B
@@ -45,6 +47,7 @@
 #define CLIMATE_PROFILE_DEVICE_DFU_MODE_CHAR_UUID         0x561F
 #define CLIMATE_PROFILE_DEVICE_SWITCH_MODE_CHAR_UUID      0x5620
 #define CLIMATE_PROFILE_DEVICE_TIME_STAMP_CHAR_UUID       0x1805
+#define CLIMATE_PROFILE_DEVICE_ADV_POLICY_CHAR_UUID       0x5621
 
 
 ////////////////////////////////////////////  GROW PROFILE CUSTOM UUID  ////////////////////////////////////////////
@@ -81,6 +84,7 @@
 #define GROW_PROFILE_DEVICE_DFU_MODE_CHAR_UUID            0x471D
 #define GROW_PROFILE_DEVICE_SWITCH_MODE_CHAR_UUID         0x471E
 #define GROW_PROFILE_DEVICE_TIME_STAMP_CHAR_UUID          0x1805
+#define GROW_PROFILE_DEVICE_ADV_POLICY_CHAR_UUID          0x471F
 
 
 ////////////////////////////////////////////  SENTRY PROFILE CUSTOM UUID  ////////////////////////////////////////////
@@ -92,6 +96,8 @@
 #define SENTRY_PROFILE_MOVEMENT_ALARM_SET_CHAR_UUID       0xDC6A
 #define SENTRY_PROFILE_MOVEMENT_ALARM_CLEAR_CHAR_UUID     0xDC6B
 #define SENTRY_PROFILE_MOVEMENT_ALARM_CHAR_UUID           0xDC6C
+#define SENTRY_PROFILE_MOVEMENT_STREAM_CHAR_UUID          0xDC79
+#define SENTRY_PROFILE_MOVEMENT_STREAM_RATE_CHAR_UUID     0xDC7A
 /*custom UUID definitions for PIR alarm service.*/                                                          
 #define SENTRY_PROFILE_PIR_SERVICE_UUID                   0xDC6D
 #define SENTRY_PROFILE_PIR_CURR_STATE_CHAR_UUID           0xDC6E
@@ -107,6 +113,7 @@
 #define SENTRY_PROFILE_DEVICE_DFU_MODE_CHAR_UUID          0xDC76
 #define SENTRY_PROFILE_DEVICE_SWITCH_MODE_CHAR_UUID       0xDC77
 #define SENTRY_PROFILE_DEVICE_TIME_STAMP_CHAR_UUID        0x1805
+#define SENTRY_PROFILE_DEVICE_ADV_POLICY_CHAR_UUID        0xDC78
 
 
 ////////////////////////////////////////////  THERMO PROFILE CUSTOM UUID  ////////////////////////////////////////////
@@ -136,6 +143,7 @@
 #define THERMO_PROFILE_DEVICE_DFU_MODE_CHAR_UUID          0x8E5F 
 #define THERMO_PROFILE_DEVICE_SWITCH_MODE_CHAR_UUID       0x8E60 
 #define THERMO_PROFILE_DEVICE_TIME_STAMP_CHAR_UUID        0x1805  
+#define THERMO_PROFILE_DEVICE_ADV_POLICY_CHAR_UUID        0x8E61
 
 
 ////////////////////////////////////////////  WATER PROFILE CUSTOM UUID  ////////////////////////////////////////////
@@ -163,6 +171,7 @@
 #define WATER_PROFILE_DEVICE_DFU_MODE_CHAR_UUID           0xC7EA
 #define WATER_PROFILE_DEVICE_SWITCH_MODE_CHAR_UUID        0xC7EB
 #define WATER_PROFILE_DEVICE_TIME_STAMP_CHAR_UUID         0x1805
+#define WATER_PROFILE_DEVICE_ADV_POLICY_CHAR_UUID         0xC7EC
 
 
 
@@ -241,6 +250,19 @@
 #define DEFAULT_PIR_STATE_ON_PULLUP               0x00        /**< Default value on GPIO pin when PIR sensor when not generating interrupt (ACTIVE HIGH SENSOR)*/             
 #define PIR_DETECTION                             0x01        /**< Default value on GPIO pin when PIR sensor has generated interrupt(ACTIVE HIGH SENSOR)*/
 
+/*Pin for TMP006 data ready GPIOTE. */
+#define TMP006_DRDY_GPIOTE_PIN                      5         /**< Select pin P0.05 for interfacing TMP006 DRDY pin (open drain, active low)>*/
+#define TMP006_DRDY_PINS_HIGH_TO_LOW_MASK         0x00000020  /**< Pin selection, so that a HIGH to LOW logic on chosen pin generates an interrupt  >*/
+
+/*Pin for TMP102 ALERT GPIOTE. */
+#define TMP102_ALERT_GPIOTE_PIN                     6         /**< Select pin P0.06 for interfacing TMP102 ALERT pin (open drain, active low)>*/
+#define TMP102_ALERT_PINS_LOW_TO_HIGH_MASK        0x00000040  /**< Pin selection, so that a LOW to HIGH logic on chosen pin generates an interrupt  >*/
+#define TMP102_ALERT_PINS_HIGH_TO_LOW_MASK        0x00000040  /**< Pin selection, so that a HIGH to LOW logic on chosen pin generates an interrupt  >*/
+
+/*Pin for ISL29023 interrupt GPIOTE. */
+#define ISL29023_INT_GPIOTE_PIN                     7         /**< Select pin P0.07 for interfacing ISL29023 INT pin (open drain, active low)>*/
+#define ISL29023_INT_PINS_HIGH_TO_LOW_MASK        0x00000080  /**< Pin selection, so that a HIGH to LOW logic on chosen pin generates an interrupt  >*/
+
  /*Pin for water presence GPIOTE. */
 #define WATERP_GPIOTE_PIN                           0 
 #define WATERP_PINS_LOW_TO_HIGH_MASK              0x80000001  /**< Pin selection, so that a LOW to HIGH logic on chosen pin generates an interrupt >*/
@@ -267,9 +289,14 @@
 #define SOIL_MOIS_DEFAULT_LOW_VALUE               0x00        /**< Default value of soil moisture low value>*/
 #define SOIL_MOIS_DEFAULT_HIGH_VALUE              0xFF        /**< Default value of soil moisture low value>*/
   
+#define THERMOP_BINARY_ENABLE                     0x01        /**< 0x00 - Disabled, thermopile temperature as 5 ASCII characters for existing clients 0x01 - Enabled, as int16 in 0.01 degrees C, MSB first*/
+#if (THERMOP_BINARY_ENABLE == 0x01)
+#define THERMOP_CHAR_SIZE                         0x02        /**< Thermopile temperature is int16*/
+#else
 #define THERMOP_CHAR_SIZE                         0x05        /**< Thermopile temperature is 5 characters*/
-#define THERMOP_DEFAULT_LOW_VALUE                 0x30        /**< Default value of thermopile tempreature low value>*/
-#define THERMOP_DEFAULT_HIGH_VALUE                0x39        /**< Default value of thermopile tempreature low value>*/
+#endif
+#define THERMOP_DEFAULT_LOW_LEVEL                 0           /**< Default value of thermopile tempreature low value in 0.01 degrees C (00.00)>*/
+#define THERMOP_DEFAULT_HIGH_LEVEL                9999        /**< Default value of thermopile tempreature high value in 0.01 degrees C (99.99)>*/
 #define PERIOD                                    0x2E        /**< Hex value of Period (.)*/
 
 #define WATERL_LEVEL_DEFAULT_LOW_VALUE            0x00        /**< Default value of soil moisture low value>*/
@@ -281,9 +308,33 @@
 #define DATA_LOGGER_BUFFER_START_PAGE             0xC0        /**< first flash page of the datalogger cyclic buffer*/
 #define DATA_LOGGER_BUFFER_END_PAGE               0xC3        /**< last flash page of the datalogger cyclic buffer*/
 #define COMPANY_IDENTIFER                         0x1701      /**< comapany identifier*/                                                                 
+#define FIRMWARE_VERSION_MAJOR                    0x01        /**< Firmware version, major number*/
+#define FIRMWARE_VERSION_MINOR                    0x00        /**< Firmware version, minor number*/
+
+#define ADV_POLICY_CHAR_SIZE                      0x06        /**< Fast interval, slow interval and threshold, 2 bytes each MSB first*/
+#define ADV_POLICY_DEFAULT_FAST_INTERVAL          0x00A0      /**< Broadcast interval right after a reading changed (in units of 0.625 ms, 100 ms)*/
+#define ADV_POLICY_DEFAULT_SLOW_INTERVAL          0x2800      /**< Broadcast interval ceiling while readings are stable (in units of 0.625 ms, 6.4 s)*/
+#define ADV_POLICY_DEFAULT_THRESHOLD              0x0100      /**< Change of a reading, in 1/65536 of its full scale, that restores the fast interval*/
+
+/**@brief Adaptive broadcast interval policy, set in connectable mode and used in broadcast mode. */
+typedef struct
+{
+    uint16_t fast_interval;                                   /**< Interval used right after a reading changed (in units of 0.625 ms). */
+    uint16_t slow_interval;                                   /**< Ceiling the interval backs off to while readings are stable (in units of 0.625 ms). */
+    uint16_t threshold;                                       /**< Change of a reading, in 1/65536 of its full scale, that restores the fast interval. */
+} adv_policy_t;
+
+#define MODE_SWITCH_BENCHMARK_ENABLE              0x00        /**< 0x00 - Disabled 0x01 - Not supported in the grow app: the switch to broadcast mode measures the soil moisture, which uses TIMER1 as the counter of the 1MHz wave, see benchmark.h*/
+#if (MODE_SWITCH_BENCHMARK_ENABLE != 0x00)                    /* wimoto.h may be included before FEATURE_ENABLED is defined*/
+#error "MODE_SWITCH_BENCHMARK_ENABLE: the soil moisture measurement reconfigures TIMER1, the benchmark timer"
+#endif
+#define BROADCAST_ALARM(index, alarm)             ((uint8_t)((alarm) << (2 * (index))))  /**< Alarm value (RESET_ALARM, SET_ALARM_LOW or SET_ALARM_HIGH) of reading 'index' of the broadcast manufacturer data, in its 2 bits of the alarm byte*/
   
 void broadcast_mode(void);                                    /**< Function to broadcast climate parameters  */
 void connectable_mode(void);                                  /**< Function to advertise peripheral services */
+void connectable_mode_init(void);                             /**< Function to initialize the stack, timers, sensors and services once for both modes */
+void radio_notification_callback(bool is_radio_active);       /**< Function to schedule a broadcast refresh before a radio event */
+uint8_t broadcast_alarm_get(const uint8_t * p_readings);      /**< Function to evaluate the alarms of the readings taken in broadcast mode */
 void twi_turn_OFF(void);                                      /**< Function to turn OFF twi for power saving */
 void twi_turn_ON(void);                                       /**< Function to turn ON twi								   */
  
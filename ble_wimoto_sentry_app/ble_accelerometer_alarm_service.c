@@ -24,10 +24,28 @@
 
 extern bool 	MOVEMENT_EVENT_FLAG;
 extern bool 	CLEAR_MOVE_ALARM;
+extern bool   MOVEMENT_STREAM_CONFIG;
 extern uint8_t movement_gpio_pin_val;
 bool 					ACCELEROMETER_CONNECTED_STATE=false; /*Indicates whether the movement service is connected or not*/
 uint8_t       current_xyz_array[3];                /* Read value of X Y Z data*/
 
+static uint8_t  m_stream_packet[MOVEMENT_STREAM_PACKET_LEN];                              /* Packet being filled with samples*/
+static uint8_t  m_stream_sample_count;                                                    /* Samples in m_stream_packet*/
+static uint8_t  m_stream_sequence;                                                        /* Sequence number of the next packet*/
+static uint8_t  m_stream_queue[MOVEMENT_STREAM_QUEUE_LEN][MOVEMENT_STREAM_PACKET_LEN];    /* Full packets waiting for a TX buffer*/
+static uint8_t  m_stream_queue_head;                                                      /* Oldest packet in the queue*/
+static uint8_t  m_stream_queue_count;                                                     /* Packets in the queue*/
+
+volatile uint32_t m_bench_stream_samples_sent;                  /* Samples handed to the stack (or to the simulated link)*/
+volatile uint32_t m_bench_stream_packets_dropped;               /* Packets dropped because the queue was full*/
+
+#if (MOVEMENT_STREAM_SIM_LINK_ENABLE == FEATURE_ENABLED)
+static uint32_t m_stream_sim_time_us;                           /* Time of the current simulated connection interval*/
+static uint8_t  m_stream_sim_credits;                           /* Notifications left in the current simulated connection interval*/
+volatile uint32_t m_bench_stream_elapsed_ms;                    /* Time streamed into the simulated link, counted in sample periods*/
+volatile uint32_t m_bench_stream_samples_per_s;                 /* Samples delivered per second by the simulated link*/
+#endif
+
 /**@brief Function for handling the Connect event.
 *
 * @param[in]   p_movement  Movement Service structure.
@@ -50,6 +68,14 @@ static void on_disconnect(ble_movement_t * p_movement, ble_evt_t * p_ble_evt)
     UNUSED_PARAMETER(p_ble_evt);
     ACCELEROMETER_CONNECTED_STATE= false; 
     p_movement->conn_handle = BLE_CONN_HANDLE_INVALID;
+
+#if (MOVEMENT_STREAM_SIM_LINK_ENABLE != FEATURE_ENABLED)
+    if (p_movement->is_stream_enabled)
+    {
+        p_movement->is_stream_enabled = false;
+        MOVEMENT_STREAM_CONFIG = true;       /*Stop the stream and restore the accelerometer configuration*/
+    }
+#endif
 }
 
 
@@ -84,6 +110,9 @@ static void write_evt_handler (ble_movement_t * p_movement, ble_movement_write_e
             CLEAR_MOVE_ALARM = false;
         }
         break;   
+    case BLE_MOVEMENT_STREAM_WRITE:
+        MOVEMENT_STREAM_CONFIG = true;
+        break;
     default:
         break;
     }
@@ -203,6 +232,26 @@ static void on_write(ble_movement_t * p_movement, ble_evt_t * p_ble_evt)
             }
         }
 
+        //write event for movement stream cccd
+
+        if (
+                (p_evt_write->handle == p_movement->movement_stream_handles.cccd_handle)
+                &&
+                (p_evt_write->len == 2)
+                &&
+                (p_movement->write_evt_handler != NULL)
+                )
+        {
+            ble_movement_write_evt_t evt;
+            evt.evt_type           = BLE_MOVEMENT_STREAM_WRITE;
+
+            // update the service structure
+            p_movement->is_stream_enabled = ble_srv_is_notification_enabled(p_evt_write->data);
+
+            // call application event handler
+            p_movement->write_evt_handler(p_movement, &evt);
+        }
+
     }
 
     // Write event for alarm set char value
@@ -245,6 +294,35 @@ static void on_write(ble_movement_t * p_movement, ble_evt_t * p_ble_evt)
         p_movement->write_evt_handler(p_movement, &evt);
     }		
 
+    // Write event for stream rate char value, only AMSR settings are accepted
+
+    if ( 
+            (p_evt_write->handle == p_movement->movement_stream_rate_handles.value_handle) 
+            && 
+            (p_evt_write->len == 1)
+            &&
+            (p_movement->write_evt_handler != NULL)
+            )
+    {  
+        ble_movement_write_evt_t evt;
+        uint16_t                 len = sizeof(uint8_t);
+        evt.evt_type           = BLE_MOVEMENT_STREAM_WRITE;
+
+        if (p_evt_write->data[0] <= MMA7660_AMSR_1SAMPLES)
+        {
+            // update the service structure
+            p_movement->movement_stream_rate =   p_evt_write->data[0];
+
+            // call application event handler
+            p_movement->write_evt_handler(p_movement, &evt);
+        }
+        else
+        {
+            // keep the current rate in the characteristic
+            (void)sd_ble_gatts_value_set(p_movement->movement_stream_rate_handles.value_handle, 0, &len, &p_movement->movement_stream_rate);
+        }
+    }
+
 
 }
 
@@ -546,6 +624,134 @@ static uint32_t movement_alarm_char_add(ble_movement_t * p_movement, const ble_m
     return NRF_SUCCESS;
 }
 
+/**@brief Function for adding the movement stream characteristics.
+*
+* @param[in]   p_movement       Movement Service structure.
+* @param[in]   p_movement_init   Information needed to initialize the service.
+*
+* @return      NRF_SUCCESS on success, otherwise an error code.
+*/
+
+static uint32_t movement_stream_char_add(ble_movement_t * p_movement, const ble_movement_init_t * p_movement_init)
+{
+    uint32_t            err_code;
+    ble_gatts_char_md_t char_md;
+    ble_gatts_attr_md_t cccd_md;
+    ble_gatts_attr_t    attr_char_value;
+    ble_uuid_t          ble_uuid;
+    ble_gatts_attr_md_t attr_md;
+    static uint8_t      movement_stream[MOVEMENT_STREAM_PACKET_LEN];
+
+    // Add movement stream characteristic, values are only sent as notifications
+    memset(&cccd_md, 0, sizeof(cccd_md));
+
+    BLE_GAP_CONN_SEC_MODE_SET_OPEN(&cccd_md.read_perm);
+    cccd_md.write_perm = p_movement_init->movement_char_attr_md.cccd_write_perm;
+    cccd_md.vloc = BLE_GATTS_VLOC_STACK;
+
+    memset(&char_md, 0, sizeof(char_md));
+
+    char_md.char_props.read   = 0;
+    char_md.char_props.notify = 1;
+    char_md.p_char_pf         = NULL;
+    char_md.p_user_desc_md    = NULL;
+    char_md.p_cccd_md         = &cccd_md;
+    char_md.p_sccd_md         = NULL;
+
+    // Adding cutom UUID
+    ble_uuid.type = p_movement->uuid_type;
+    ble_uuid.uuid = SENTRY_PROFILE_MOVEMENT_STREAM_CHAR_UUID;
+
+    memset(&attr_md, 0, sizeof(attr_md));
+
+    attr_md.read_perm  = p_movement_init->movement_char_attr_md.read_perm;
+    attr_md.write_perm = p_movement_init->movement_char_attr_md2.write_perm;
+    attr_md.vloc       = BLE_GATTS_VLOC_USER;
+    attr_md.rd_auth    = 0;
+    attr_md.wr_auth    = 0;
+    attr_md.vlen       = 0;
+
+    memset(&attr_char_value, 0, sizeof(attr_char_value));
+
+    attr_char_value.p_uuid       = &ble_uuid;
+    attr_char_value.p_attr_md    = &attr_md;
+    attr_char_value.init_len     = sizeof(movement_stream);
+    attr_char_value.init_offs    = 0;
+    attr_char_value.max_len      = sizeof(movement_stream);
+    attr_char_value.p_value      = movement_stream;
+
+    err_code = sd_ble_gatts_characteristic_add(p_movement->service_handle, &char_md,
+    &attr_char_value,
+    &p_movement->movement_stream_handles);
+    if (err_code != NRF_SUCCESS)
+    {
+        return err_code;
+    }
+
+    return NRF_SUCCESS;
+}
+
+/**@brief Function for adding the movement stream rate characteristics.
+*
+* @param[in]   p_movement        movement Service structure.
+* @param[in]   p_movement_init   Information needed to initialize the service.
+*
+* @return      NRF_SUCCESS on success, otherwise an error code.
+*/
+
+static uint32_t movement_stream_rate_char_add(ble_movement_t * p_movement, const ble_movement_init_t * p_movement_init)
+{
+    uint32_t            err_code;
+    ble_gatts_char_md_t char_md;
+    ble_gatts_attr_t    attr_char_value;
+    ble_uuid_t          ble_uuid;
+    ble_gatts_attr_md_t attr_md;
+    static uint8_t      movement_stream_rate;
+
+    memset(&char_md, 0, sizeof(char_md));
+
+    char_md.char_props.read   = 1;
+    char_md.char_props.notify = 0;
+    char_md.p_char_pf         = NULL;
+    char_md.p_user_desc_md    = NULL;
+    char_md.p_cccd_md         = NULL;
+    char_md.p_sccd_md         = NULL;
+
+    // Adding cutom UUID
+    ble_uuid.type = p_movement->uuid_type;
+    ble_uuid.uuid = SENTRY_PROFILE_MOVEMENT_STREAM_RATE_CHAR_UUID; 
+
+    memset(&attr_md, 0, sizeof(attr_md));
+
+    attr_md.read_perm  = p_movement_init->movement_char_attr_md.read_perm;
+    attr_md.write_perm = p_movement_init->movement_char_attr_md.write_perm;
+    attr_md.vloc       = BLE_GATTS_VLOC_USER;
+    attr_md.rd_auth    = 0;
+    attr_md.wr_auth    = 0;
+    attr_md.vlen       = 0;
+
+    movement_stream_rate = p_movement_init->movement_stream_rate;
+
+    memset(&attr_char_value, 0, sizeof(attr_char_value));
+
+    attr_char_value.p_uuid       = &ble_uuid;
+    attr_char_value.p_attr_md    = &attr_md;
+    attr_char_value.init_len     = sizeof(uint8_t);
+    attr_char_value.init_offs    = 0;
+    attr_char_value.max_len      = sizeof(uint8_t);
+    attr_char_value.p_value      = &movement_stream_rate;
+
+    err_code = sd_ble_gatts_characteristic_add(p_movement->service_handle, &char_md,
+    &attr_char_value,
+    &p_movement->movement_stream_rate_handles);
+    if (err_code != NRF_SUCCESS)
+    {
+        return err_code;
+    }
+
+    return NRF_SUCCESS;
+}
+
 /**@brief Function for initializing the Movement service.
 *
 * @param[in]   p_movement        Movement Service structure.
@@ -578,6 +784,12 @@ uint32_t ble_movement_init(ble_movement_t * p_movement, const ble_movement_init_
     p_movement->movement_alarm_set        = p_movement_init->movement_alarm_set;
     p_movement->movement_alarm_clear      = p_movement_init->movement_alarm_clear;
     p_movement->movement_alarm   		      = p_movement_init->movement_alarm;
+    p_movement->movement_stream_rate      = p_movement_init->movement_stream_rate;
+    p_movement->is_stream_enabled         = false;
+
+#if (MOVEMENT_STREAM_SIM_LINK_ENABLE == FEATURE_ENABLED)
+    p_movement->is_stream_enabled         = true;      /* Stream into the simulated link from startup*/
+#endif
     
 
 
@@ -611,6 +823,18 @@ uint32_t ble_movement_init(ble_movement_t * p_movement, const ble_movement_init_
         return err_code;
     }
 
+    err_code =  movement_stream_char_add(p_movement, p_movement_init);        /* Add movement stream characteristic*/
+    if (err_code != NRF_SUCCESS)
+    {
+        return err_code;
+    }
+
+    err_code =  movement_stream_rate_char_add(p_movement, p_movement_init);   /* Add movement stream rate characteristic*/
+    if (err_code != NRF_SUCCESS)
+    {
+        return err_code;
+    }
+
     return NRF_SUCCESS;
 
 }
@@ -628,22 +852,27 @@ uint32_t ble_movement_alarm_check(ble_movement_t * p_movement)
 
     uint8_t  alarm = 0x00;
     uint32_t current_xyz;
+    bool     xyz_valid;
 
     uint16_t len = sizeof(uint8_t);
     uint16_t len1 = sizeof(current_xyz_array);  
 
     twi_turn_ON();
-
-
-    if(false == MMA7660_read_xyz_reg_one_time(&current_xyz)) return false;
-
+    xyz_valid = MMA7660_read_xyz_reg_one_time(&current_xyz);
     twi_turn_OFF();
 
-    current_xyz_array[0] = current_xyz;
-    current_xyz_array[1] = current_xyz >> 8;  
-    current_xyz_array[2] = current_xyz >> 16;
+    if (xyz_valid)
+    {
+        current_xyz_array[0] = current_xyz;
+        current_xyz_array[1] = current_xyz >> 8;  
+        current_xyz_array[2] = current_xyz >> 16;
+    }
 
-    if ((p_movement->conn_handle != BLE_CONN_HANDLE_INVALID) && p_movement->is_notification_supported)
+    if (!xyz_valid)
+    {
+        err_code = NRF_SUCCESS;                  /* No sample to send, the alarm below comes from the INT pin*/
+    }
+    else if ((p_movement->conn_handle != BLE_CONN_HANDLE_INVALID) && p_movement->is_notification_supported)
     {
         ble_gatts_hvx_params_t hvx_params;
 
@@ -782,3 +1011,167 @@ uint32_t reset_alarm(ble_movement_t * p_movement)
     return NRF_SUCCESS;	
 }
 
+/**@brief Function to write a 6 bit value into the stream packet at a bit position, LSB first.
+*
+* @param[in]   p_payload    Samples of the stream packet, cleared when the packet is started.
+* @param[in]   bit_pos      Bit position of the value in p_payload.
+* @param[in]   value        6 bit value.
+*/
+static void stream_pack(uint8_t * p_payload, uint16_t bit_pos, uint8_t value)
+{
+    uint16_t index = bit_pos >> 3;
+    uint8_t  shift = bit_pos & 0x07;
+
+    p_payload[index] |= (uint8_t)(value << shift);
+
+    // the value continues in the next byte
+    if (shift > (8 - MOVEMENT_STREAM_SAMPLE_BITS))
+    {
+        p_payload[index + 1] |= (uint8_t)(value >> (8 - shift));
+    }
+}
+
+/**@brief Function to send one stream packet, as a notification or into the simulated link.
+*
+* @param[in]   p_movement        Movement  Service structure.
+* @param[in]   p_packet          Packet of MOVEMENT_STREAM_PACKET_LEN bytes.
+*
+* @return      NRF_SUCCESS on success, BLE_ERROR_NO_TX_BUFFERS when the packet must be sent later.
+*/
+static uint32_t stream_send(ble_movement_t * p_movement, uint8_t * p_packet)
+{
+#if (MOVEMENT_STREAM_SIM_LINK_ENABLE == FEATURE_ENABLED)
+    UNUSED_PARAMETER(p_movement);
+    UNUSED_PARAMETER(p_packet);
+
+    if (m_stream_sim_credits == 0)
+    {
+        return BLE_ERROR_NO_TX_BUFFERS;
+    }
+    m_stream_sim_credits--;
+
+    return NRF_SUCCESS;
+#else
+    uint16_t               len = MOVEMENT_STREAM_PACKET_LEN;
+    ble_gatts_hvx_params_t hvx_params;
+
+    if ((p_movement->conn_handle == BLE_CONN_HANDLE_INVALID) || !p_movement->is_stream_enabled)
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+
+    memset(&hvx_params, 0, sizeof(hvx_params));
+
+    hvx_params.handle   = p_movement->movement_stream_handles.value_handle;
+    hvx_params.type     = BLE_GATT_HVX_NOTIFICATION;
+    hvx_params.offset   = 0;
+    hvx_params.p_len    = &len;
+    hvx_params.p_data   = p_packet;
+
+    return sd_ble_gatts_hvx(p_movement->conn_handle, &hvx_params);
+#endif
+}
+
+/**@brief Function to send the queued stream packets while the stack has free TX buffers.
+*
+* @param[in]   p_movement        Movement  Service structure.
+*
+* @return      NRF_SUCCESS on success, otherwise an error code.
+*/
+static uint32_t stream_flush(ble_movement_t * p_movement)
+{
+    uint32_t err_code = NRF_SUCCESS;
+
+    while (m_stream_queue_count > 0)
+    {
+        err_code = stream_send(p_movement, m_stream_queue[m_stream_queue_head]);
+        if (err_code != NRF_SUCCESS)
+        {
+            break;
+        }
+
+        m_stream_queue_head = (m_stream_queue_head + 1) % MOVEMENT_STREAM_QUEUE_LEN;
+        m_stream_queue_count--;
+        m_bench_stream_samples_sent += MOVEMENT_STREAM_SAMPLES_PER_PACKET;
+    }
+
+    // Packets stay queued until a TX buffer is free, they are sent after one of the next samples
+    if (err_code == BLE_ERROR_NO_TX_BUFFERS)
+    {
+        err_code = NRF_SUCCESS;
+    }
+
+    return err_code;
+}
+
+/**@brief Function to add the filled packet to the queue, dropping the oldest packet if the queue is full.
+*/
+static void stream_queue_put(void)
+{
+    if (m_stream_queue_count == MOVEMENT_STREAM_QUEUE_LEN)
+    {
+        m_stream_queue_head = (m_stream_queue_head + 1) % MOVEMENT_STREAM_QUEUE_LEN;
+        m_stream_queue_count--;
+        m_bench_stream_packets_dropped++;
+    }
+
+    memcpy(m_stream_queue[(m_stream_queue_head + m_stream_queue_count) % MOVEMENT_STREAM_QUEUE_LEN], m_stream_packet, MOVEMENT_STREAM_PACKET_LEN);
+    m_stream_queue_count++;
+}
+
+/**@brief Function to discard the samples and packets of a previous stream.
+*/
+void ble_movement_stream_reset(void)
+{
+    m_stream_sample_count = 0;
+    m_stream_queue_head   = 0;
+    m_stream_queue_count  = 0;
+}
+
+/**@brief Function adds an XYZ sample to the movement stream and sends the full packets.
+*
+* @param[in]   p_movement        Movement  Service structure.
+* @param[in]   xyz               Xout, Yout and Zout in byte 2, 1 and 0, as read by MMA7660_read_xyz_reg_one_time().
+*
+* @return      NRF_SUCCESS on success, otherwise an error code.
+*/
+uint32_t ble_movement_stream_add(ble_movement_t * p_movement, uint32_t xyz)
+{
+    uint8_t  axis;
+    uint16_t bit_pos;
+
+#if (MOVEMENT_STREAM_SIM_LINK_ENABLE == FEATURE_ENABLED)
+    // The simulated link sends MOVEMENT_STREAM_SIM_TX_BUFFERS notifications in each connection interval,
+    // the time is counted in sample periods so no RTC is needed
+    m_stream_sim_time_us += 1000000UL / MMA7660_sample_rate(p_movement->movement_stream_rate);
+    if (m_stream_sim_time_us >= (MOVEMENT_STREAM_SIM_CONN_INTERVAL_MS * 1000UL))
+    {
+        m_stream_sim_time_us        -= (MOVEMENT_STREAM_SIM_CONN_INTERVAL_MS * 1000UL);
+        m_stream_sim_credits         = MOVEMENT_STREAM_SIM_TX_BUFFERS;
+        m_bench_stream_elapsed_ms   += MOVEMENT_STREAM_SIM_CONN_INTERVAL_MS;
+        m_bench_stream_samples_per_s = (uint32_t)(((uint64_t)m_bench_stream_samples_sent * 1000) / m_bench_stream_elapsed_ms);
+    }
+#endif
+
+    // Start a new packet with the sequence number
+    if (m_stream_sample_count == 0)
+    {
+        memset(m_stream_packet, 0, sizeof(m_stream_packet));
+        m_stream_packet[0] = m_stream_sequence++;
+    }
+
+    for (axis = 0; axis < 3; axis++)
+    {
+        bit_pos = ((m_stream_sample_count * 3) + axis) * MOVEMENT_STREAM_SAMPLE_BITS;
+        stream_pack(&m_stream_packet[1], bit_pos, (uint8_t)(xyz >> ((2 - axis) * 8)) & MMA7660_XYZ_MASK);   /* X, Y then Z*/
+    }
+
+    m_stream_sample_count++;
+    if (m_stream_sample_count == MOVEMENT_STREAM_SAMPLES_PER_PACKET)
+    {
+        m_stream_sample_count = 0;
+        stream_queue_put();
+    }
+
+    return stream_flush(p_movement);
+}
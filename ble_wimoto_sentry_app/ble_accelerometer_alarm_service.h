@@ -27,6 +27,16 @@
 #include "ble_srv_common.h"
 #include "wimoto_sensors.h"
 
+#define MOVEMENT_STREAM_SAMPLES_PER_PACKET   8                                   /**< XYZ samples batched in one stream notification */
+#define MOVEMENT_STREAM_SAMPLE_BITS          6                                   /**< Bits of each axis, as read from Xout, Yout and Zout */
+#define MOVEMENT_STREAM_PACKET_LEN           (1 + ((MOVEMENT_STREAM_SAMPLES_PER_PACKET * 3 * MOVEMENT_STREAM_SAMPLE_BITS) / 8))  /**< Sequence number and 18 bytes of samples, fits in one notification */
+#define MOVEMENT_STREAM_QUEUE_LEN            4                                   /**< Packets kept while the stack has no free TX buffer, the oldest is dropped when full */
+#define MOVEMENT_STREAM_DEFAULT_RATE         MMA7660_AMSR_32SAMPLES              /**< Default AMSR setting of the stream rate characteristic */
+
+#define MOVEMENT_STREAM_SIM_LINK_ENABLE      0x00                                /**< 0x00 - Disabled 0x01 - Enabled, stream into a simulated link instead of the connection */
+#define MOVEMENT_STREAM_SIM_CONN_INTERVAL_MS 500                                 /**< Connection interval of the simulated link, same as MIN_CONN_INTERVAL */
+#define MOVEMENT_STREAM_SIM_TX_BUFFERS       6                                   /**< Notifications the simulated link sends in each connection interval */
+
 
 /**@brief movement Service event type. */
 typedef enum
@@ -45,7 +55,8 @@ typedef struct
 typedef enum
 {
     BLE_MOVEMENT_ALARM_SET_WRITE,                             /**< Alarm set write event. */
-    BLE_MOVEMENT_ALARM_CLEAR_WRITE                            /**< Alarm clear write event. */          
+    BLE_MOVEMENT_ALARM_CLEAR_WRITE,                           /**< Alarm clear write event. */
+    BLE_MOVEMENT_STREAM_WRITE                                 /**< Stream notification or stream rate write event. */
 } ble_movement_write_evt_type_t;
 
 /**@brief movement Service value write event. */
@@ -74,6 +85,7 @@ typedef struct
     uint8_t												movement_alarm_set;             /**< Alarm set for movement */
     uint8_t                       movement_alarm_clear;           /**< Alarm clear for movement */
     uint8_t												movement_alarm;   			        /**< Alarm for movement */
+    uint8_t                       movement_stream_rate;           /**< AMSR setting of the movement stream */
     ble_srv_cccd_security_mode_t  movement_char_attr_md;          /**< Initial security level for movement characteristics attribute */
     ble_srv_cccd_security_mode_t  movement_char_attr_md2;         /**< Initial security level for movement characteristics attribute */
     ble_gap_conn_sec_mode_t       battery_level_report_read_perm; /**< Initial security level for movement report read attribute */
@@ -91,10 +103,14 @@ typedef struct ble_movement_s
     ble_gatts_char_handles_t      movement_alarm_clear_handles;   /**< Handles for movement alarm clear characteristic. */
     ble_gatts_char_handles_t      movement_alarm_handles;      	  /**< Handles for movement alarm characteristic. */
     ble_gatts_char_handles_t      current_movement_cordinates_handles;
+    ble_gatts_char_handles_t      movement_stream_handles;        /**< Handles for movement stream characteristic. */
+    ble_gatts_char_handles_t      movement_stream_rate_handles;   /**< Handles for movement stream rate characteristic. */
     uint16_t                      report_ref_handle;          	  /**< Handle of the Report Reference descriptor. */
     uint8_t												movement_alarm_set;   	        /**< Alarm set for movement **/
     uint8_t												movement_alarm_clear;   	      /**< Alarm clear for movement **/
     uint8_t												movement_alarm;   			        /**< Alarm for movement **/
+    uint8_t                       movement_stream_rate;           /**< AMSR setting of the movement stream **/
+    bool                          is_stream_enabled;              /**< TRUE while notification of the movement stream is enabled. */
     uint16_t                      conn_handle;                    /**< Handle of the current connection (as provided by the BLE stack, is BLE_CONN_HANDLE_INVALID if not in a connection). */
     bool                          is_notification_supported;      /**< TRUE if notification of movement  is supported. */
 } ble_movements_t;                                                
@@ -149,6 +165,24 @@ uint32_t ble_movement_alarm_check(ble_movement_t * p_movement);
 */
 uint32_t reset_alarm(ble_movement_t * p_movement);
 
+/**@brief Function for adding an XYZ sample to the movement stream.
+*
+* @details Samples are packed into a notification of MOVEMENT_STREAM_PACKET_LEN bytes. Byte 0 is a
+*          sequence number, so the client can detect lost packets. The following bytes hold the
+*          6 bit Xout, Yout and Zout of MOVEMENT_STREAM_SAMPLES_PER_PACKET samples as one bit
+*          stream, LSB first, in the order X, Y, Z of the first sample, then of the second sample.
+*          A full packet is queued and the queue is sent while the stack has free TX buffers.
+*
+* @param[in]   p_movement          movement Service structure.
+* @param[in]   xyz                 Sample as read by MMA7660_read_xyz_reg_one_time().
+*
+* @return      NRF_SUCCESS on success, otherwise an error code.
+*/
+uint32_t ble_movement_stream_add(ble_movement_t * p_movement, uint32_t xyz);
+
+/**@brief Function for discarding the samples and packets of a previous stream, called when a stream is started.
+*/
+void ble_movement_stream_reset(void);
 
 /**@brief Function for LED blinking (Used for debugging).
 */
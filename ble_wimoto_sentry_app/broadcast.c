@@ -27,35 +27,136 @@
 #include "nrf_temp.h"
 #include "app_timer.h"
 #include "wimoto_sensors.h"
+#include "battery.h"
 #include "wimoto.h"
+#include "ble_data_log_service.h"
+#include "benchmark.h"
 #include "app_gpiote.h"
 #include "ble_accelerometer_alarm_service.h" 
 
-#define APP_ADV_INTERVAL                     0x81A                                      /**< The advertising interval (in units of 0.625 ms. This value corresponds to ~1.2 s). */
 #define APP_ADV_TIMEOUT_IN_SECONDS           0                                          /**< The advertising timeout in units of seconds. */
 
 #define DEAD_BEEF                            0xDEADBEEF                                 /**< Value used as error code on stack dump, can be used to identify stack location on stack unwind. */
 
+#define BROADCAST_BENCHMARK_ENABLE           0x00                                       /**< 0x00 - Disabled 0x01 - Enabled, compares the cycles of an in-place payload update against a full ble_advdata_set() rebuild */
+
+#define ADV_DEVICE_NAME_LEN                  8                                          /**< Length of the device name (hex digits of the device address). */
+#define ADV_MANUF_DATA_LEN                   4                                          /**< Length of the sensor data carried as manufacturer specific data. */
+#define ADV_HISTORY_ENABLE                   0x01                                       /**< 0x00 - Disabled 0x01 - Enabled, adds a sequence counter and a short history of delta encoded samples in the scan response */
+#define ADV_FIELD_COUNT                      4                                          /**< Number of readings in the manufacturer data. */
+#define ADV_HISTORY_UNKNOWN                  0x80                                       /**< History entry of a missing sample, or of a change that does not fit a signed byte. */
+#define ADV_ALARM_ENABLE                     0x01                                       /**< 0x00 - Disabled 0x01 - Enabled, adds an alarm byte to the manufacturer data and advertises fast for a few seconds whenever it changes */
+#define ADV_ALARM_BURST_INTERVAL             BLE_GAP_ADV_NONCON_INTERVAL_MIN            /**< Interval of the burst after an alarm change, 100 ms is the fastest the SoftDevice allows for scannable or non-connectable advertising. */
+#define ADV_ALARM_BURST_COUNT                30                                         /**< Number of radio events in a burst, about 3 s at the burst interval. */
+#define ADV_EVENT_ENABLE                     0x01                                       /**< 0x00 - Disabled 0x01 - Enabled, refreshes the payload as soon as the PIR or the MMA7660 interrupts, adds an event counter and time stamp and starts a burst (with ADV_ALARM_ENABLE) */
+#define ADV_VERSION_ENABLE                   0x01                                       /**< 0x00 - Disabled 0x01 - Enabled, the sequence counter only advances when the payload changes, so it doubles as a data version scanners can deduplicate on, with ADV_HISTORY_ENABLE only */
+#define ADV_TELEMETRY_ENABLE                 0x01                                       /**< 0x00 - Disabled 0x01 - Enabled, adds battery voltages, firmware version, log fill level, alarms and uptime to the scan response, with ADV_HISTORY_ENABLE only */
+
+#if (ADV_TELEMETRY_ENABLE == FEATURE_ENABLED)
+#define ADV_HISTORY_LEN                      4                                          /**< Number of previous samples in the scan response, one byte per reading each. */
+#define ADV_TELEMETRY_LEN                    10                                         /**< Length of the telemetry in the scan response. */
+#else
+#define ADV_HISTORY_LEN                      6
+#define ADV_TELEMETRY_LEN                    0
+#endif
+
+#if (ADV_HISTORY_ENABLE == FEATURE_ENABLED)
+#define ADV_SEQ_LEN                          1                                          /**< Sequence counter after the readings, incremented on every refresh that pushes a sample, with ADV_VERSION_ENABLE only when the payload changed. */
+#else
+#define ADV_SEQ_LEN                          0
+#endif
+
+#if (ADV_ALARM_ENABLE == FEATURE_ENABLED)
+#define ADV_ALARM_LEN                        1                                          /**< Alarm byte after the readings, one BROADCAST_ALARM() per reading. */
+#else
+#define ADV_ALARM_LEN                        0
+#endif
+
+#if (ADV_EVENT_ENABLE == FEATURE_ENABLED)
+#define ADV_EVENT_LEN                        3                                          /**< Event counter and time stamp after the alarm byte. */
+#else
+#define ADV_EVENT_LEN                        0
+#endif
+
+/* Offsets of the AD structures in the pre-encoded advertising packet. They are laid out in the
+*  order ble_advdata_set() encodes them (name, flags, manufacturer data, service data), so the
+*  packet on air is unchanged. */
+#define ADV_NAME_AD_OFFSET                   0
+#define ADV_FLAGS_AD_OFFSET                  (ADV_NAME_AD_OFFSET + 2 + ADV_DEVICE_NAME_LEN)
+#define ADV_MANUF_AD_OFFSET                  (ADV_FLAGS_AD_OFFSET + 3)
+#define ADV_MANUF_DATA_OFFSET                (ADV_MANUF_AD_OFFSET + 4)
+#define ADV_SERVICE_AD_OFFSET                (ADV_MANUF_DATA_OFFSET + ADV_MANUF_DATA_LEN + ADV_ALARM_LEN + ADV_EVENT_LEN + ADV_SEQ_LEN)
+#define ADV_DATA_LEN                         (ADV_SERVICE_AD_OFFSET + 5)
+
+/* Offsets of the sensor fields, patched in place on every refresh. */
+#define ADV_XYZ_OFFSET                       (ADV_MANUF_DATA_OFFSET + 0)                /**< X, Y and Z registers, 1 byte each */
+#define ADV_PIR_OFFSET                       (ADV_MANUF_DATA_OFFSET + 3)                /**< PIR presence, 1 byte */
+#define ADV_ALARM_OFFSET                     (ADV_MANUF_DATA_OFFSET + ADV_MANUF_DATA_LEN) /**< Alarm byte, with ADV_ALARM_ENABLE only */
+#define ADV_EVENT_COUNT_OFFSET               (ADV_ALARM_OFFSET + ADV_ALARM_LEN)         /**< Number of PIR and movement interrupts, 1 byte, with ADV_EVENT_ENABLE only */
+#define ADV_EVENT_TIME_OFFSET                (ADV_EVENT_COUNT_OFFSET + 1)               /**< Uptime in seconds of the latest interrupt, low 16 bits MSB first */
+#define ADV_SEQ_OFFSET                       (ADV_EVENT_COUNT_OFFSET + ADV_EVENT_LEN)   /**< Sequence counter, 1 byte, with ADV_HISTORY_ENABLE only */
+#define ADV_BATTERY_OFFSET                   (ADV_SERVICE_AD_OFFSET + 4)                /**< Battery level in percent */
+
+/* Offsets in the pre-encoded scan response. It holds one manufacturer specific data structure
+*  with the sequence counter of the newest sample and the telemetry, followed by the short
+*  history. Multi byte telemetry fields are MSB first like the readings. */
+#define SR_MANUF_AD_OFFSET                   0
+#define SR_SEQ_OFFSET                        (SR_MANUF_AD_OFFSET + 4)
+#define SR_TELEMETRY_OFFSET                  (SR_SEQ_OFFSET + 1)
+#define SR_BATTERY_UNLOADED_OFFSET           (SR_TELEMETRY_OFFSET + 0)                  /**< Filtered supply voltage after a radio event, in SR_BATTERY_MV_PER_UNIT, 0 until the first sample */
+#define SR_BATTERY_LOADED_OFFSET             (SR_TELEMETRY_OFFSET + 1)                  /**< Filtered supply voltage during a radio event, in SR_BATTERY_MV_PER_UNIT, 0 until the first sample */
+#define SR_FIRMWARE_OFFSET                   (SR_TELEMETRY_OFFSET + 2)                  /**< Firmware version, major and minor number */
+#define SR_LOG_FILL_OFFSET                   (SR_TELEMETRY_OFFSET + 4)                  /**< Data logger fill level in percent */
+#define SR_ALARM_OFFSET                      (SR_TELEMETRY_OFFSET + 5)                  /**< Alarm byte of the advertising data, 0 without ADV_ALARM_ENABLE */
+#define SR_UPTIME_OFFSET                     (SR_TELEMETRY_OFFSET + 6)                  /**< Seconds since power on, 4 bytes */
+#define SR_BATTERY_MV_PER_UNIT               20                                         /**< Resolution of the battery voltages, one byte holds up to 5.1 V. The battery level in percent is in the advertising data. */
+#define SR_HISTORY_OFFSET                    (SR_TELEMETRY_OFFSET + ADV_TELEMETRY_LEN)
+#define SR_DATA_LEN                          (SR_HISTORY_OFFSET + ADV_HISTORY_LEN * ADV_FIELD_COUNT)
+
 #define APP_TIMER_PRESCALER                  0                                          /**< Value of the RTC1 PRESCALER register. */
 #define APP_TIMER_MAX_TIMERS                 3                                          /**< Maximum number of simultaneously created timers. */
 #define APP_TIMER_OP_QUEUE_SIZE              4                                          /**< Size of timer operation queues. */
 #define MODE_SWITCH_INTERVAL                 APP_TIMER_TICKS(20000, APP_TIMER_PRESCALER)
 
-/**@brief Macro to convert the result of ADC conversion in millivolts.
-*
-* @param[in]  ADC_VALUE   ADC result.
-* @retval     Result converted to millivolts.
-*/
-#define ADC_RESULT_IN_MILLI_VOLTS(ADC_VALUE)\
-    ((((ADC_VALUE) * ADC_REF_VOLTAGE_IN_MILLIVOLTS) / 255) * ADC_PRE_SCALING_COMPENSATION)
-
-#define ADC_REF_VOLTAGE_IN_MILLIVOLTS        1200                                      /**< Reference voltage (in milli volts) used by ADC while doing conversion. */
-#define ADC_PRE_SCALING_COMPENSATION         3                                         /**< The ADC is configured to use VDD with 1/3 prescaling as input. And hence the result of conversion is to be multiplied by 3 to get the actual value of the battery voltage.*/
-#define DIODE_FWD_VOLT_DROP_MILLIVOLTS       270                                       /**< Typical forward voltage drop of the diode (Part no: SD103ATW-7-F) that is connected in series with the voltage supply. This is the voltage drop when the forward current is 1mA. Source: Data sheet of 'SURFACE MOUNT SCHOTTKY BARRIER DIODE ARRAY' available at www.diodes.com. */
-
 
 extern bool 	                               BROADCAST_MODE;
+extern uint32_t     m_uptime_seconds;                                                  /**< Seconds since power on, counted by connect.c. */
+#if (MODE_SWITCH_BENCHMARK_ENABLE == FEATURE_ENABLED)
+extern volatile uint32_t m_bench_switch_ticks;
+#endif
 static volatile bool                         m_do_update = false;
+#if (ADV_EVENT_ENABLE == FEATURE_ENABLED)
+static volatile bool     m_event_pending = false;                                       /**< Set by a PIR or movement interrupt, cleared once the payload is refreshed. */
+static volatile uint8_t  m_event_count = 0;                                             /**< Number of PIR and movement interrupts since power on. */
+static volatile uint32_t m_event_time  = 0;                                             /**< Uptime in seconds of the latest interrupt. */
+#endif
+static char          m_device_name[ADV_DEVICE_NAME_LEN + 1];                             /**< Device name, also copied into the advertising packet. */
+static uint8_t       m_adv_data[ADV_DATA_LEN];                                           /**< Pre-encoded advertising packet. */
+adv_policy_t         m_adv_policy = {ADV_POLICY_DEFAULT_FAST_INTERVAL,                  /**< Broadcast interval policy, written over GATT in connectable mode. */
+                                     ADV_POLICY_DEFAULT_SLOW_INTERVAL,
+                                     ADV_POLICY_DEFAULT_THRESHOLD};
+static uint8_t       m_adv_backoff = 0;                                                 /**< Number of times the fast interval has been doubled. */
+static uint16_t      m_adv_interval;                                                    /**< Interval advertising was last started with. */
+#if (ADV_ALARM_ENABLE == FEATURE_ENABLED)
+static uint8_t       m_adv_burst = 0;                                                   /**< Radio events left in the fast burst after an alarm change. */
+static uint8_t       m_adv_burst_events = 0;                                            /**< Radio events of the burst since the sensors were refreshed. */
+#endif
+static const uint8_t m_adv_field_len[ADV_FIELD_COUNT] = {1, 1, 1, 1};                                   /**< Length of each reading in the manufacturer data (X, Y, Z, PIR). */
+static uint8_t       m_adv_prev_data[ADV_MANUF_DATA_LEN];                               /**< Manufacturer data of the previous refresh. */
+#if (ADV_HISTORY_ENABLE == FEATURE_ENABLED)
+static uint8_t       m_sr_data[SR_DATA_LEN];                                             /**< Pre-encoded scan response with the short history. */
+static uint8_t       m_history_prev_data[ADV_MANUF_DATA_LEN];                            /**< Readings of the newest sample in the history. */
+static bool          m_history_prev_valid = false;                                       /**< False until the first sample after entering broadcast mode. */
+#if (ADV_VERSION_ENABLE == FEATURE_ENABLED)
+static uint8_t       m_version_prev_data[ADV_SEQ_OFFSET - ADV_MANUF_DATA_OFFSET];        /**< Manufacturer data of the newest sample, up to the sequence counter. */
+static uint8_t       m_version_prev_battery;                                             /**< Battery level of the newest sample. */
+#endif
+#endif
+
+#if (BROADCAST_BENCHMARK_ENABLE == FEATURE_ENABLED)
+volatile uint32_t    m_bench_patch_cycles   = 0;                                         /**< Cycles spent patching the sensor fields and pushing the packet. */
+volatile uint32_t    m_bench_rebuild_cycles = 0;                                         /**< Cycles spent rebuilding and encoding the packet with ble_advdata_set(). */
+#endif
 
 
 /*****************************************************************************
@@ -112,136 +213,321 @@ void assert_nrf_callback(uint16_t line_num, const uint8_t * p_file_name)
 * Static Event Handling Functions
 *****************************************************************************/
 
-/**@brief Application's BLE Stack event handler.
+/**@brief GAP initialization.
 *
-* @param[in]   p_ble_evt   Bluetooth stack event.
+* @details This function shall be used to setup all the necessary GAP (Generic Access Profile)
+*          parameters of the device. It also sets the permissions and appearance.
 */
-static void on_ble_evt(ble_evt_t * p_ble_evt)
+static void gap_params_init(void)
 {
-    uint32_t        err_code      = NRF_SUCCESS;
+    static const char hex_digits[] = "0123456789ABCDEF";
 
-    switch (p_ble_evt->header.evt_id)
-    {
-    default:
-        break;
-    }
+    uint32_t                err_code;
+    ble_gap_conn_sec_mode_t sec_mode;
+
+    m_device_name[0] = hex_digits[(NRF_FICR->DEVICEADDR[0] >> 28) & 0xf];
+    m_device_name[1] = hex_digits[(NRF_FICR->DEVICEADDR[0] >> 24) & 0xf];
+    m_device_name[2] = hex_digits[(NRF_FICR->DEVICEADDR[0] >> 20) & 0xf];
+    m_device_name[3] = hex_digits[(NRF_FICR->DEVICEADDR[0] >> 16) & 0xf];
+    m_device_name[4] = hex_digits[(NRF_FICR->DEVICEADDR[0] >> 12) & 0xf];
+    m_device_name[5] = hex_digits[(NRF_FICR->DEVICEADDR[0] >> 8) & 0xf];
+    m_device_name[6] = hex_digits[(NRF_FICR->DEVICEADDR[0] >> 4) & 0xf];
+    m_device_name[7] = hex_digits[NRF_FICR->DEVICEADDR[0] & 0xf];
+    m_device_name[8] = '\0';
+
+    BLE_GAP_CONN_SEC_MODE_SET_OPEN(&sec_mode);
 
+    err_code = sd_ble_gap_device_name_set(&sec_mode, (uint8_t *) m_device_name, strlen(m_device_name));
     APP_ERROR_CHECK(err_code);
+
 }
 
 
-/**@brief Dispatches a BLE stack event to all modules with a BLE stack event handler.
+/**@brief Function for getting the battery level of the filtered unloaded supply voltage.
 *
-* @details This function is called from the BLE Stack event interrupt handler after a BLE stack
-*          event has been received.
+* @details The voltage is sampled by battery.c after the next radio event and filtered, so the
+*          level does not drop with the radio current or change with the noise of one sample. The
+*          previous level is kept until the first sample.
+*/
+static uint8_t do_battery_measurement(void)
+{
+    battery_voltage_t voltage;
+
+    battery_voltage_get(&voltage);
+    battery_sample_request();                                   /* Sampled at the next radio events*/
+
+    if (voltage.unloaded_mv == 0)
+    {
+        return m_adv_data[ADV_BATTERY_OFFSET];
+    }
+
+    return battery_level_in_percent(voltage.unloaded_mv);
+}
+
+/**@brief Read waterpresence from gpiote pin.  
+*/
+void do_pir_measure(uint8_t *pir_presence) 
+{   
+    *pir_presence = nrf_gpio_pin_read(PIR_GPIOTE_PIN);
+
+}
+
+/**@brief Advertising functionality initialization.
 *
-* @param[in]   p_ble_evt   Bluetooth stack event.
+* @details Encodes the parts of the advertising packet that do not change while broadcasting
+*          (name, flags, company identifier and service UUID) once. The sensor fields are
+*          filled in by advertising_update().
 */
-static void ble_evt_dispatch(ble_evt_t * p_ble_evt)
+static void advertising_init(void)
 {
-    on_ble_evt(p_ble_evt);
+    memset(m_adv_data, 0, sizeof(m_adv_data));
+
+    m_adv_data[ADV_NAME_AD_OFFSET]          = 1 + ADV_DEVICE_NAME_LEN;                     /* Complete local name */
+    m_adv_data[ADV_NAME_AD_OFFSET + 1]      = BLE_GAP_AD_TYPE_COMPLETE_LOCAL_NAME;
+    memcpy(&m_adv_data[ADV_NAME_AD_OFFSET + 2], m_device_name, ADV_DEVICE_NAME_LEN);
+
+    m_adv_data[ADV_FLAGS_AD_OFFSET]         = 2;                                          /* Flags */
+    m_adv_data[ADV_FLAGS_AD_OFFSET + 1]     = BLE_GAP_AD_TYPE_FLAGS;
+    m_adv_data[ADV_FLAGS_AD_OFFSET + 2]     = BLE_GAP_ADV_FLAG_BR_EDR_NOT_SUPPORTED;
+
+    m_adv_data[ADV_MANUF_AD_OFFSET]         = 3 + ADV_MANUF_DATA_LEN + ADV_ALARM_LEN + ADV_EVENT_LEN + ADV_SEQ_LEN; /* Manufacturer specific data */
+    m_adv_data[ADV_MANUF_AD_OFFSET + 1]     = BLE_GAP_AD_TYPE_MANUFACTURER_SPECIFIC_DATA;
+    m_adv_data[ADV_MANUF_AD_OFFSET + 2]     = (uint8_t)(COMPANY_IDENTIFER & LOWER_BYTE_MASK);
+    m_adv_data[ADV_MANUF_AD_OFFSET + 3]     = (uint8_t)(COMPANY_IDENTIFER >> 8);
+
+    m_adv_data[ADV_SERVICE_AD_OFFSET]       = 4;                                          /* Battery service data */
+    m_adv_data[ADV_SERVICE_AD_OFFSET + 1]   = BLE_GAP_AD_TYPE_SERVICE_DATA;
+    m_adv_data[ADV_SERVICE_AD_OFFSET + 2]   = (uint8_t)(BLE_UUID_BATTERY_SERVICE & LOWER_BYTE_MASK);
+    m_adv_data[ADV_SERVICE_AD_OFFSET + 3]   = (uint8_t)(BLE_UUID_BATTERY_SERVICE >> 8);
+
+#if (ADV_ALARM_ENABLE == FEATURE_ENABLED)
+    m_adv_burst        = 0;                                                               /* Alarm byte starts cleared, an alarm already raised bursts on the first refresh */
+    m_adv_burst_events = 0;
+#endif
+
+#if (ADV_EVENT_ENABLE == FEATURE_ENABLED)
+    m_event_pending = false;                                                              /* Interrupts seen in connectable mode were handled there */
+#endif
+
+#if (ADV_HISTORY_ENABLE == FEATURE_ENABLED)
+    memset(m_sr_data, ADV_HISTORY_UNKNOWN, sizeof(m_sr_data));
+
+    m_sr_data[SR_MANUF_AD_OFFSET]           = SR_DATA_LEN - 1;                            /* Manufacturer specific data */
+    m_sr_data[SR_MANUF_AD_OFFSET + 1]       = BLE_GAP_AD_TYPE_MANUFACTURER_SPECIFIC_DATA;
+    m_sr_data[SR_MANUF_AD_OFFSET + 2]       = (uint8_t)(COMPANY_IDENTIFER & LOWER_BYTE_MASK);
+    m_sr_data[SR_MANUF_AD_OFFSET + 3]       = (uint8_t)(COMPANY_IDENTIFER >> 8);
+    m_sr_data[SR_SEQ_OFFSET]                = m_adv_data[ADV_SEQ_OFFSET];
+#if (ADV_TELEMETRY_ENABLE == FEATURE_ENABLED)
+    m_sr_data[SR_FIRMWARE_OFFSET]           = FIRMWARE_VERSION_MAJOR;
+    m_sr_data[SR_FIRMWARE_OFFSET + 1]       = FIRMWARE_VERSION_MINOR;
+#endif
+
+    m_history_prev_valid = false;
+#endif
 }
 
-/**@brief GAP initialization.
+
+#if (ADV_HISTORY_ENABLE == FEATURE_ENABLED)
+/**@brief Function for adding the previous sample to the short history in the scan response.
 *
-* @details This function shall be used to setup all the necessary GAP (Generic Access Profile)
-*          parameters of the device. It also sets the permissions and appearance.
+* @details The history holds, newest first, the change of each reading from the next newer
+*          sample (older minus newer), one signed byte per reading. A gateway that missed
+*          packets walks back from the readings in the advertising data to rebuild them, the
+*          sequence counter tells it how many samples it missed.
 */
-static void gap_params_init(void)
+static void adv_history_push(void)
 {
-    static const char hex_digits[] = "0123456789ABCDEF";
+    uint8_t  i;
+    uint8_t  offset     = 0;
+    int32_t  diff;
+    uint8_t  *p_new     = &m_adv_data[ADV_MANUF_DATA_OFFSET];
+    uint8_t  *p_history = &m_sr_data[SR_HISTORY_OFFSET];
 
-    uint32_t                err_code;
-    ble_gap_conn_sec_mode_t sec_mode;
-    char device_name[9];
-
-    device_name[0] = hex_digits[(NRF_FICR->DEVICEADDR[0] >> 28) & 0xf];
-    device_name[1] = hex_digits[(NRF_FICR->DEVICEADDR[0] >> 24) & 0xf];
-    device_name[2] = hex_digits[(NRF_FICR->DEVICEADDR[0] >> 20) & 0xf];
-    device_name[3] = hex_digits[(NRF_FICR->DEVICEADDR[0] >> 16) & 0xf];
-    device_name[4] = hex_digits[(NRF_FICR->DEVICEADDR[0] >> 12) & 0xf];
-    device_name[5] = hex_digits[(NRF_FICR->DEVICEADDR[0] >> 8) & 0xf];
-    device_name[6] = hex_digits[(NRF_FICR->DEVICEADDR[0] >> 4) & 0xf];
-    device_name[7] = hex_digits[NRF_FICR->DEVICEADDR[0] & 0xf];
-    device_name[8] = '\0';
+    memmove(&p_history[ADV_FIELD_COUNT], p_history, (ADV_HISTORY_LEN - 1) * ADV_FIELD_COUNT);
 
-    BLE_GAP_CONN_SEC_MODE_SET_OPEN(&sec_mode);
+    for (i = 0; i < ADV_FIELD_COUNT; i++)
+    {
+        if (m_adv_field_len[i] == 2)
+        {
+            diff = (int32_t)((m_history_prev_data[offset] << 8) | m_history_prev_data[offset + 1]) -
+                   (int32_t)((p_new[offset] << 8) | p_new[offset + 1]);
+        }
+        else
+        {
+            diff = (int32_t)m_history_prev_data[offset] - (int32_t)p_new[offset];
+        }
 
-    err_code = sd_ble_gap_device_name_set(&sec_mode, (uint8_t *) device_name, strlen(device_name));
-    APP_ERROR_CHECK(err_code);
+        if ((!m_history_prev_valid) || (diff < -127) || (diff > 127))
+        {
+            p_history[i] = ADV_HISTORY_UNKNOWN;
+        }
+        else
+        {
+            p_history[i] = (uint8_t)(int8_t)diff;
+        }
+        offset += m_adv_field_len[i];
+    }
+
+    memcpy(m_history_prev_data, p_new, ADV_MANUF_DATA_LEN);
+    m_history_prev_valid = true;
 
+    m_adv_data[ADV_SEQ_OFFSET]++;
+    m_sr_data[SR_SEQ_OFFSET] = m_adv_data[ADV_SEQ_OFFSET];
 }
+#endif
 
 
-/* This function measures the battery voltage using the bandgap as a reference.
-* 3.6 V will return 100 %, so depending on battery voltage */
-static uint32_t do_battery_measurement(void)
+#if (ADV_ALARM_ENABLE == FEATURE_ENABLED)
+/**@brief Function for updating the alarm byte of the advertising data.
+*
+* @details The alarms are evaluated from the readings just taken. A change of the alarm byte
+*          starts a burst at ADV_ALARM_BURST_INTERVAL, so scanners see it without waiting for the
+*          next advertisement at the adaptive interval.
+*/
+static void adv_alarm_update(void)
 {
-    uint8_t adc_result;
-    uint16_t    batt_lvl_in_milli_volts;
-    uint8_t     percentage_batt_lvl;
+    uint8_t alarm = broadcast_alarm_get(&m_adv_data[ADV_MANUF_DATA_OFFSET]);
 
-    NRF_ADC->CONFIG = ADC_CONFIG_RES_8bit << ADC_CONFIG_RES_Pos |
-    ADC_CONFIG_INPSEL_SupplyOneThirdPrescaling << ADC_CONFIG_INPSEL_Pos |
-    ADC_CONFIG_REFSEL_VBG << ADC_CONFIG_REFSEL_Pos;
-    NRF_ADC->ENABLE = 1;
+    if (alarm != m_adv_data[ADV_ALARM_OFFSET])
+    {
+        m_adv_data[ADV_ALARM_OFFSET] = alarm;
+        m_adv_burst                  = ADV_ALARM_BURST_COUNT;
+        m_adv_burst_events           = 0;
+    }
+}
+#endif
 
-    NRF_ADC->TASKS_START = 1;
-    while(!NRF_ADC->EVENTS_END);
-    adc_result = NRF_ADC->RESULT;
-    NRF_ADC->ENABLE = 0;
 
-    batt_lvl_in_milli_volts = ADC_RESULT_IN_MILLI_VOLTS(adc_result) + DIODE_FWD_VOLT_DROP_MILLIVOLTS;
+#if (ADV_HISTORY_ENABLE == FEATURE_ENABLED) && (ADV_TELEMETRY_ENABLE == FEATURE_ENABLED)
+/**@brief Function for updating the telemetry in the scan response.
+*
+* @details Active scanners get the state of the device with the scan response, without
+*          connecting. The firmware version is written once by advertising_init(). The battery
+*          voltages between and during radio events show the sag of the battery under the radio
+*          load, do_battery_measurement() requests a new pair at each refresh.
+*/
+static void adv_telemetry_update(void)
+{
+    battery_voltage_t voltage;
+
+    battery_voltage_get(&voltage);
+
+    m_sr_data[SR_BATTERY_UNLOADED_OFFSET] = (uint8_t)MIN(voltage.unloaded_mv / SR_BATTERY_MV_PER_UNIT, 0xFF);
+    m_sr_data[SR_BATTERY_LOADED_OFFSET]   = (uint8_t)MIN(voltage.loaded_mv / SR_BATTERY_MV_PER_UNIT, 0xFF);
+    m_sr_data[SR_LOG_FILL_OFFSET]   = data_log_fill_level();
+#if (ADV_ALARM_ENABLE == FEATURE_ENABLED)
+    m_sr_data[SR_ALARM_OFFSET]      = m_adv_data[ADV_ALARM_OFFSET];
+#else
+    m_sr_data[SR_ALARM_OFFSET]      = RESET_ALARM;
+#endif
+    m_sr_data[SR_UPTIME_OFFSET]     = (uint8_t)(m_uptime_seconds >> 24);
+    m_sr_data[SR_UPTIME_OFFSET + 1] = (uint8_t)(m_uptime_seconds >> 16);
+    m_sr_data[SR_UPTIME_OFFSET + 2] = (uint8_t)(m_uptime_seconds >> 8);
+    m_sr_data[SR_UPTIME_OFFSET + 3] = (uint8_t)m_uptime_seconds;
+}
+#endif
+
+
+#if (ADV_HISTORY_ENABLE == FEATURE_ENABLED) && (ADV_VERSION_ENABLE == FEATURE_ENABLED)
+/**@brief Function for checking whether the payload differs from the newest sample.
+*
+* @return     True if a reading, the alarm byte, the event fields or the battery level changed,
+*             or if no sample was taken since entering broadcast mode.
+*/
+static bool adv_data_changed(void)
+{
+    bool changed = (!m_history_prev_valid) ||
+                   (memcmp(m_version_prev_data, &m_adv_data[ADV_MANUF_DATA_OFFSET], sizeof(m_version_prev_data)) != 0) ||
+                   (m_version_prev_battery != m_adv_data[ADV_BATTERY_OFFSET]);
 
-    percentage_batt_lvl     = battery_level_in_percent(batt_lvl_in_milli_volts);
+    memcpy(m_version_prev_data, &m_adv_data[ADV_MANUF_DATA_OFFSET], sizeof(m_version_prev_data));
+    m_version_prev_battery = m_adv_data[ADV_BATTERY_OFFSET];
 
-    return percentage_batt_lvl;
+    return changed;
 }
+#endif
 
-/**@brief Read waterpresence from gpiote pin.  
+
+/**@brief Function for refreshing the advertising data.
+*
+* @details The sensors write their readings straight into the pre-encoded packet, which is then
+*          pushed to the stack without being rebuilt.
 */
-void do_pir_measure(uint8_t *pir_presence) 
-{   
-    *pir_presence = nrf_gpio_pin_read(PIR_GPIOTE_PIN);
+static void advertising_update(void)
+{
+    uint32_t err_code;
+    uint32_t xyz_coordinates;
+
+    if (MMA7660_read_xyz_reg_one_time(&xyz_coordinates))               /* read X Y Z data, the previous sample is kept on failure */
+    {
+        m_adv_data[ADV_XYZ_OFFSET]     = xyz_coordinates;
+        m_adv_data[ADV_XYZ_OFFSET + 1] = xyz_coordinates >> 8;
+        m_adv_data[ADV_XYZ_OFFSET + 2] = xyz_coordinates >> 16;
+    }
+
+    do_pir_measure(&m_adv_data[ADV_PIR_OFFSET]);                        /* PIR alarm is 1 when an active high is at the pin P0.02*/
+
+    m_adv_data[ADV_BATTERY_OFFSET] = do_battery_measurement();
 
+#if (ADV_ALARM_ENABLE == FEATURE_ENABLED)
+    adv_alarm_update();
+#endif
+
+#if (ADV_EVENT_ENABLE == FEATURE_ENABLED)
+    m_adv_data[ADV_EVENT_COUNT_OFFSET]    = m_event_count;
+    m_adv_data[ADV_EVENT_TIME_OFFSET]     = (uint8_t)(m_event_time >> 8);
+    m_adv_data[ADV_EVENT_TIME_OFFSET + 1] = (uint8_t)m_event_time;
+#endif
+
+#if (ADV_HISTORY_ENABLE == FEATURE_ENABLED)
+#if (ADV_VERSION_ENABLE == FEATURE_ENABLED)
+    if (adv_data_changed())                                             /* A repeated payload keeps its sequence counter */
+    {
+        adv_history_push();
+    }
+#else
+    adv_history_push();
+#endif
+#if (ADV_TELEMETRY_ENABLE == FEATURE_ENABLED)
+    adv_telemetry_update();
+#endif
+    err_code = sd_ble_gap_adv_data_set(m_adv_data, sizeof(m_adv_data), m_sr_data, sizeof(m_sr_data));
+#else
+    err_code = sd_ble_gap_adv_data_set(m_adv_data, sizeof(m_adv_data), NULL, 0);
+#endif
+    APP_ERROR_CHECK(err_code);
 }
 
-/**@brief Advertising functionality initialization.
-*
-* @details Encodes the required advertising data and passes it to the stack.
-*          Also builds a structure to be passed to the stack when starting advertising.
+
+#if (BROADCAST_BENCHMARK_ENABLE == FEATURE_ENABLED)
+/**@brief Function for encoding the current advertising data the way it was done before the
+*         packet was pre-encoded, i.e. building the advertising structures and calling ble_advdata_set().
 */
-static void advertising_init()
+static void advertising_rebuild(void)
 {
     uint32_t                   err_code;
     ble_advdata_t              advdata;
     ble_advdata_service_data_t service_data[1];
     uint8_t                    flags = BLE_GAP_ADV_FLAG_BR_EDR_NOT_SUPPORTED;
-    uint8_t				             curr_pir_presence;                              /* water pir value*/
-    uint32_t                   xyz_coordinates;
-    uint8_t                    battery;
     ble_advdata_manuf_data_t   manuf_specific_data;
-    uint8_t                    manuf_data_array[4];
+    uint8_t                    manuf_data_array[ADV_MANUF_DATA_LEN + ADV_ALARM_LEN + ADV_EVENT_LEN + ADV_SEQ_LEN];
+    uint8_t                    battery;
+#if (ADV_HISTORY_ENABLE == FEATURE_ENABLED)
+    ble_advdata_t              srdata;
+    ble_advdata_manuf_data_t   sr_manuf_specific_data;
+#endif
+
+    memcpy(manuf_data_array, &m_adv_data[ADV_MANUF_DATA_OFFSET], sizeof(manuf_data_array));
+    battery = m_adv_data[ADV_BATTERY_OFFSET];
+
+    manuf_specific_data.company_identifier = COMPANY_IDENTIFER;
+    manuf_specific_data.data.p_data        = manuf_data_array;
+    manuf_specific_data.data.size          = sizeof(manuf_data_array);
 
-    battery                      = do_battery_measurement();
     service_data[0].service_uuid = BLE_UUID_BATTERY_SERVICE;
     service_data[0].data.p_data  = &battery;
     service_data[0].data.size    = sizeof(battery);
 
-    MMA7660_read_xyz_reg_one_time(&xyz_coordinates);                                    /* read X Y Z data */
-
-    do_pir_measure(&curr_pir_presence);                                       /* read current pir sate */
-
-    manuf_data_array[0] = xyz_coordinates;       
-    manuf_data_array[1] = xyz_coordinates >> 8;  
-    manuf_data_array[2] = xyz_coordinates >> 16 ;
-    manuf_data_array[3] = curr_pir_presence;                               /* PIR alarm is 1 when an active high is at the pin P0.02*/
-
-    manuf_specific_data.company_identifier = COMPANY_IDENTIFER;                            /* COMPANY IDENTIFIER */
-    manuf_specific_data.data.p_data = manuf_data_array;
-    manuf_specific_data.data.size = sizeof(manuf_data_array);
-
-    // Build and set advertising data
     memset(&advdata, 0, sizeof(advdata));
 
     advdata.name_type               = BLE_ADVDATA_FULL_NAME;
@@ -251,42 +537,197 @@ static void advertising_init()
     advdata.service_data_count      = 1;
     advdata.p_manuf_specific_data   = &manuf_specific_data;
 
+#if (ADV_HISTORY_ENABLE == FEATURE_ENABLED)
+    sr_manuf_specific_data.company_identifier = COMPANY_IDENTIFER;
+    sr_manuf_specific_data.data.p_data        = &m_sr_data[SR_SEQ_OFFSET];         /* Sequence counter, telemetry and history */
+    sr_manuf_specific_data.data.size          = SR_DATA_LEN - SR_SEQ_OFFSET;
+
+    memset(&srdata, 0, sizeof(srdata));
+
+    srdata.name_type                = BLE_ADVDATA_NO_NAME;
+    srdata.p_manuf_specific_data    = &sr_manuf_specific_data;
+
+    err_code = ble_advdata_set(&advdata, &srdata);
+#else
     err_code = ble_advdata_set(&advdata, NULL);
+#endif
     APP_ERROR_CHECK(err_code);
 }
 
 
-void radio_notification_callback(bool is_radio_active)
+/**@brief Function for measuring the cost of one advertising data refresh.
+*
+* @details Both paths encode the same sensor values and push the same scan response as
+*          advertising_update(), so only the encoding and the SoftDevice call are measured, not
+*          the sensor conversions. The results are left in m_bench_patch_cycles and
+*          m_bench_rebuild_cycles for reading with the debugger.
+*/
+static void advertising_benchmark(void)
 {
-    m_do_update = is_radio_active;
+    uint32_t err_code;
+    uint8_t  sample[ADV_MANUF_DATA_LEN];
+    uint8_t  battery;
+
+    memcpy(sample, &m_adv_data[ADV_MANUF_DATA_OFFSET], ADV_MANUF_DATA_LEN);
+    battery = m_adv_data[ADV_BATTERY_OFFSET];
+
+    benchmark_start();
+    advertising_rebuild();
+    m_bench_rebuild_cycles = benchmark_stop();
+
+    benchmark_start();
+    memcpy(&m_adv_data[ADV_MANUF_DATA_OFFSET], sample, ADV_MANUF_DATA_LEN);
+    m_adv_data[ADV_BATTERY_OFFSET] = battery;
+#if (ADV_HISTORY_ENABLE == FEATURE_ENABLED)
+    err_code = sd_ble_gap_adv_data_set(m_adv_data, sizeof(m_adv_data), m_sr_data, sizeof(m_sr_data));
+#else
+    err_code = sd_ble_gap_adv_data_set(m_adv_data, sizeof(m_adv_data), NULL, 0);
+#endif
+    m_bench_patch_cycles = benchmark_stop();
+    APP_ERROR_CHECK(err_code);
 }
+#endif
 
 
-/**@brief Initialize Radio Notification event handler.
+/**@brief Function for getting the largest change of a sensor reading since the previous refresh.
+*
+* @details Readings are MSB first. One byte readings are scaled to 16 bit so that the policy
+*          threshold is the same fraction of the full scale for every reading.
+*
+* @return     Largest change, in 1/65536 of the full scale of the reading.
 */
-static void radio_notification_init(void)
+static uint16_t adv_data_delta(void)
 {
-    uint32_t err_code;
+    uint8_t  i;
+    uint8_t  offset = 0;
+    int32_t  diff;
+    uint16_t delta  = 0;
+    uint8_t  *p_new = &m_adv_data[ADV_MANUF_DATA_OFFSET];
 
-    err_code = ble_radio_notification_init(NRF_APP_PRIORITY_HIGH,
-    NRF_RADIO_NOTIFICATION_DISTANCE_1740US,
-    radio_notification_callback);
-    APP_ERROR_CHECK(err_code);
+    for (i = 0; i < sizeof(m_adv_field_len); i++)
+    {
+        if (m_adv_field_len[i] == 2)
+        {
+            diff = (int32_t)((p_new[offset] << 8) | p_new[offset + 1]) -
+                   (int32_t)((m_adv_prev_data[offset] << 8) | m_adv_prev_data[offset + 1]);
+        }
+        else
+        {
+            diff = ((int32_t)p_new[offset] - (int32_t)m_adv_prev_data[offset]) << 8;
+        }
+
+        if (diff < 0)
+        {
+            diff = -diff;
+        }
+        if (diff > delta)
+        {
+            delta = (uint16_t)diff;
+        }
+        offset += m_adv_field_len[i];
+    }
+
+    memcpy(m_adv_prev_data, p_new, ADV_MANUF_DATA_LEN);
+
+    return delta;
+}
+
+
+/**@brief Function for getting the broadcast interval of the current back-off step.
+*
+* @return     Interval in units of 0.625 ms, never above the slow interval of the policy.
+*/
+static uint16_t advertising_interval_get(void)
+{
+    uint32_t interval = (uint32_t)m_adv_policy.fast_interval << m_adv_backoff;
+
+    if (interval > m_adv_policy.slow_interval)
+    {
+        interval = m_adv_policy.slow_interval;
+    }
+    return (uint16_t)interval;
+}
+
+
+/**@brief Function for getting the interval to advertise at.
+*
+* @return     Burst interval while an alarm burst is running, otherwise the interval of the
+*             current back-off step.
+*/
+static uint16_t advertising_active_interval_get(void)
+{
+#if (ADV_ALARM_ENABLE == FEATURE_ENABLED)
+    if (m_adv_burst != 0)
+    {
+        return ADV_ALARM_BURST_INTERVAL;
+    }
+#endif
+    return advertising_interval_get();
+}
+
+
+/**@brief Function for deciding whether a radio event refreshes the sensors.
+*
+* @details An alarm burst only speeds up the advertising interval. The sensors keep the cadence
+*          of the back-off step, so a burst refreshes them on every
+*          advertising_interval_get() / ADV_ALARM_BURST_INTERVAL radio event only. The burst ends
+*          after ADV_ALARM_BURST_COUNT radio events, its last event refreshes so the interval of
+*          the back-off step is restored.
+*
+* @return     True if the sensors are refreshed on this radio event.
+*/
+static bool advertising_refresh_due(void)
+{
+#if (ADV_ALARM_ENABLE == FEATURE_ENABLED)
+    if (m_adv_burst == 0)
+    {
+        return true;
+    }
+
+    m_adv_burst--;
+    m_adv_burst_events++;
+    if ((m_adv_burst == 0) ||
+        (m_adv_burst_events >= (advertising_interval_get() / ADV_ALARM_BURST_INTERVAL)))
+    {
+        m_adv_burst_events = 0;
+        return true;
+    }
+    return false;
+#else
+    return true;
+#endif
 }
 
 
-/**@brief BLE stack initialization.
+/**@brief Function for handling the Radio Notification events.
 *
-* @details Initializes the SoftDevice and the BLE event interrupt.
+* @details Radio Notification is registered once by connectable_mode_init() for both modes and
+*          forwarded here, so the packet is refreshed just before the radio becomes active.
+*
+* @param[in]   is_radio_active   True if the radio is about to become active.
 */
-static void ble_stack_init(void)
-{   BLE_STACK_HANDLER_INIT(NRF_CLOCK_LFCLKSRC_RC_250_PPM_2000MS_CALIBRATION,
-    BLE_L2CAP_MTU_DEF,
-    ble_evt_dispatch,
-    false);
+void radio_notification_callback(bool is_radio_active)
+{
+    m_do_update = is_radio_active;
 }
 
 
+#if (ADV_EVENT_ENABLE == FEATURE_ENABLED)
+/**@brief Function for handling a PIR or movement interrupt.
+*
+* @details Called from the GPIOTE event handlers in both modes. In broadcast mode the main loop
+*          wakes up on the interrupt and refreshes the payload right away instead of waiting for
+*          the next Radio Notification.
+*/
+void broadcast_event_notify(void)
+{
+    m_event_count++;
+    m_event_time    = m_uptime_seconds;
+    m_event_pending = true;
+}
+#endif
+
+
 /**@brief Start advertising.
 */
 static void advertising_start(void)
@@ -297,17 +738,76 @@ static void advertising_start(void)
     // Initialise advertising parameters (used when starting advertising)
     memset(&adv_params, 0, sizeof(adv_params));
 
+#if (ADV_HISTORY_ENABLE == FEATURE_ENABLED)
+    adv_params.type        = BLE_GAP_ADV_TYPE_ADV_SCAN_IND;                  /* Scannable, the scan response carries the history */
+#else
     adv_params.type        = BLE_GAP_ADV_TYPE_ADV_NONCONN_IND;
+#endif
     adv_params.p_peer_addr = NULL;                           // Undirected advertisement
     adv_params.fp          = BLE_GAP_ADV_FP_ANY;
-    adv_params.interval    = APP_ADV_INTERVAL;
+    adv_params.interval    = advertising_active_interval_get();
     adv_params.timeout     = APP_ADV_TIMEOUT_IN_SECONDS;
 
+    m_adv_interval         = adv_params.interval;
+
     err_code = sd_ble_gap_adv_start(&adv_params);
     APP_ERROR_CHECK(err_code);
 
 }
 
+
+/**@brief Function for adapting the broadcast interval to the rate the readings change.
+*
+* @details A reading that moved beyond the policy threshold drops the interval back to the fast
+*          interval, otherwise the interval is doubled until it reaches the slow interval. An
+*          alarm burst overrides the interval until it has run out. Advertising is only
+*          restarted when the interval actually changes.
+*/
+static void advertising_interval_update(void)
+{
+    uint32_t err_code;
+    uint8_t  backoff = m_adv_backoff;
+
+    if (adv_data_delta() > m_adv_policy.threshold)
+    {
+        backoff = 0;
+    }
+    else if (advertising_interval_get() < m_adv_policy.slow_interval)
+    {
+        backoff++;
+    }
+
+    m_adv_backoff = backoff;
+
+    if (advertising_active_interval_get() != m_adv_interval)
+    {
+        err_code = sd_ble_gap_adv_stop();
+        APP_ERROR_CHECK(err_code);
+        advertising_start();
+    }
+}
+
+
+#if (ADV_EVENT_ENABLE == FEATURE_ENABLED)
+/**@brief Function for refreshing the advertising data after a PIR or movement interrupt.
+*
+* @details The payload is pushed to the stack at once and, with ADV_ALARM_ENABLE, a burst is
+*          started whether or not the alarm byte changed. Advertising is restarted at the burst
+*          interval, so the first packet with the event goes out a few milliseconds later.
+*/
+static void advertising_event_update(void)
+{
+    m_event_pending = false;
+
+    advertising_update();
+#if (ADV_ALARM_ENABLE == FEATURE_ENABLED)
+    m_adv_burst        = ADV_ALARM_BURST_COUNT;
+    m_adv_burst_events = 0;
+#endif
+    advertising_interval_update();
+}
+#endif
+
 /* Turn OFF TWI if TWI is not using , considering power optimization*/
 void twi_turn_OFF(void)
 {
@@ -327,6 +827,9 @@ void twi_turn_ON(void)
 *****************************************************************************/
 
 /**@brief Broadcast parameters .
+*
+* @details Broadcasting is non-connectable, so BROADCAST_MODE can not be cleared over GATT and
+*          the function does not return. The device leaves broadcast mode on reset.
 */
 void broadcast_mode(void)
 {  
@@ -334,24 +837,39 @@ void broadcast_mode(void)
 
     if(BROADCAST_MODE)											/*If broadcast mode is set True from connect.c start broadcasting*/
     {	
-        ble_stack_init();
-        twi_master_init(); 
-        MMA7660_config_standby_and_initialize();
-
-
-        radio_notification_init();
+        twi_turn_ON();                        /*TWI was left off by connectable mode*/
         gap_params_init();              			/*Initialize Bluetooth Stack parameters*/
-        advertising_init();   
+        advertising_init();
+        advertising_update();
+#if (BROADCAST_BENCHMARK_ENABLE == FEATURE_ENABLED)
+        advertising_benchmark();
+#endif
         advertising_start();	          			/*Start advertising*/
+#if (MODE_SWITCH_BENCHMARK_ENABLE == FEATURE_ENABLED)
+        m_bench_switch_ticks = benchmark_stop();
+#endif
         twi_turn_OFF();
 
         for (;;)
         {
-            if (m_do_update)                  
+#if (ADV_EVENT_ENABLE == FEATURE_ENABLED)
+            if (m_event_pending)                      /*PIR or movement interrupt, refresh without waiting for the radio*/
             {
                 twi_turn_ON();
-                advertising_init();       			/*Advertising is done only if radio is active */
+                advertising_event_update();
+                m_do_update = false;
+            }
+            else
+#endif
+            if (m_do_update)                  
+            {
                 m_do_update = false;
+                if (advertising_refresh_due())   /*A burst refreshes the sensors at the normal cadence only*/
+                {
+                    twi_turn_ON();
+                    advertising_update();     			/*Advertising is done only if radio is active */
+                    advertising_interval_update();
+                }
             }
             else
             {
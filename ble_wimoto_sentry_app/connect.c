@@ -51,6 +51,7 @@
 #include "nrf_gpio.h"
 #include "boards.h"
 #include "battery.h"
+#include "benchmark.h"
 
 #define SEND_MEAS_BUTTON_PIN_NO              16                                         /**< Button used for sending a measurement. */
 #define BONDMNGR_DELETE_BUTTON_PIN_NO        17                                         /**< Button used for deleting all bonded masters during startup. */
@@ -63,14 +64,17 @@
 
 #define APP_ADV_INTERVAL                     0x81A                                      /**< The advertising interval (in units of 0.625 ms. This value corresponds to 25 ms). */
 #define APP_ADV_TIMEOUT_IN_SECONDS           0x0000                                     /**< The advertising timeout in units of seconds. */
+#define LIVE_BEACON_ENABLE                   0x01                                       /**< 0x00 - Disabled 0x01 - Enabled, connectable advertising also carries the live sensor readings */
+#define BEACON_DATA_LEN                      4                                          /**< Length of the sensor readings carried in the advertising data. */
 
 #define APP_TIMER_PRESCALER                  0                                          /**< Value of the RTC1 PRESCALER register. */
-#define APP_TIMER_MAX_TIMERS                 5                                          /**< Maximum number of simultaneously created timers. */
+#define APP_TIMER_MAX_TIMERS                 7                                          /**< Maximum number of simultaneously created timers. */
 #define APP_TIMER_OP_QUEUE_SIZE              4                                          /**< Size of timer operation queues. */
 
 #define SENTRY_LEVEL_MEAS_INTERVAL           APP_TIMER_TICKS(60000, APP_TIMER_PRESCALER)/**< sentry level measurement interval (ticks). */
 #define CONNECTED_MODE_TIMEOUT_INTERVAL      APP_TIMER_TICKS(30000, APP_TIMER_PRESCALER)/**< Connected mode timeout interval (ticks). */
 #define SECONDS_INTERVAL                     APP_TIMER_TICKS(1000, APP_TIMER_PRESCALER) /**< seconds measurement interval (ticks). */
+#define MOVEMENT_STREAM_INTERVAL(rate)       ROUNDED_DIV(APP_TIMER_CLOCK_FREQ, (APP_TIMER_PRESCALER + 1) * (rate)) /**< Movement stream sample interval (ticks), from the samples per second of the MMA7660. */
 
 #define WATER_TYPE_AS_CHARACTERISTIC         0                                          /**< Determines if water type is given as characteristic (1) or as a field of measurement (0). */
 
@@ -106,16 +110,25 @@ uint8_t                                      movement_gpio_pin_val;
 static uint16_t                              m_conn_handle = BLE_CONN_HANDLE_INVALID;   /**< Handle of the current connection. */
 static ble_gap_sec_params_t                  m_sec_params;                              /**< Security requirements for this application. */
 static ble_gap_adv_params_t                  m_adv_params;                              /**< Parameters to be passed to the stack when starting advertising. */
+static ble_advdata_t                         m_advdata;                                 /**< Advertising data, kept so that it can be re-encoded with new readings. */
+static ble_advdata_t                         m_srdata;                                  /**< Scan response data. */
+#if (LIVE_BEACON_ENABLE == FEATURE_ENABLED)
+static ble_advdata_manuf_data_t              m_beacon_manuf_data;                       /**< Manufacturer data carrying the live sensor readings. */
+static uint8_t                               m_beacon_data[BEACON_DATA_LEN];            /**< Live sensor readings. */
+#endif
 static ble_dlogs_t                           m_dlogs;																	  /**< Structure used to identify the data logger service. */
 static ble_device_t                          m_device;                                  /**< Structure used to identify the Device management service. */
 static ble_pir_t                             m_pir;                                     /**< Structure used to identify the Passive Infrared alarm service. */
 static ble_movement_t                        m_movement;                                /**< Structure used to identify the Aceelerometer alarm service. */
 static app_timer_id_t                        sentry_measurement_timer;                  /**< Sentry profile measurement timer. */
 static app_timer_id_t                        real_time_timer;                           /**< Time keeping timer. */
+static app_timer_id_t                        movement_stream_timer;                     /**< Movement stream sample timer. */
+static bool                                  m_movement_stream_running = false;         /**< The MMA7660 is configured for the movement stream and the sample timer runs. */
 
 app_gpiote_user_id_t 								         pir_measurement_gpiote;                    /**< PIR presence measurement gpiote. */
 app_gpiote_user_id_t 	                       movement_measurement_gpiote;               /**< Movement presence measurement gpiote. */
 ble_date_time_t                              m_time_stamp;                              /**< Time stamp. */
+uint32_t                                     m_uptime_seconds = 0;                      /**< Seconds since power on, counted in both modes. */
 uint8_t 																		 battery_level=0;                           /**< Battery level variable */
 ble_bas_t                             			 bas;                                       /**< Structure used to identify the battery service. */
 
@@ -129,6 +142,8 @@ bool                                         MOVEMENT_EVENT_FLAG = false;
 bool                                         CHECK_ALARM_TIMEOUT=false;                 /**< Flag to indicate whether to check for alarm conditions*/
 bool                                         DATA_LOG_CHECK=false;
 bool                                         CLEAR_MOVE_ALARM=false;
+bool                                         MOVEMENT_STREAM_CONFIG=false;              /**< Movement stream notification or rate changed */
+bool                                         MOVEMENT_STREAM_SAMPLE=false;              /**< Flag to read the next sample of the movement stream */
 
 extern bool 	                               BROADCAST_MODE;                            /**< Flag used to switch between broadcast and connectable modes */    
 extern bool																	 DLOGS_CONNECTED_STATE;                     /**< Specifies data logger service is connected or not */
@@ -200,6 +215,36 @@ app_error_handler(DEAD_BEEF, line_num, p_file_name);
 //}
 
 
+/**@brief Function for getting the alarm state of the readings taken in broadcast mode.
+*
+* @details The readings are checked against the alarm set flags written over GATT in connectable
+*          mode, the same way the alarm services check them. The alarm services themselves are
+*          not run in broadcast mode, so their alarm values are left unchanged.
+*
+* @param[in]   p_readings   Manufacturer data of the broadcast packet: X, Y and Z registers and PIR
+*                           presence, 1 byte each.
+*
+* @return      Alarm byte, one BROADCAST_ALARM() per reading.
+*/
+uint8_t broadcast_alarm_get(const uint8_t * p_readings)
+{
+    uint8_t alarm = RESET_ALARM;
+
+    /* A movement alarm persists until it is cleared over GATT, the interrupt of the MMA7660 is
+       latched by movement_gpiote_evt_handler() in both modes and reported on the X reading. */
+    if ((m_movement.movement_alarm_set != 0x00) &&
+            ((m_movement.movement_alarm != 0x00) || (movement_gpio_pin_val == MOVEMENT)))
+    {
+        alarm |= BROADCAST_ALARM(0, SET_ALARM_FOR_MOVENMENT);
+    }
+    if ((m_pir.pir_alarm_set != 0x00) && (p_readings[3] == PIR_DETECTION))
+    {
+        alarm |= BROADCAST_ALARM(3, SET_ALARM_PIR_DETECTION);
+    }
+    return alarm;
+}
+
+
 /**@brief Function for performing a Sentry Profile parameters level measurement, and  check for the alarm condition.
 */
 static void sentry_param_meas_timeout_handler(void * p_context)
@@ -215,7 +260,16 @@ static void sentry_param_meas_timeout_handler(void * p_context)
         minutes_count =0x01;
         DATA_LOG_CHECK=true;
     }
-    battery_start();                              /* Updates the battery level*/
+    battery_start();                              /* Updates the battery level, samples it at the next radio events*/
+}
+
+
+/**@brief Function for sampling the movement stream.
+*/
+static void movement_stream_timeout_handler(void * p_context)
+{
+    UNUSED_PARAMETER(p_context);
+    MOVEMENT_STREAM_SAMPLE = true;
 }
 
 
@@ -236,6 +290,7 @@ static void real_time_timeout_handler(void * p_context)
         days_in_month[2] = 28;
     }
 
+    m_uptime_seconds++;
     m_time_stamp.seconds += 1;
     if (m_time_stamp.seconds > 59)
     {
@@ -301,6 +356,14 @@ static void timers_init(void)
     real_time_timeout_handler);
     APP_ERROR_CHECK(err_code);
 
+    // Create timer for the movement stream, started when a client enables the stream
+    err_code = app_timer_create(&movement_stream_timer,
+    APP_TIMER_MODE_REPEATED,
+    movement_stream_timeout_handler);
+    APP_ERROR_CHECK(err_code);
+
+    battery_init();                                  /* Timer of the battery sample under radio load*/
+
 } 
 
 /**@brief Function for starting application timers.
@@ -359,43 +422,53 @@ static void gap_params_init(void)
 static void advertising_init(void)
 {
     uint32_t      err_code;
-    ble_advdata_t advdata,advdata2;
-    uint8_t       flags = BLE_GAP_ADV_FLAGS_LE_ONLY_GENERAL_DISC_MODE;
+    static uint8_t flags = BLE_GAP_ADV_FLAGS_LE_ONLY_GENERAL_DISC_MODE;
 
     // Base UUID of Sentry Profile
     static uint8_t Vendor_Spec_Uuid[16] = {0x42, 0x09, 0xDC, 0x67, 0xE4, 0x33, 0x44, 0x20, 0x83, 0xD8, 0xCD, 0xAA, 0xCC, 0xD2, 0xE3, 0x12};
-    ble_advdata_manuf_data_t   manuf_data;
+    static ble_advdata_manuf_data_t manuf_data;
 
     // Setting up base UUID as manufacturing data
     manuf_data.company_identifier = COMPANY_IDENTIFER;                                  /* Company Identifier */
     manuf_data.data.size          = 16;
     manuf_data.data.p_data        = Vendor_Spec_Uuid;
 
-    ble_uuid_t adv_uuids[] = 
+    static ble_uuid_t adv_uuids[] = 
     {
         {SENTRY_PROFILE_MOVEMENT_SERVICE_UUID,	  				BLE_UUID_TYPE_BLE}, 
         {SENTRY_PROFILE_PIR_SERVICE_UUID,									BLE_UUID_TYPE_BLE},
     };
 
     // Build and set advertising data
-
-    memset(&advdata, 0, sizeof(advdata));
-
-    advdata.name_type               = BLE_ADVDATA_FULL_NAME;
-    advdata.include_appearance      = true;
-    advdata.flags.size              = sizeof(flags);
-    advdata.flags.p_data            = &flags;
-    advdata.uuids_complete.uuid_cnt = sizeof(adv_uuids) / sizeof(adv_uuids[0]);
-    advdata.uuids_complete.p_uuids  = adv_uuids;
-
-    memset(&advdata2, 0, sizeof(advdata2));
-
-    advdata2.name_type               = BLE_ADVDATA_NO_NAME;
-    advdata2.include_appearance      = false;
-    advdata2.flags.size              = 0;
-    advdata2.p_manuf_specific_data   = &manuf_data; 
-
-    err_code = ble_advdata_set(&advdata, &advdata2);
+    memset(&m_advdata, 0, sizeof(m_advdata));
+
+    m_advdata.name_type               = BLE_ADVDATA_FULL_NAME;
+    m_advdata.flags.size              = sizeof(flags);
+    m_advdata.flags.p_data            = &flags;
+
+    memset(&m_srdata, 0, sizeof(m_srdata));
+
+    m_srdata.name_type                = BLE_ADVDATA_NO_NAME;
+    m_srdata.include_appearance       = false;
+    m_srdata.flags.size               = 0;
+    m_srdata.p_manuf_specific_data    = &manuf_data;
+
+#if (LIVE_BEACON_ENABLE == FEATURE_ENABLED)
+    // The sensor readings take the place of the appearance and the service UUIDs, which move to the scan response
+    m_beacon_manuf_data.company_identifier = COMPANY_IDENTIFER;
+    m_beacon_manuf_data.data.size          = sizeof(m_beacon_data);
+    m_beacon_manuf_data.data.p_data        = m_beacon_data;
+
+    m_advdata.p_manuf_specific_data   = &m_beacon_manuf_data;
+    m_srdata.uuids_complete.uuid_cnt  = sizeof(adv_uuids) / sizeof(adv_uuids[0]);
+    m_srdata.uuids_complete.p_uuids   = adv_uuids;
+#else
+    m_advdata.include_appearance      = true;
+    m_advdata.uuids_complete.uuid_cnt = sizeof(adv_uuids) / sizeof(adv_uuids[0]);
+    m_advdata.uuids_complete.p_uuids  = adv_uuids;
+#endif
+
+    err_code = ble_advdata_set(&m_advdata, &m_srdata);
     APP_ERROR_CHECK(err_code);
 
     // Initialize advertising parameters (used when starting advertising)
@@ -409,6 +482,25 @@ static void advertising_init(void)
 }
 
 
+#if (LIVE_BEACON_ENABLE == FEATURE_ENABLED)
+/**@brief Function for refreshing the sensor readings carried in the advertising data.
+*/
+static void beacon_update(void)
+{
+    uint32_t err_code;
+
+    // Same layout as the manufacturer data in broadcast mode, X Y Z as read on the last movement event
+    m_beacon_data[0] = current_xyz_array[0];
+    m_beacon_data[1] = current_xyz_array[1];
+    m_beacon_data[2] = current_xyz_array[2];
+    m_beacon_data[3] = nrf_gpio_pin_read(PIR_GPIOTE_PIN);
+
+    err_code = ble_advdata_set(&m_advdata, &m_srdata);
+    APP_ERROR_CHECK(err_code);
+}
+#endif
+
+
 /**@brief Function for initializing services that will be used by the application.
 *
 * @details Initialize the movement/PIR alarm ,and Device Information services.
@@ -507,6 +599,7 @@ static void movement_init(void)
     movement_init.movement_alarm_set	 = DEFAULT_ALARM_SET; 
     movement_init.movement_alarm_clear = RESET_ALARM;
     movement_init.movement_alarm       = RESET_ALARM;
+    movement_init.movement_stream_rate = MOVEMENT_STREAM_DEFAULT_RATE;
 
     err_code = ble_movement_init(&m_movement, &movement_init);
     APP_ERROR_CHECK(err_code);
@@ -810,6 +903,7 @@ static void button_event_handler(uint8_t pin_no)
 static void pir_gpiote_evt_handler(uint32_t pins_low_to_high_mask, uint32_t pins_high_to_low_mask)
 { 
     PIR_EVENT_FLAG=true;																					/*the flag is set when an event occurs on gpiote*/
+    broadcast_event_notify();
 }
 
 /**@brief event handler for  the Movement GPIOTE module.
@@ -818,6 +912,7 @@ static void movement_gpiote_evt_handler(uint32_t pins_low_to_high_mask, uint32_t
 {
     movement_gpio_pin_val = nrf_gpio_pin_read(MOVEMENT_GPIOTE_PIN);	
     MOVEMENT_EVENT_FLAG=true;																			/*the flag is set when an event occurs on gpiote*/
+    broadcast_event_notify();
 }
 
 
@@ -949,6 +1044,8 @@ void radio_active_evt_handler(bool radio_active)
 {
     m_radio_event = radio_active;
     ble_flash_on_radio_active_evt(m_radio_event);   /* Call the event handler*/
+    radio_notification_callback(radio_active);      /* Schedule a refresh of the broadcast packet*/
+    battery_on_radio_evt(radio_active);             /* Start the pending battery samples*/
 }
 
 /**@brief Function for initializing the Radio Notification events.
@@ -1000,12 +1097,14 @@ static void data_log_check()
         write_data_flash(log_data);	                      /*log the data to flash */
     }
 }
-/**@brief Function for application main entry.
+/**@brief Function for initializing the stack, timers, sensors and services.
+*
+* @details Called once at start-up. Both modes share the SoftDevice, the BLE event dispatch,
+*          Radio Notification, the application timers and the sensor configuration, so
+*          switching modes only swaps the advertising data and parameters.
 */
-void connectable_mode(void)
+void connectable_mode_init(void)
 {
-    uint32_t err_code;
-
     // Initialization.
     ble_stack_init();
     twi_master_init(); 
@@ -1017,24 +1116,123 @@ void connectable_mode(void)
     buttons_init();
     bond_manager_init();
     gap_params_init();
-    advertising_init();
     services_init();
     conn_params_init();
     sec_params_init();
     radio_notification_init();
     MMA7660_enable_active_mode();
     twi_turn_OFF();
+}
+
+
+/**@brief Function for starting or stopping the movement stream.
+*
+* @details While streaming, the MMA7660 samples continuously at the stream rate without Auto-sleep
+*          and the stream timer reads each sample. Stopping restores the Auto-wake and Auto-sleep
+*          configuration used by the movement alarm.
+*
+* @param[in]   enable     true to (re)start the stream at the current stream rate.
+*/
+static void movement_stream_config(bool enable)
+{
+    uint32_t err_code;
+
+    if (!enable && !m_movement_stream_running)
+    {
+        return;
+    }
+
+    err_code = app_timer_stop(movement_stream_timer);
+    APP_ERROR_CHECK(err_code);
+    MOVEMENT_STREAM_SAMPLE = false;
+
+    twi_turn_ON();
+    if (enable)
+    {
+        (void)MMA7660_config_stream(m_movement.movement_stream_rate);
+        ble_movement_stream_reset();
+
+        err_code = app_timer_start(movement_stream_timer, MOVEMENT_STREAM_INTERVAL(MMA7660_sample_rate(m_movement.movement_stream_rate)), NULL);
+        APP_ERROR_CHECK(err_code);
+    }
+    else
+    {
+        (void)MMA7660_config_standby_and_initialize();
+    }
+    twi_turn_OFF();
+
+    m_movement_stream_running = enable;
+}
+
+
+/**@brief Function for reading one sample of the movement stream.
+*/
+static void movement_stream_sample(void)
+{
+    uint32_t err_code;
+    uint32_t xyz;
+    bool     xyz_valid;
+
+    twi_turn_ON();
+    xyz_valid = MMA7660_read_xyz_reg_one_time(&xyz);
+    twi_turn_OFF();
+
+    if (!xyz_valid)
+    {
+        return;                                           /* The sample is skipped, the next one follows one period later*/
+    }
+
+    err_code = ble_movement_stream_add(&m_movement, xyz);
+    if ((err_code != NRF_SUCCESS) &&
+            (err_code != NRF_ERROR_INVALID_STATE) &&
+            (err_code != BLE_ERROR_NO_TX_BUFFERS) &&
+            (err_code != BLE_ERROR_GATTS_SYS_ATTR_MISSING)
+            )
+    {
+        APP_ERROR_HANDLER(err_code);
+    }
+}
+
+
+/**@brief Function for application main entry.
+*
+* @details Expects connectable_mode_init() to have been called. Returns once BROADCAST_MODE is
+*          set and no client is connected, with advertising and the measurement timer stopped.
+*/
+void connectable_mode(void)
+{
+    uint32_t err_code;
+
+    gap_params_init();                    /* Restore the name and advertising data replaced in broadcast mode*/
+    advertising_init();
     application_timers_start();   
+#if (LIVE_BEACON_ENABLE == FEATURE_ENABLED)
+    beacon_update();
+#endif
     advertising_start();
+    MOVEMENT_STREAM_CONFIG = true;        /* Resume the movement stream if it is enabled*/
 
     // Enter main loop.
     for (;;)
     {
 
+        // Start, restart or stop the movement stream before a disconnect can switch to broadcast mode
+        if (MOVEMENT_STREAM_CONFIG)
+        {
+            MOVEMENT_STREAM_CONFIG = false;
+            movement_stream_config(m_movement.is_stream_enabled);
+        }
+
         // If the broadcast mode flag is true and services are not connected stop advertising and exit
         if((BROADCAST_MODE) && (!PIR_CONNECTED_STATE) && (!ACCELEROMETER_CONNECTED_STATE)) 
         {
+#if (MODE_SWITCH_BENCHMARK_ENABLE == FEATURE_ENABLED)
+            benchmark_start_prescaled(BENCHMARK_PRESCALER_32US);
+#endif
             sd_ble_gap_adv_stop();							  /* Stop advertising */
+            err_code = app_timer_stop(sentry_measurement_timer);   /* Only the broadcast refresh samples the sensors*/
+            APP_ERROR_CHECK(err_code);
+            movement_stream_config(false);                          /* Only streams into the simulated link can still run*/
             break;
         }
 
@@ -1062,6 +1260,9 @@ void connectable_mode(void)
             }  
 
             PIR_EVENT_FLAG=false;				         /* Reset the gpiote event flag*/
+#if (LIVE_BEACON_ENABLE == FEATURE_ENABLED)
+            beacon_update();                                  /* Refresh the readings in the advertising data*/
+#endif
 
         }
 
@@ -1080,6 +1281,16 @@ void connectable_mode(void)
             }  
 
             MOVEMENT_EVENT_FLAG=false;					 /* Reset the gpiote event flag*/
+#if (LIVE_BEACON_ENABLE == FEATURE_ENABLED)
+            beacon_update();                                  /* Refresh the readings in the advertising data*/
+#endif
+        }
+
+        // Read the next sample of the movement stream
+        if (MOVEMENT_STREAM_SAMPLE)
+        {
+            MOVEMENT_STREAM_SAMPLE = false;
+            movement_stream_sample();
         }
         if (DATA_LOG_CHECK)
         {
@@ -8,6 +8,13 @@
 
 #include "wimoto_sensors.h"
 
+/********************************************************************************************/
+/* PRIVATE VARIABLES																		*/
+/********************************************************************************************/
+static const uint8_t m_mma7660_amsr_rate[MMA7660_AMSR_1SAMPLES + 1] = {120, 64, 32, 16, 8, 4, 2, 1};  /**< Samples per second of each AMSR setting */
+
+
+
 /********************************************************************************************/
 /* PRIVATE FUNCTIONS																		*/
 /********************************************************************************************/
@@ -147,55 +154,38 @@ bool MMA7660_config_standby_and_initialize()
 
 /**
 *@brief   Function to read the orientation data from the registers of MMA7660FC
-*@details 1.Function initially enables active mode so the MMA7660FC calculates orientation and makes data
-*            available in X-out,Y-out and Z-out registers 
-*         2.Puts back MMA7660FC into standby mode for power conservation
-*         3.Function returns a contents of X-out,Y-out and Z-out registers as a 32 bit value
+*@details 1.X-out,Y-out and Z-out are read in one transfer, the register address auto-increments
+*         2.If the alert bit is set in any of them, the sample was read while it was updated and
+*            the transfer is repeated, as is a transfer that failed on the bus. After
+*            MMA7660_XYZ_READ_ATTEMPTS transfers the function gives up
+*         3.Function returns a true value with the contents of X-out,Y-out and Z-out registers as a 32 bit value
 *               (24-16) bits  X-out register
 *               (16-8) bits Y-out register
 *               (8-0) bits Z-out register
+*           otherwise a false value, and the value is not changed
 */
 bool MMA7660_read_xyz_reg_one_time(uint32_t * ptr_to_Reg_val)
 {
-    uint8_t X_buff = 0,Y_buff = 0,Z_buff = 0;
-    bool state1 = true ,state2 = true ,state3 = true;
-
-    while(state1)                                        /*after enabling active mode read x,y,z registers */
-    {
-        X_buff = MMA7660_read_register (MMA7660_XOUT_REG);
-
-        if(X_buff & MMA7660_ALERT_BIT_SET_CHECK) 
-        state1 = true;                            /* If alert bit set re=read the register */
-        else 
-        state1 = false;
+    uint8_t base_address = MMA7660_XOUT_REG;
+    uint8_t xyz_buff[MMA7660_XYZ_BURST_LEN];
+    uint8_t attempt;
 
-    }
-
-    while(state2)
+    for (attempt = 0; attempt < MMA7660_XYZ_READ_ATTEMPTS; attempt++)
     {
-        Y_buff = MMA7660_read_register(MMA7660_YOUT_REG);
-
-        if(Y_buff & MMA7660_ALERT_BIT_SET_CHECK) 
-        state2 = true;                           /* If alert bit set re=read the register */
-        else 
-        state2 = false;
-
-    }
-
-    while(state3)
-    {
-        Z_buff = MMA7660_read_register (MMA7660_ZOUT_REG);
-
-        if(Z_buff & MMA7660_ALERT_BIT_SET_CHECK) 
-        state3 = true;                           /* If alert bit set re=read the register */       
-        else  
-        state3 = false;
-
-    }
+        if (!twi_master_transfer (MMA7660FC_ADDRESS ,&base_address ,1 ,TWI_DONT_ISSUE_STOP) ||
+            !twi_master_transfer (MMA7660FC_ADDRESS | TWI_READ_BIT ,xyz_buff ,sizeof(xyz_buff) ,TWI_ISSUE_STOP))
+        {
+            continue;                                           /* Bus error, try again */
+        }
 
-    * ptr_to_Reg_val= ((X_buff << 16) | ( Y_buff <<8) | Z_buff);    /* 32 bit result is returned */
+        if (((xyz_buff[0] | xyz_buff[1] | xyz_buff[2]) & MMA7660_ALERT_BIT_SET_CHECK) == 0)
+        {
+            * ptr_to_Reg_val = ((xyz_buff[0] << 16) | (xyz_buff[1] << 8) | xyz_buff[2]);    /* 32 bit result is returned */
+            return true;
+        }
+    }                                                           /* If alert bit set re-read the registers */
 
-    return true;
+    return false;
 
 }
 
@@ -209,5 +199,32 @@ void MMA7660_ClearInterrupts(void)
     MMA7660_read_register(MMA7660_TILT_REG);
 }
 
+/**
+*@brief   Function to configure MMA7660FC for streaming
+*@details 1.Function enables standby mode for writing, which also clears the Auto-wake and Auto-sleep
+*            bits, so the sample rate does not change while streaming
+*         2.Configure the AMSR sample rate given as the argument, the shake and orientation
+*            interrupts stay enabled for the movement alarm
+*         3.Enable the Active mode. MMA7660_config_standby_and_initialize() restores the
+*            Auto-wake & Auto-sleep configuration
+*         4.Function returns a true value on the success of the function
+*/
+bool MMA7660_config_stream(uint8_t amsr)
+{
+    // Enable standby mode for writing, Mode Register is cleared
+    if (false == MMA7660_enable_standby_mode()) return false;
+    // Configure the stream sample rate
+    if (false == MMA7660_write_to_reg (MMA7660_SR_REG,((amsr & MMA7660_AMSR_1SAMPLES) | MMA7660_AWSR_1SAMPLES))) return false;
+    // Enable Active mode
+    if (false == MMA7660_write_to_reg (MMA7660_MODE_REG,MMA7660_ENABLE_ACTIVE_MODE)) return false;
 
+    return true;
+}
 
+/**
+*@brief   Function to get the samples per second of an AMSR setting
+*/
+uint8_t MMA7660_sample_rate(uint8_t amsr)
+{
+    return m_mma7660_amsr_rate[amsr & MMA7660_AMSR_1SAMPLES];
+}
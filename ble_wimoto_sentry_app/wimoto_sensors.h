@@ -84,8 +84,20 @@ bool      write_to_register            (uint8_t,uint8_t,uint8_t);  /**< Write da
 #define TMP006_MANUFACT_ID_REG         0xFE     /**< Base address of Manufacturer ID register */
 #define TMP006_DEVICE_ID_REG           0xFF     /**< Base address of Device ID register */
 
-#define TMP006_ENABLE_POWER_DOWN       0x04     /**< Enable power down mode in TMP006 (no conversion) */
-#define TMP006_ENABLE_CONVERSION       0x74     /**< Enable continious conversion mode in TMP006  */
+#define TMP006_CR_AVG_1                0x00     /**< 4 conversions per second, no averaging (0.25 s) */
+#define TMP006_CR_AVG_2                0x01     /**< 2 conversions per second, 2 samples averaged (0.5 s) */
+#define TMP006_CR_AVG_4                0x02     /**< 1 conversion per second, 4 samples averaged (1 s) */
+#define TMP006_CR_AVG_8                0x03     /**< 0.5 conversions per second, 8 samples averaged (2 s) */
+#define TMP006_CR_AVG_16               0x04     /**< 0.25 conversions per second, 16 samples averaged (4 s) */
+#define TMP006_AVERAGING               TMP006_CR_AVG_4  /**< Conversion rate and on-chip averaging (CR2-0), one of TMP006_CR_AVG_* */
+#define TMP006_CONFIG_EN_DRDY          0x01     /**< Enable the DRDY pin (EN bit, bit 0 of the configuration MSB) */
+#define TMP006_CONVERSION_TIME_MS      (250 << TMP006_AVERAGING)           /**< Time of one averaged conversion */
+#define TMP006_CONVERSION_MARGIN_MS    100      /**< Margin added to the conversion time when waiting without DRDY */
+#define TMP006_DRDY_TIMEOUT_MS         (2 * TMP006_CONVERSION_TIME_MS)     /**< Time after which a measurement waiting for DRDY is given up */
+#define TMP006_APP_TIMER_PRESCALER     0        /**< Value of the RTC1 PRESCALER register used by the application */
+
+#define TMP006_ENABLE_POWER_DOWN       (TMP006_AVERAGING << 1)             /**< Enable power down mode in TMP006 (no conversion) */
+#define TMP006_ENABLE_CONVERSION       (0x70 | (TMP006_AVERAGING << 1) | TMP006_CONFIG_EN_DRDY)  /**< Enable continious conversion mode in TMP006, DRDY pin asserted on each result */
 #define TMP006_CONFIG_REG_LSB          0x00     /**< Default value of Least Significant Byte(LSB) in Configuration register */
 
 // Constants for calculating object temperature
@@ -98,14 +110,40 @@ bool      write_to_register            (uint8_t,uint8_t,uint8_t);  /**< Write da
 #define TMP006_A1                       0.00175
 #define TMP006_S0                       6.4       /**< 10^-14  */
 
+// Fixed-point constants for calculating object temperature, derived from the constants above. The die
+// temperature difference tq = Tdie - TREF is in raw units of 1/32 C, the voltages in V-object LSB (156.25 nV)
+#define TMP006_A1_Q32                  234881                   /**< A1 / 32 in Q32 */
+#define TMP006_A2_Q44                  -288278                  /**< A2 / 32^2 in Q44 */
+#define TMP006_B0_Q16                  -12331254                /**< B0 / 156.25 nV in Q16 */
+#define TMP006_B1_Q16                  -7471                    /**< B1 / 156.25 nV / 32 in Q16 */
+#define TMP006_B2_Q32                  124286                   /**< B2 / 156.25 nV / 32^2 in Q32 */
+#define TMP006_C2_Q40                  2302102                  /**< C2 * 156.25 nV in Q40 */
+#define TMP006_S_DIVIDEND              819200000000000000ULL    /**< 156.25 nV / (S0 * 10^-14) * 160^4 / 2^8 * 2^17, see TMP006_ObjTempCentiC_calculate() */
+#define TMP006_TREF_RAW                800                      /**< TREF - 273.15 (25 C) in raw units of 1/32 C */
+#define TMP006_ZERO_C_160              43704                    /**< 273.15 K in 1/160 K */
+#define TMP006_ZERO_C_2560             699264                   /**< 273.15 K in 1/2560 K */
+#define TMP006_DIE_RAW_MIN             -1280                    /**< -40 C, lowest specified die temperature in raw units */
+#define TMP006_DIE_RAW_MAX             4000                     /**< 125 C, highest specified die temperature in raw units */
+#define TMP006_FIXED_POINT_BENCHMARK_ENABLE  0x00               /**< 0x00 - Disabled 0x01 - Enabled, compares the cycles of the fixed-point and float calculation (uses TIMER1, see benchmark.h) */
+
 /**< Functions      */
 /*Public Functions  */
 bool      TMP006_enable_powerdown_mode(void);     /**< Enable power down mode */
 uint32_t  TMP006_get_onetime_data(void);          /**< Enable continuous conversion mode then read contents of V-object & T-ambient  
                                                        registers one time and reconfigure TMP006 in power down mode */																									 
 float     TMP006_readDieTempC(void);              /**< Calculate sensor temperature based on raw reading */
-float     TMP006_ObjTempC_conversion(void);       /**< Calculate object temperature based on raw sensor temp and thermopile voltage */
-void      do_thermopile_measurement(uint8_t*, float*);
+int16_t   TMP006_ObjTempCentiC_conversion(void);  /**< Calculate object temperature in 0.01 C based on raw sensor temp and thermopile voltage */
+void      float_to_str(double, char*);                                        /**< Convert float to string, NUL terminated, up to 10 characters */
+void      TMP006_ObjTemp_encode(int16_t obj_temp, uint8_t * p_encoded);       /**< Encode object temperature in 0.01 C to THERMOP_CHAR_SIZE bytes */
+int16_t   TMP006_ObjTemp_decode(const uint8_t * p_encoded);                   /**< Decode THERMOP_CHAR_SIZE bytes to object temperature in 0.01 C */
+
+typedef void (*tmp006_measure_handler_t)(int16_t obj_temp);                   /**< Handler of a completed asynchronous measurement, object temperature in 0.01 C */
+
+uint32_t  TMP006_MeasureAsyncInit(void);                                      /**< Configure DRDY interrupt and timeout for asynchronous measurements */
+uint32_t  TMP006_MeasureAsync(tmp006_measure_handler_t handler);              /**< Start an object temperature measurement completed on DRDY */
+int16_t   TMP006_ObjTempCentiC_last(void);                                    /**< Object temperature in 0.01 C of the last successful measurement */
+int16_t   TMP006_ObjTempCentiC_calculate(int16_t raw_die, int16_t raw_vobj);  /**< Calculate object temperature in 0.01 C with fixed-point arithmetic */
+void      TMP006_ObjTempBenchmark(void);                                      /**< Measure the cycles of the calculation, if TMP006_FIXED_POINT_BENCHMARK_ENABLE is set */
 
 /*Private Functions */
 bool      TMP006_enable_continuous_conversion(void);                          /**< Enable continuous conversion mode */
@@ -129,6 +167,7 @@ uint16_t  TMP006_read_register(uint8_t base_address);       /**< Read the data f
 *@Featurs Provides functions for
 *             1.Configure the Full Scale Range value of LUX in ISL29023and enable power down mode                
 *             2.One time Ambient Light Sensing mode for power saving 
+*             3.Auto-ranging of the FSR and ADC resolution, readings are returned in lux
 */
 
 /**< Macros       */
@@ -149,11 +188,38 @@ uint16_t  TMP006_read_register(uint8_t base_address);       /**< Read the data f
 #define ISL29023_USE_16K_LUX_FSR                0x02  /**< Configure FSR of LUX as 16000 */
 #define ISL29023_USE_4K_LUX_FSR                 0x01  /**< Configure FSR of LUX as 4000 */
 #define ISL29023_USE_1K_LUX_FSR                 0x00  /**< Configure FSR of LUX as 1000 */
+#define ISL29023_ALS_CONVERSION_TIME_MS         90    /**< Integration time of a 16 bit conversion in ms */
+#define ISL29023_ALS_12_BIT_CONVERSION_TIME_MS  6     /**< Integration time of a 12 bit conversion in ms (5.6 ms) */
+#define ISL29023_RES_16_BIT                     0x00  /**< Configure ADC resolution as 16 bit */
+#define ISL29023_RES_12_BIT                     0x04  /**< Configure ADC resolution as 12 bit */
+#define ISL29023_RANGE_COUNT                    4     /**< Number of ranges used by auto-ranging, see isl29023.c */
+#define ISL29023_RANGE_UP_PERCENT               90    /**< Next range when a reading is above this percentage of the FSR */
+#define ISL29023_RANGE_DOWN_PERCENT             70    /**< Previous range when a reading is below this percentage of its FSR */
+#define ISL29023_LUX_FRACTION_BITS              16    /**< Readings are lux in unsigned 16.16 fixed point */
+#define ISL29023_LUX_INTEGER(lux)               ((uint16_t)(((lux) + (1UL << (ISL29023_LUX_FRACTION_BITS - 1))) >> ISL29023_LUX_FRACTION_BITS)) /**< Round a reading to whole lux, at most 64000 */
+#define ISL29023_ENABLE_ALS_CONTINUOUS          0xA0  /**< Enable Ambient Light Sensing continuous mode */
+#define ISL29023_INT_FLAG                       0x04  /**< Interrupt flag of Command Register 1, cleared by reading Command Register 1 */
+#define ISL29023_PERSIST_1                      0x00  /**< INT after 1 conversion out of the threshold window */
+#define ISL29023_PERSIST_4                      0x01  /**< INT after 4 conversions out of the threshold window */
+#define ISL29023_PERSIST_8                      0x02  /**< INT after 8 conversions out of the threshold window */
+#define ISL29023_PERSIST_16                     0x03  /**< INT after 16 conversions out of the threshold window */
+#define ISL29023_INT_PERSISTENCE                ISL29023_PERSIST_4  /**< 16 bit range, 4 x 90 ms out of the window before INT, a passing shadow does not raise an alarm */
+#define ISL29023_INT_12_BIT_PERSISTENCE         ISL29023_PERSIST_16 /**< 12 bit ranges, 16 x 5.6 ms = 90 ms out of the window before INT, the longest ISL29023 allows */
  
 /**< Functions   */
 /*Public Functions*/
 bool          ISL29023_config_FSR_and_powerdown(void); /**< Configure the FSR reading of ISL29023 and enable power down mode*/
-uint16_t      ISL29023_get_one_time_ALS(void);         /**< Get the content of data registers using ALS once mode*/
+uint32_t      ISL29023_get_one_time_ALS(void);         /**< Get the light level in lux using ALS once mode*/
+bool          ISL29023_start_one_time_ALS(void);       /**< Start ALS once mode without waiting for the conversion*/
+uint32_t      ISL29023_read_ALS(void);                 /**< Get the light level in lux after an ALS once conversion*/
+uint8_t       ISL29023_conversion_time_ms(void);       /**< Integration time of the range of the next conversion*/
+
+typedef void (*isl29023_int_handler_t)(void);          /**< Handler of an INT assertion */
+
+uint32_t      ISL29023_init_interrupt(isl29023_int_handler_t); /**< Register INT with the GPIOTE handler*/
+bool          ISL29023_config_interrupt(uint16_t,uint16_t);    /**< ALS continuous mode, INT when the light level leaves a threshold window in lux*/
+bool          ISL29023_disable_interrupt(void);                /**< Back to power down mode and ALS once conversions*/
+uint32_t      ISL29023_get_ALS(void);                          /**< Get the light level in lux, of the last conversion while INT is armed*/
 
 /*Private Functions */
 uint8_t       ISL29023_read_register(uint8_t);         /**< Read data of register of ISL29023 */
@@ -169,6 +235,8 @@ bool          ISL29023_write_to_reg(uint8_t,uint8_t);  /**< Write data to the re
  *                and then configure MMA7660FC for shut-down mode
  *             2.Reading data for X ,Y and Z registers one time and configure shut-down mode in MMA7660FC  for
  *                power saving            
+ *             3.X ,Y and Z are read in one auto-increment transfer, re-read a bounded number of times
+ *                while the alert bit is set
 */
 
 /**< Macros       */
@@ -190,19 +258,31 @@ bool          ISL29023_write_to_reg(uint8_t,uint8_t);  /**< Write data to the re
 #define MMA7660_ENABLE_STANDBY_MODE             0x00   /**< Enable standby mode in MMA7660FC (no conversion) */
 #define MMA7660_USE_1_SAMPLE_PER_SECOND         0x07   /**< Changes sampling rate to 1 sample per second */
 #define MMA7660_ALERT_BIT_SET_CHECK             0x40   /**< Verify weather alert bit is set in any of Xout,Yout or Zout register */
+#define MMA7660_XYZ_BURST_LEN                   3      /**< Xout, Yout and Zout read in one transfer, Tilt is left out as reading it clears the interrupts */
+#define MMA7660_XYZ_READ_ATTEMPTS               4      /**< Maximum number of transfers while the alert bit is set or the bus fails */
 
 #define MMA7660_SLEEP_COUNT_5S                  0x14   /**< SamplinG rate of AMSR is 4samples/s so 5*4=20 (0x14)*/
 #define MMA7660_SHAKE_ORIENT_INTERRUPT          0xE3   /**< Use Shake interupt on 3 axis and Front/Back & Up/Down/Right/Left interrupt*/
 #define MMA7660_AWE_ASE_SET                     0x18   /**< Set the Auto-wake and Auto-sleep modes*/
+#define MMA7660_AMSR_120SAMPLES                 0x00   /**< AMSR is set to 120 samples per second*/
+#define MMA7660_AMSR_64SAMPLES                  0x01   /**< AMSR is set to 64 samples per second*/
+#define MMA7660_AMSR_32SAMPLES                  0x02   /**< AMSR is set to 32 samples per second*/
+#define MMA7660_AMSR_16SAMPLES                  0x03   /**< AMSR is set to 16 samples per second*/
+#define MMA7660_AMSR_8SAMPLES                   0x04   /**< AMSR is set to 8 samples per second*/
 #define MMA7660_AMSR_4SAMPLES                   0x05   /**< AMSR is set to 4 samples per second*/
+#define MMA7660_AMSR_2SAMPLES                   0x06   /**< AMSR is set to 2 samples per second*/
+#define MMA7660_AMSR_1SAMPLES                   0x07   /**< AMSR is set to 1 sample per second*/
+#define MMA7660_XYZ_MASK                        0x3F   /**< 6 bit two's complement reading in Xout, Yout and Zout */
 #define MMA7660_AWSR_1SAMPLES                   0x18   /**< AWSR is set to 1 samples per second*/
 
 /**< Functions      */
 /*Public Functions*/
 bool        MMA7660_config_standby_and_initialize(void);              /**< Configure MMA7660FC in standby mode and enable Auto-sleep & Auto-wake mode   */   
 bool        MMA7660_read_xyz_reg_one_time(uint32_t * ptr_to_Reg_val); /**< Read contents of X-out,Y-out and Z-out registers 
-                                                                          , after reading activates standby mode            */ 
-void        MMA7660_ClearInterrupts(void);                            /**< Reading the TILT register clears the INTSU interrupt register*/																									
+                                                                          , false if no valid sample after MMA7660_XYZ_READ_ATTEMPTS */ 
+void        MMA7660_ClearInterrupts(void);                            /**< Reading the TILT register clears the INTSU interrupt register*/
+bool        MMA7660_config_stream(uint8_t amsr);                      /**< Sample continuously at an AMSR rate without Auto-sleep, for streaming */
+uint8_t     MMA7660_sample_rate(uint8_t amsr);                        /**< Samples per second of an AMSR setting */																									
 /*Private Functions*/
 bool        MMA7660_enable_active_mode(void);                         /**< Enable active mode for continuous  conversion     */
 bool        MMA7660_enable_standby_mode(void);                        /**< Enable standby mode (power down)                  */                 
@@ -225,9 +305,12 @@ bool        MMA7660_write_to_reg(uint8_t base_Address,uint8_t data);  /**< Write
 
 /**< Macros       */
 #define HTU21D_ADDRESS                          0x80   /**< Slave address of HTU21D */
-#define HTU21D_CRC_CHECK_ENABLE                 0x00   /**< 0x00 - Disabled 0x01 - Enabled */
+#define HTU21D_CRC_CHECK_ENABLE                 0x01   /**< 0x00 - Disabled 0x01 - Enabled */
+#define HTU21D_CRC_RETRY_COUNT                  1      /**< Number of times a measurement is repeated after a CRC error */
+#define HTU21D_CRC_BENCHMARK_ENABLE             0x00   /**< 0x00 - Disabled 0x01 - Enabled, compares the cycles of the table-driven and bit-serial CRC (uses TIMER1, see benchmark.h) */
 #define USE_HOLD_MASTER_MODE_ENABLE             0x01   /**< use Hold master mode while reading, if set to 0x00 use No hold master mode*/
 #define FEATURE_ENABLED                         0x01   /**< Default value for enabled feature*/
+#define HTU21D_APP_TIMER_PRESCALER              0      /**< Value of the RTC1 PRESCALER register, must match APP_TIMER_PRESCALER of the application */
 
 /* sensor command  */
 typedef enum
@@ -263,6 +346,16 @@ typedef enum
 	HTU21_HEATER_MASK        = 0x04, /**< Mask for Heater bit(2) in user reg.  */
 }etHTU21Heater;
 
+/* resolution profiles, each with its conversion times, see HTU21D_SetProfile() */
+typedef enum
+{
+	HTU21_PROFILE_RH12_T14   = 0x00, /**< RH=12bit, T=14bit, power on default   */
+	HTU21_PROFILE_RH10_T13   = 0x01, /**< RH=10bit, T=13bit                     */
+	HTU21_PROFILE_RH8_T12    = 0x02, /**< RH= 8bit, T=12bit                     */
+	HTU21_PROFILE_RH11_T11   = 0x03, /**< RH=11bit, T=11bit                     */
+	HTU21_PROFILE_COUNT              /**< Number of profiles                    */
+}etHTU21Profile;
+
 /* measurement signal selection */
 typedef enum
 {
@@ -270,6 +363,9 @@ typedef enum
 	TEMP
 }etHTU21MeasureType;
 
+/* handler of a measurement started with HTU21D_MeasureAsync(), called from HTU21D_MeasureProcess(), result is 0 on error */
+typedef void (*htu21d_measure_handler_t)(etHTU21MeasureType eHTU21MeasureType, uint16_t result);
+
 
 /**< Functions   */
 /*Public Functions*/
@@ -278,9 +374,20 @@ uint16_t eDRV_HTU21_MeasureTemperature(void);                                 /*
 uint16_t eDRV_HTU21_MeasureHumidity(void);                                    /**< Function to measure Humidity (16 bit value, status bit cleared) using  either Hold master / Polling mode, default : Hold master mode*/                                                                                
 bool HTU21D_WriteToUserRegister(uint8_t data);                                /**< Function to write data to the User register */
 uint8_t  HTU21D_ReadUserRegister(void);                                       /**< Function to read data from the User register */
+bool HTU21D_StartConversion(etHTU21MeasureType eHTU21MeasureType);           /**< Function to start a temperature/humidity conversion in NO HOLD MASTER mode without waiting */
+uint16_t HTU21D_ReadConversion(void);                                         /**< Function to read the result of HTU21D_StartConversion() (16 bit value, status bit cleared) */
+uint32_t HTU21D_MeasureAsyncInit(void);                                       /**< Function to create the timer used by HTU21D_MeasureAsync() */
+uint32_t HTU21D_MeasureAsync(etHTU21MeasureType eHTU21MeasureType, htu21d_measure_handler_t handler); /**< Function to start a NO HOLD MASTER measurement, completed by HTU21D_MeasureProcess() */
+bool HTU21D_MeasureElapsed(void);                                            /**< Function to check whether the conversion of HTU21D_MeasureAsync() has timed out */
+void HTU21D_MeasureProcess(void);                                            /**< Function to read the result of HTU21D_MeasureAsync() from the main loop and call its handler */
+bool HTU21D_SetProfile(etHTU21Profile eHTU21Profile);                        /**< Function to set the resolution profile, and with it the conversion times */
+etHTU21Profile HTU21D_GetProfile(void);                                      /**< Function to get the resolution profile in use */
+uint32_t HTU21D_CrcErrorCount(void);                                          /**< Function to get the number of CRC errors since power on */
+void HTU21D_CrcBenchmark(void);                                               /**< Function to measure the cycles of the CRC, if HTU21D_CRC_BENCHMARK_ENABLE is set */
+uint8_t HTU21D_ConversionTimeMs(etHTU21MeasureType eHTU21MeasureType);       /**< Function to get the conversion time in ms of the resolution profile in use */
 
 /*Private Functions */
-bool HTU21D_CheckCrc(uint8_t data[], uint8_t nbrOfBytes, uint8_t checksum);   /**< CRC error checking*/
+bool HTU21D_CheckCrc(const uint8_t data[], uint8_t nbrOfBytes, uint8_t checksum); /**< CRC error checking*/
 uint16_t HTU21D_MeasureHM(etHTU21MeasureType eHTU21MeasureType);              /**< Function to read the temperature/humidity   using HOLD MASTER mode */                                                                                  
 uint32_t HTU21D_ReadMeasurementValue(uint8_t Command_for_activity);           /**< Function to assist HOLD MASTER mode for data retrieval */
 uint16_t HTU21D_MeasurePOLL(etHTU21MeasureType eHTU21MeasureType);            /**< Function to read the temperature/humidity                                                                                      using NO HOLD MASTER mode(POLLING) */
@@ -296,9 +403,45 @@ float f32CalcRH(uint16_t);                                                    /*
 #define STOP_ADC                                                  0x01   /**< Defines for controlling ADC*/
 #define START_ADC                                                 0x01
 #define STOP_RUNNING_CONVERTION                                   0x00 
+#define ADC_OVERSAMPLING_DEFAULT                                  4      /**< Conversions averaged into one reading */
+#define ADC_OVERSAMPLING_MAX                                      64     /**< Conversions a request can average */
+#define ADC_QUEUE_LEN                                             4      /**< Requests waiting for the ADC */
+#define ADC_RESULT_MAX                                            1023   /**< Full scale of a 10 bit conversion */
+#define ADC_RESULT_PENDING                                        0xFFFF /**< Result of a request that is not converted yet */
+#define ADC_RESULT_TO_8BIT(result)                                ((uint8_t)((result) >> 2))  /**< Scale of the 8 bit sensor readings sent to the clients */
+
+/**@brief ADC configuration of analog input 'ain', 1/3 of the input against 1/3 of the supply (ratiometric sensors) */
+#define ADC_CONFIG_ANALOG_INPUT(ain)                              ((ADC_CONFIG_RES_10bit                            << ADC_CONFIG_RES_Pos)    | \
+                                                                   (ADC_CONFIG_INPSEL_AnalogInputOneThirdPrescaling << ADC_CONFIG_INPSEL_Pos) | \
+                                                                   (ADC_CONFIG_REFSEL_SupplyOneThirdPrescaling      << ADC_CONFIG_REFSEL_Pos) | \
+                                                                   ((1 << (ain))                                    << ADC_CONFIG_PSEL_Pos))
+
+/**@brief ADC configuration of the supply voltage, 1/3 of VDD against the 1.2 V band gap */
+#define ADC_CONFIG_SUPPLY                                         ((ADC_CONFIG_RES_10bit                            << ADC_CONFIG_RES_Pos)    | \
+                                                                   (ADC_CONFIG_INPSEL_SupplyOneThirdPrescaling      << ADC_CONFIG_INPSEL_Pos) | \
+                                                                   (ADC_CONFIG_REFSEL_VBG                           << ADC_CONFIG_REFSEL_Pos) | \
+                                                                   (ADC_CONFIG_PSEL_Disabled                        << ADC_CONFIG_PSEL_Pos)   | \
+                                                                   (ADC_CONFIG_EXTREFSEL_None                       << ADC_CONFIG_EXTREFSEL_Pos))
+
+/**< Typedefs    */
+typedef void (*adc_evt_handler_t)(uint16_t result);              /**< Handler of a converted request, called from the ADC interrupt */
+typedef void (*adc_start_handler_t)(void);                        /**< Starts a conversion instead of the driver, called once the ADC is configured */
+
+/**@brief ADC request, converted after the requests queued before it */
+typedef struct
+{
+    uint32_t                  config;                             /**< Value of the ADC CONFIG register, see ADC_CONFIG_ANALOG_INPUT() and ADC_CONFIG_SUPPLY */
+    uint8_t                   samples;                            /**< Conversions averaged into the result, 1 to ADC_OVERSAMPLING_MAX */
+    volatile uint16_t *       p_result;                           /**< If not NULL, receives the result */
+    adc_evt_handler_t         evt_handler;                        /**< If not NULL, called with the result */
+    adc_start_handler_t       start_handler;                      /**< If not NULL, starts each conversion (e.g. over PPI), otherwise the driver starts it */
+} adc_request_t;
 
 /**< Functions   */
-void     adc_init(void);                                                 /**< Initialize ADC */
+void     adc_init(void);                                                 /**< Initialize ADC interrupt, called by the first request if needed */
+uint32_t adc_request(const adc_request_t * p_request);                   /**< Queue an ADC request, the result is delivered from the ADC interrupt */
+uint16_t adc_measure(uint32_t config, uint8_t samples);                  /**< Read an ADC input, the CPU sleeps until the request is converted */
+uint16_t adc_measure_triggered(uint32_t config, uint8_t samples, adc_start_handler_t start_handler); /**< Read an ADC input, the conversions are started by start_handler */
 uint8_t do_soil_moisture_measurement(void);                              /**< Read soil moisture value from ADC interfaced to soil moisture sensor*/
 uint8_t do_probe_temperature_measurement(void);                          /**< Read the probe temperature using ADC*/
 uint8_t do_waterl_adc_measurement(void);                                 /**< Read water level using ADC */         
@@ -311,12 +454,22 @@ uint8_t do_waterl_adc_measurement(void);                                 /**< Re
 #define PWM_OUTPUT_PIN_NUMBER    1    /**< Pin number for PWM output.*/
 #define TICKS (4UL)                   /**< Ticks */
 #define TIMER_PRESCALERS 1U           /**< Prescaler setting for timer, as 1. */
+#define ONE_MHZ_PPI_CH_TOGGLE                0    /**< PPI channel toggling the output on TIMER2 COMPARE[0]*/
+#define ONE_MHZ_PPI_CH_COUNT                 1    /**< PPI channel counting the toggles with TIMER1*/
+#define ONE_MHZ_PPI_CH_ADC_START             2    /**< PPI channel starting the ADC on TIMER1 COMPARE[0]*/
+#define ONE_MHZ_PPI_CH_STOP                  3    /**< PPI channel stopping the wave at the ADC END event*/
+#define ONE_MHZ_SETTLE_US                    10000  /**< Excitation before the ADC samples the soil moisture sensor, max 32767 us*/
+#define ONE_MHZ_SETTLE_TOGGLES               (2 * ONE_MHZ_SETTLE_US)  /**< Output toggles in the settling time, even so the ADC always starts at the same phase */
+#define SOIL_MOISTURE_OVERSAMPLING           1    /**< Excitation and conversion cycles averaged into one soil moisture reading*/
 
 /**< Functions   */
 void    timer2_init(void);                                               /**< Initialize timer 2 module*/
 void    gpiote1_init(void);                                              /**< Initialize GPIOTE*/
 void    ppi_init(void);                                                  /**< Initialize PPI*/
 int     one_mhz_start(void);                                             /**< Start 1Mhz wave*/
+void    one_mhz_sync_init(void);                                         /**< Prepare the 1Mhz wave, TIMER1 and PPI for an ADC conversion at a fixed phase (TIMER1 is not free for benchmarks meanwhile)*/
+void    one_mhz_sync_start(void);                                        /**< Start the 1Mhz wave, the ADC starts after ONE_MHZ_SETTLE_US and its END event stops the wave*/
+void    one_mhz_stop(void);                                              /**< Stop the 1Mhz wave, release PPI, TIMER1 and the 16 MHz crystal*/
 
 
 /********************************************************************************************/ 
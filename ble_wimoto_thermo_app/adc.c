@@ -0,0 +1,224 @@
+/** @file
+* This file contains the source code for the ADC driver shared by the sensors and the battery measurement.
+*
+* Requests are queued and converted one after the other from the ADC interrupt, each request
+* averages a number of 10 bit conversions. The CPU sleeps while a conversion runs.
+*/
+
+#include "wimoto_sensors.h"
+#include "wimoto.h"
+#include "nrf_soc.h"
+#include "nrf_error.h"
+#include "app_util.h"
+
+/********************************************************************************************/
+/* PRIVATE VARIABLES																		*/
+/********************************************************************************************/
+static adc_request_t  m_adc_queue[ADC_QUEUE_LEN];            /**< Requests waiting for the ADC, the first one is being converted */
+static uint8_t        m_adc_queue_head  = 0;                 /**< Request being converted */
+static uint8_t        m_adc_queue_count = 0;                 /**< Requests in the queue */
+static uint32_t       m_adc_sum;                             /**< Sum of the conversions of the current request */
+static uint8_t        m_adc_conversions;                     /**< Conversions done for the current request */
+static bool           m_adc_initialized = false;             /**< ADC interrupt is enabled */
+
+
+
+/********************************************************************************************/
+/* PRIVATE FUNCTIONS																		*/
+/********************************************************************************************/
+
+/**
+*@brief   Function to start a conversion of the request at the head of the queue
+*@details The request's start handler starts the conversion if it has one (e.g. over PPI)
+*/
+static void adc_start_conversion(void)
+{
+    if (m_adc_queue[m_adc_queue_head].start_handler != NULL)
+    {
+        m_adc_queue[m_adc_queue_head].start_handler();
+    }
+    else
+    {
+        NRF_ADC->TASKS_START = START_ADC;
+    }
+}
+
+
+/**
+*@brief   Function to start the request at the head of the queue
+*/
+static void adc_start_head(void)
+{
+    m_adc_sum         = 0;
+    m_adc_conversions = 0;
+
+    NRF_ADC->CONFIG     = m_adc_queue[m_adc_queue_head].config;
+    NRF_ADC->EVENTS_END = STOP_RUNNING_CONVERTION;
+    NRF_ADC->ENABLE     = ADC_ENABLE_ENABLE_Enabled;
+    adc_start_conversion();
+}
+
+
+/**
+*@brief   ADC interrupt handler
+*@details 1.Adds the result to the sum and starts the next conversion until all the conversions
+*            of the request are done
+*         2.Disables the ADC, removes the request from the queue and starts the next request
+*         3.Delivers the rounded average to the request, after the queue is updated so the
+*            handler can queue a new request
+*/
+void ADC_IRQHandler(void)
+{
+    adc_request_t request;
+    uint16_t      result;
+
+    NRF_ADC->EVENTS_END = STOP_RUNNING_CONVERTION;
+    m_adc_sum += NRF_ADC->RESULT;
+    m_adc_conversions++;
+
+    request = m_adc_queue[m_adc_queue_head];
+    if (m_adc_conversions < request.samples)
+    {
+        adc_start_conversion();
+        return;
+    }
+
+    NRF_ADC->ENABLE = ADC_ENABLE_ENABLE_Disabled;
+    result = (uint16_t)((m_adc_sum + (request.samples / 2)) / request.samples);
+
+    m_adc_queue_head = (m_adc_queue_head + 1) % ADC_QUEUE_LEN;
+    m_adc_queue_count--;
+    if (m_adc_queue_count > 0)
+    {
+        adc_start_head();
+    }
+
+    if (request.p_result != NULL)
+    {
+        *request.p_result = result;
+    }
+    if (request.evt_handler != NULL)
+    {
+        request.evt_handler(result);
+    }
+}
+
+
+
+/********************************************************************************************/
+/* PUBLIC FUNCTIONS																		    */
+/********************************************************************************************/
+
+/**
+*@brief   Function for ADC initialization
+*@details Enables the ADC interrupt, the ADC itself is only enabled while a request is converted.
+*         Called by the first request if the application did not call it.
+*/
+void adc_init(void)
+{
+    if (m_adc_initialized)
+    {
+        return;
+    }
+
+    NRF_ADC->ENABLE   = ADC_ENABLE_ENABLE_Disabled;
+    NRF_ADC->INTENSET = ADC_INTENSET_END_Msk;
+
+    NVIC_ClearPendingIRQ(ADC_IRQn);
+    NVIC_SetPriority(ADC_IRQn, APP_IRQ_PRIORITY_HIGH);
+    NVIC_EnableIRQ(ADC_IRQn);
+
+    m_adc_initialized = true;
+}
+
+
+/**
+*@brief   Function to queue an ADC request
+*@details 1.The request is copied, the caller does not have to keep it
+*         2.The ADC is started if it is idle, otherwise the request is converted after the
+*            requests in front of it
+*         3.Returns NRF_ERROR_NO_MEM if the queue is full and NRF_ERROR_INVALID_PARAM for zero samples
+*/
+uint32_t adc_request(const adc_request_t * p_request)
+{
+    uint8_t nested;
+    bool     start    = false;
+    uint32_t err_code = NRF_SUCCESS;
+
+    if ((p_request->samples == 0) || (p_request->samples > ADC_OVERSAMPLING_MAX))
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+
+    adc_init();
+
+    // Requests come from the main loop and from the timer handlers
+    (void)sd_nvic_critical_region_enter(&nested);
+    if (m_adc_queue_count == ADC_QUEUE_LEN)
+    {
+        err_code = NRF_ERROR_NO_MEM;
+    }
+    else
+    {
+        m_adc_queue[(m_adc_queue_head + m_adc_queue_count) % ADC_QUEUE_LEN] = *p_request;
+        m_adc_queue_count++;
+        start = (m_adc_queue_count == 1);
+    }
+    (void)sd_nvic_critical_region_exit(nested);
+
+    // The ADC interrupt can not change the queue while the ADC is idle
+    if (start)
+    {
+        adc_start_head();
+    }
+
+    return err_code;
+}
+
+
+/**
+*@brief   Function to read an ADC input with conversions started by the caller
+*@details 1.Queues a request of 'samples' conversions with the configuration given as the argument
+*         2.start_handler is called for each conversion once the ADC is configured, it starts the
+*            conversion, e.g. a timer that triggers the ADC START task over PPI
+*         3.Sleeps until the request is converted, the ADC interrupt wakes the CPU
+*         4.Must not be called from an interrupt of APP_IRQ_PRIORITY_HIGH, the ADC interrupt
+*            would not be served
+*@retval  Average of the 10 bit conversions
+*/
+uint16_t adc_measure_triggered(uint32_t config, uint8_t samples, adc_start_handler_t start_handler)
+{
+    adc_request_t     request;
+    volatile uint16_t result = ADC_RESULT_PENDING;
+
+    request.config        = config;
+    request.samples       = samples;
+    request.p_result      = &result;
+    request.evt_handler   = NULL;
+    request.start_handler = start_handler;
+
+    // Wait for a free place in the queue
+    while (adc_request(&request) == NRF_ERROR_NO_MEM)
+    {
+        __WFE();
+    }
+
+    while (result == ADC_RESULT_PENDING)
+    {
+        __WFE();
+    }
+
+    return result;
+}
+
+
+/**
+*@brief   Function to read an ADC input
+*@details Queues a request of 'samples' conversions and sleeps until it is converted, see
+*         adc_measure_triggered()
+*@retval  Average of the 10 bit conversions
+*/
+uint16_t adc_measure(uint32_t config, uint8_t samples)
+{
+    return adc_measure_triggered(config, samples, NULL);
+}
@@ -127,6 +127,12 @@ void ble_dlogs_on_ble_evt(ble_dlogs_t * p_dlogs, ble_evt_t * p_ble_evt);
 */
 void write_data_flash(uint32_t * data);																
 
+/**@brief Function for getting how much of the cyclic buffer holds logged data.
+*
+* @return      Fill level in percent, 100 once the buffer has wrapped around.
+*/
+uint8_t data_log_fill_level(void);
+
 /**@brief Function to send data to the connected BLE central device.
 *
 * @param[in]   ble_dlogs        Data logger service structure.
@@ -20,6 +20,7 @@
 #include "app_util.h"
 #include "wimoto.h"
 #include "wimoto_sensors.h"
+#include "sample_cache.h"
 
 bool PROBES_CONNECTED_STATE=false;      /*This flag indicates whether a client is connected to the peripheral in probe temperature service*/
 extern bool    BROADCAST_MODE;
@@ -777,8 +778,17 @@ uint32_t ble_probes_level_alarm_check(ble_probes_t * p_probes)
 */
 uint8_t read_probe_temp_level()   
 {
-    static uint8_t current_probe_temp_level=0x00;                            
+    static uint8_t current_probe_temp_level=0x00;
+    static sample_cache_t probe_temp_cache;
+
+    if (sample_cache_fresh(&probe_temp_cache))
+    {
+        return current_probe_temp_level;            /* Reuse the sample of this tick*/
+    }
+
     current_probe_temp_level = do_probe_temperature_measurement();  /*Read probe temperature level from ADC */
+    sample_cache_update(&probe_temp_cache);
+
     return current_probe_temp_level;
 }	
 
@@ -216,15 +216,11 @@ static void on_write(ble_thermops_t * p_thermops, ble_evt_t * p_ble_evt)
     if (
             (p_evt_write->handle == p_thermops->thermop_low_level_handles.value_handle) 
             && 
-            (p_evt_write->len == 5)
+            (p_evt_write->len == THERMOP_CHAR_SIZE)
             )
     {
-        // update the temperature service structure
-        p_thermops->thermo_thermopile_low_level[0] =   p_evt_write->data[0];
-        p_thermops->thermo_thermopile_low_level[1] =   p_evt_write->data[1];
-        p_thermops->thermo_thermopile_low_level[2] =   p_evt_write->data[2];
-        p_thermops->thermo_thermopile_low_level[3] =   p_evt_write->data[3];
-        p_thermops->thermo_thermopile_low_level[4] =   p_evt_write->data[4];
+        // update the temperature service structure, levels are compared as integers
+        p_thermops->thermo_thermopile_low_level = TMP006_ObjTemp_decode(p_evt_write->data);
 
         // call application event handler
         p_thermops->write_evt_handler();
@@ -234,15 +230,11 @@ static void on_write(ble_thermops_t * p_thermops, ble_evt_t * p_ble_evt)
     if (
             (p_evt_write->handle == p_thermops->thermop_high_level_handles.value_handle) 
             && 
-            (p_evt_write->len == 5)
+            (p_evt_write->len == THERMOP_CHAR_SIZE)
             )
     {
-        // update the temperature service structure
-        p_thermops->thermo_thermopile_high_level[0] =   p_evt_write->data[0];
-        p_thermops->thermo_thermopile_high_level[1] =   p_evt_write->data[1];
-        p_thermops->thermo_thermopile_high_level[2] =   p_evt_write->data[2];
-        p_thermops->thermo_thermopile_high_level[3] =   p_evt_write->data[3];
-        p_thermops->thermo_thermopile_high_level[4] =   p_evt_write->data[4];
+        // update the temperature service structure, levels are compared as integers
+        p_thermops->thermo_thermopile_high_level = TMP006_ObjTemp_decode(p_evt_write->data);
 
         // call application event handler
         p_thermops->write_evt_handler();
@@ -302,7 +294,7 @@ static uint32_t current_thermopile_char_add(ble_thermops_t * p_thermops, const b
     ble_gatts_attr_t    attr_char_value;
     ble_uuid_t          ble_uuid;
     ble_gatts_attr_md_t attr_md;
-    static uint8_t      current_thermopile[5];
+    static uint8_t      current_thermopile[THERMOP_CHAR_SIZE];
 
     if (p_thermops->is_notification_supported)
     {
@@ -370,7 +362,7 @@ static uint32_t thermopile_low_value_char_add(ble_thermops_t * p_thermops, const
     ble_gatts_attr_t    attr_char_value;
     ble_uuid_t          ble_uuid;
     ble_gatts_attr_md_t attr_md;
-    static uint8_t      thermo_thermopile_low_level[5];
+    static uint8_t      thermo_thermopile_low_level[THERMOP_CHAR_SIZE];
 
     // Add Thermopile low value characteristic
     memset(&char_md, 0, sizeof(char_md));
@@ -395,11 +387,7 @@ static uint32_t thermopile_low_value_char_add(ble_thermops_t * p_thermops, const
     attr_md.wr_auth    = 0;
     attr_md.vlen       = 0;
 
-    thermo_thermopile_low_level[4] = p_thermops_init->thermo_thermopile_low_level[4];
-    thermo_thermopile_low_level[3] = p_thermops_init->thermo_thermopile_low_level[3];
-    thermo_thermopile_low_level[2] = p_thermops_init->thermo_thermopile_low_level[2];		
-    thermo_thermopile_low_level[1] = p_thermops_init->thermo_thermopile_low_level[1];
-    thermo_thermopile_low_level[0] = p_thermops_init->thermo_thermopile_low_level[0];		
+    TMP006_ObjTemp_encode(p_thermops_init->thermo_thermopile_low_level, thermo_thermopile_low_level);
     memset(&attr_char_value, 0, sizeof(attr_char_value));
 
     attr_char_value.p_uuid       = &ble_uuid;
@@ -435,7 +423,7 @@ static uint32_t thermopile_high_value_char_add(ble_thermops_t * p_thermops, cons
     ble_gatts_attr_t    attr_char_value;
     ble_uuid_t          ble_uuid;
     ble_gatts_attr_md_t attr_md;
-    static uint8_t      thermo_thermopile_high_level[5];
+    static uint8_t      thermo_thermopile_high_level[THERMOP_CHAR_SIZE];
 
 
     memset(&char_md, 0, sizeof(char_md));
@@ -460,11 +448,7 @@ static uint32_t thermopile_high_value_char_add(ble_thermops_t * p_thermops, cons
     attr_md.wr_auth    = 0;
     attr_md.vlen       = 0;
 
-    thermo_thermopile_high_level[4] = p_thermops_init->thermo_thermopile_high_level[4];
-    thermo_thermopile_high_level[3] = p_thermops_init->thermo_thermopile_high_level[3];  /*Default values for thermopile high value*/
-    thermo_thermopile_high_level[2] = p_thermops_init->thermo_thermopile_high_level[2];	
-    thermo_thermopile_high_level[1] = p_thermops_init->thermo_thermopile_high_level[1];  /*Default values for thermopile high value*/
-    thermo_thermopile_high_level[0] = p_thermops_init->thermo_thermopile_high_level[0];	
+    TMP006_ObjTemp_encode(p_thermops_init->thermo_thermopile_high_level, thermo_thermopile_high_level);  /*Default values for thermopile high value*/
 
     memset(&attr_char_value, 0, sizeof(attr_char_value));
 
@@ -655,17 +639,8 @@ uint32_t ble_thermops_init(ble_thermops_t * p_thermops, const ble_thermops_init_
     p_thermops->is_notification_supported = p_thermops_init->support_notification;
 
 
-    p_thermops->thermo_thermopile_high_level[4] = p_thermops_init->thermo_thermopile_high_level[4];
-    p_thermops->thermo_thermopile_high_level[3] = p_thermops_init->thermo_thermopile_high_level[3];  /*Default values for thermopile high value*/
-    p_thermops->thermo_thermopile_high_level[2] = p_thermops_init->thermo_thermopile_high_level[2];	
-    p_thermops->thermo_thermopile_high_level[1] = p_thermops_init->thermo_thermopile_high_level[1];  /*Default values for thermopile high value*/
-    p_thermops->thermo_thermopile_high_level[0] = p_thermops_init->thermo_thermopile_high_level[0];	
-
-    p_thermops->thermo_thermopile_low_level[4] = p_thermops_init->thermo_thermopile_low_level[4];
-    p_thermops->thermo_thermopile_low_level[3] = p_thermops_init->thermo_thermopile_low_level[3];
-    p_thermops->thermo_thermopile_low_level[2] = p_thermops_init->thermo_thermopile_low_level[2];		
-    p_thermops->thermo_thermopile_low_level[1] = p_thermops_init->thermo_thermopile_low_level[1];
-    p_thermops->thermo_thermopile_low_level[0] = p_thermops_init->thermo_thermopile_low_level[0];		
+    p_thermops->thermo_thermopile_high_level   = p_thermops_init->thermo_thermopile_high_level;  /*Default values for thermopile high value*/
+    p_thermops->thermo_thermopile_low_level    = p_thermops_init->thermo_thermopile_low_level;
 
     p_thermops->thermo_thermopile_alarm_set    = p_thermops_init->thermo_thermopile_alarm_set;
     p_thermops->thermo_thermopile_alarm        = p_thermops_init->thermo_thermopile_alarm;
@@ -719,26 +694,30 @@ uint32_t ble_thermops_init(ble_thermops_t * p_thermops, const ble_thermops_init_
 * @return      NRF_SUCCESS on success, otherwise an error code.
 */
 uint32_t ble_thermops_level_alarm_check(ble_thermops_t * p_thermops)
+{
+    return ble_thermops_level_alarm_update(p_thermops, read_thermopile_connectable());  /* read the current thermopile*/
+}
+
+/**@brief Function updates the current thermopile with a measured value and checks for alarm condition.
+*
+* @param[in]   p_thermops           Thermopile Service structure.
+* @param[in]   current_thermopile   Thermopile temperature measured by the application, in 0.01 degrees C.
+*
+* @return      NRF_SUCCESS on success, otherwise an error code.
+*/
+uint32_t ble_thermops_level_alarm_update(ble_thermops_t * p_thermops, int16_t current_thermopile)
 {
     uint32_t err_code = NRF_SUCCESS;
-    float current_thermopile;
     uint8_t  current_thermopile_array[THERMOP_CHAR_SIZE];
-    float thermopile_low_value;		
-    float thermopile_high_value;		
 
-    static float  previous_thermopile = 0x00;
+    static int16_t previous_thermopile = 0x00;
     uint8_t alarm = 0x00;
 
     uint16_t len = sizeof(uint8_t);
-    uint16_t len1 = sizeof(current_thermopile_array);
+    uint16_t len1 = THERMOP_CHAR_SIZE;
 
-    read_thermopile_connectable(current_thermopile_array, &current_thermopile); /* read the current thermopile*/
-
-    int i;
-    for (i=0;i<THERMOP_CHAR_SIZE;i++)
-    {
-        current_thermopile_temp_store[i] = current_thermopile_array[i]; /*store the current thermopile to a global array to be used for data logging*/
-    }
+    TMP006_ObjTemp_encode(current_thermopile, current_thermopile_array);         /* encode the current thermopile*/
+    memcpy(current_thermopile_temp_store, current_thermopile_array, THERMOP_CHAR_SIZE); /*store the current thermopile to a global array to be used for data logging*/
 
     if(current_thermopile != previous_thermopile)                   /*Check whether thermopile value has changed*/
     {   
@@ -766,25 +745,17 @@ uint32_t ble_thermops_level_alarm_check(ble_thermops_t * p_thermops)
         }
     }		
 
-    /*Get the thermopile low value set by the user from the service */
-    thermopile_low_value  = stof((char *)(p_thermops->thermo_thermopile_low_level));
-
-    /*Get the thermopile high value set by the user from the service */
-    thermopile_high_value = stof(((char *)p_thermops->thermo_thermopile_high_level));
-
-
-
     /*Check whether the thermopile is out of range if alarm is set by user */		
     if(p_thermops->thermo_thermopile_alarm_set != 0x00)
     {
 
 
-        if(current_thermopile < thermopile_low_value)
+        if(current_thermopile < p_thermops->thermo_thermopile_low_level)
         {
             alarm = SET_ALARM_THERMOP_LOW;		//set alarm to 01 if thermopile is low 
         }
 
-        else if(current_thermopile > thermopile_high_value)
+        else if(current_thermopile > p_thermops->thermo_thermopile_high_level)
         {
             alarm = SET_ALARM_THERMOP_HIGH;		//set alarm to 02 if thermopile is high 
         } 
@@ -835,14 +806,15 @@ uint32_t ble_thermops_level_alarm_check(ble_thermops_t * p_thermops)
 
 /**@brief Function to read thermopile from tmp006.
 *
-* @param[out]   uint8_t *buffer 
-* @param[out]   float *fTemp
+* @return      Thermopile temperature in 0.01 degrees C.
 */
-void read_thermopile_connectable(uint8_t *buffer, float *fTemp)   
+int16_t read_thermopile_connectable(void)   
 {
+    int16_t thermopile;
+
     twi_turn_ON();
-    do_thermopile_measurement(buffer, fTemp);
+    thermopile = TMP006_ObjTempCentiC_conversion();
     twi_turn_OFF();
-    return;
+    return thermopile;
 }	
 
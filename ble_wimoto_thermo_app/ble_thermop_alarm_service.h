@@ -58,8 +58,8 @@ typedef struct
     ble_thermops_write_evt_handler_t write_evt_handler;
     bool                          support_notification;              /**< TRUE if notification of Thermopile Level measurement is supported. */
     ble_srv_report_ref_t *        p_report_ref;                      /**< If not NULL, a Report Reference descriptor with the specified value will be added to the Thermopile Level characteristic */
-    uint8_t                       thermo_thermopile_low_level[5];  /**< thermopile low level */
-    uint8_t                       thermo_thermopile_high_level[5]; /**< thermopile high level */
+    int16_t                       thermo_thermopile_low_level;     /**< thermopile low level in 0.01 degrees C */
+    int16_t                       thermo_thermopile_high_level;    /**< thermopile high level in 0.01 degrees C */
     uint8_t												thermo_thermopile_alarm_set;     /** Alarm set for thermopile **/
     uint8_t												thermo_thermopile_alarm;   			 /** Alarm for thermopile **/
     ble_srv_cccd_security_mode_t  thermopile_char_attr_md;          /**< Initial security level for Thermopile characteristics attribute */
@@ -81,8 +81,8 @@ typedef struct ble_thermops_s
     ble_gatts_char_handles_t      thermo_thermop_alarm_handles;      	/**< Handles for thermopile alarm characteristic. */
     ble_gatts_char_handles_t      switch_mode_handles;      	/**< Handles for thermopile alarm characteristic. */
     uint16_t                      report_ref_handle;              	/**< Handle of the Report Reference descriptor. */
-    uint8_t                       thermo_thermopile_low_level[5];   	/**< thermopile low level for alarm for thermopile Service. */
-    uint8_t                       thermo_thermopile_high_level[5];   /**< thermopile high level for alarm for thermopile Service. */
+    int16_t                       thermo_thermopile_low_level;      	/**< thermopile low level in 0.01 degrees C for alarm for thermopile Service, decoded when written. */
+    int16_t                       thermo_thermopile_high_level;      /**< thermopile high level in 0.01 degrees C for alarm for thermopile Service, decoded when written. */
     uint8_t						            thermo_thermopile_alarm_set;   	/** Alarm set for thermopile **/
     uint8_t						            thermo_thermopile_alarm;   			/** Alarm for thermopile **/
     uint16_t                      conn_handle;                    /**< Handle of the current connection (as provided by the BLE stack, is BLE_CONN_HANDLE_INVALID if not in a connection). */
@@ -135,9 +135,20 @@ void ble_thermops_on_ble_evt(ble_thermops_t * p_bas, ble_evt_t * p_ble_evt);
 */
 uint32_t ble_thermops_level_alarm_check(ble_thermops_t *);
 
+/**@brief Function for updating the Thermopile level with a value measured by the application.
+*
+* @details Same as ble_thermops_level_alarm_check(), for measurements completed asynchronously.
+*
+* @param[in]   p_thermops           Thermopile Service structure.
+* @param[in]   current_thermopile   Measured thermopile temperature in 0.01 degrees C.
+*
+* @return      NRF_SUCCESS on success, otherwise an error code.
+*/
+uint32_t ble_thermops_level_alarm_update(ble_thermops_t * p_thermops, int16_t current_thermopile);
+
 
 //uint32_t read_thermopile(void);									 /** Function for reading thermopile from sensor **/
-void read_thermopile_connectable(uint8_t *, float *);
+int16_t read_thermopile_connectable(void);
 uint8_t  do_battery_measurement(void);						 /*funtion for taking the battery measurement*/
 //float    convert_thermopile_to_float(uint16_t );  /*function for converting 12-bit thermopile to float*/
 float stof(char*);
@@ -46,6 +46,7 @@
 #include "wimoto.h"
 #include "ble_device_mgmt_service.h"
 #include "battery.h"
+#include "benchmark.h"
 
 #define SEND_MEAS_BUTTON_PIN_NO              16                                         /**< Button used for sending a measurement. */
 #define BONDMNGR_DELETE_BUTTON_PIN_NO        17                                         /**< Button used for deleting all bonded masters during startup. */
@@ -58,14 +59,17 @@
 
 #define APP_ADV_INTERVAL                     0x81A                                      /**< The advertising interval (in units of 0.625 ms. This value corresponds to 25 ms). */
 #define APP_ADV_TIMEOUT_IN_SECONDS           0x0000                                     /**< The advertising timeout in units of seconds. */
+#define LIVE_BEACON_ENABLE                   0x01                                       /**< 0x00 - Disabled 0x01 - Enabled, connectable advertising also carries the live sensor readings */
+#define BEACON_DATA_LEN                      (THERMOP_CHAR_SIZE + 1)                    /**< Length of the sensor readings carried in the advertising data. */
 
 #define APP_TIMER_PRESCALER                  0                                          /**< Value of the RTC1 PRESCALER register. */
-#define APP_TIMER_MAX_TIMERS                 5                                          /**< Maximum number of simultaneously created timers. */
+#define APP_TIMER_MAX_TIMERS                 6                                          /**< Maximum number of simultaneously created timers. */
 #define APP_TIMER_OP_QUEUE_SIZE              4                                          /**< Size of timer operation queues. */
 
 #define THERMOPILE_LEVEL_MEAS_INTERVAL       APP_TIMER_TICKS(3000, APP_TIMER_PRESCALER)/**< temperature level measurement interval (ticks). */
 #define CONNECTED_MODE_TIMEOUT_INTERVAL      APP_TIMER_TICKS(30000, APP_TIMER_PRESCALER)/**< Connected mode timeout interval (ticks). */
 #define SECONDS_INTERVAL                     APP_TIMER_TICKS(1000, APP_TIMER_PRESCALER) /**< seconds measurement interval (ticks). */
+#define BATTERY_POLL_COUNT                   10                                         /**< The battery is measured on every 10th alarm check, one every 6 s (60 s), the samples are timed by the radio notifications. */
 
 #define THERMOP_TYPE_AS_CHARACTERISTIC       0                                          /**< Determines if temperature type is given as characteristic (1) or as a field of measurement (0). */
 
@@ -82,7 +86,7 @@
 #define NEXT_CONN_PARAMS_UPDATE_DELAY        APP_TIMER_TICKS(5000, APP_TIMER_PRESCALER) /**< Time between each call to sd_ble_gap_conn_param_update after the first (30 seconds). */
 #define MAX_CONN_PARAMS_UPDATE_COUNT         3                                          /**< Number of attempts before giving up the connection parameter negotiation. */
 
-#define APP_GPIOTE_MAX_USERS                 1                                          /**< Maximum number of users of the GPIOTE handler. */
+#define APP_GPIOTE_MAX_USERS                 2                                          /**< Maximum number of users of the GPIOTE handler (buttons and TMP006 DRDY). */
 
 #define BUTTON_DETECTION_DELAY               APP_TIMER_TICKS(50, APP_TIMER_PRESCALER)   /**< Delay from a GPIOTE event until a button is reported as pushed (in number of timer ticks). */
 
@@ -105,6 +109,12 @@
 static uint16_t                              m_conn_handle = BLE_CONN_HANDLE_INVALID;   /**< Handle of the current connection. */
 static ble_gap_sec_params_t                  m_sec_params;                              /**< Security requirements for this application. */
 static ble_gap_adv_params_t                  m_adv_params;                              /**< Parameters to be passed to the stack when starting advertising. */
+static ble_advdata_t                         m_advdata;                                 /**< Advertising data, kept so that it can be re-encoded with new readings. */
+static ble_advdata_t                         m_srdata;                                  /**< Scan response data. */
+#if (LIVE_BEACON_ENABLE == FEATURE_ENABLED)
+static ble_advdata_manuf_data_t              m_beacon_manuf_data;                       /**< Manufacturer data carrying the live sensor readings. */
+static uint8_t                               m_beacon_data[BEACON_DATA_LEN];            /**< Live sensor readings. */
+#endif
 static ble_thermops_t                        m_thermops;                                /**< Structure used to identify the temperature value service. */
 static ble_probes_t                          m_probes;                                  /**< Structure used to identify the humidity alarm service. */
 static ble_dlogs_t                           m_dlogs;																	  /**< Structure used to identify the data logger service. */
@@ -112,9 +122,15 @@ static ble_device_t                          m_device;
 
 static app_timer_id_t                        thermop_measurement_timer;                 /**< thermo measurement timer. */
 static app_timer_id_t                        real_time_timer;                           /**< Time keeping timer. */
+static volatile bool                         m_tmp006_measuring = false;                /**< Set while the TMP006 conversion of an alarm check is in progress*/
+static volatile bool                         m_tmp006_measure_done = false;             /**< Set once the TMP006 conversion of an alarm check has completed*/
+static int16_t                               m_tmp006_obj_temp;                         /**< Object temperature in 0.01 C of the last completed TMP006 measurement*/
 
 uint8_t 							                       battery_level=0; 
 ble_date_time_t                              m_time_stamp;                              /**< Time stamp. */
+uint32_t                                     m_uptime_seconds = 0;                      /**< Seconds since power on, counted in both modes. */
+volatile uint32_t                            m_sample_conversions = 0;                  /**< Sensor conversions done by the read functions, see sample_cache.h. */
+volatile uint32_t                            m_sample_cache_hits = 0;                   /**< Sensor conversions saved by the sample cache. */
 ble_bas_t                             			 bas;                                       /**< Structure used to identify the battery service. */
 
 bool 																				 ENABLE_DATA_LOG=false;											/**< Flag to enable data logger */
@@ -123,6 +139,7 @@ bool 																				 START_DATA_READ=true;											/**< flag to start dat
 bool 																				 TX_COMPLETE=false;				      						/**< flag to indicate transmission complete*/ 
 bool                                         TIME_SET = false;                          /**< flag to indicate user set time*/
 bool                                         CHECK_ALARM_TIMEOUT = false;               /**< Flag to indicate whether to check for alarm conditions*/
+static uint8_t                               m_battery_poll_count = BATTERY_POLL_COUNT; /**< Alarm checks since the last battery measurement*/
 bool                                         DATA_LOG_CHECK=false;                      /**< Flag to indicate whether to check for data logging*/
 
 extern bool 	                               BROADCAST_MODE;                            /**< flag used to switch between broadcast and connectable modes*/    
@@ -186,13 +203,29 @@ static void app_error_handler(uint32_t error_code, uint32_t line_num, const uint
 app_error_handler(DEAD_BEEF, line_num, p_file_name);
 }*/
 
+/**@brief Function for handling a completed TMP006 measurement.
+*
+* @details Runs in the GPIOTE interrupt on DRDY, or in the app_timer interrupt if DRDY was not
+*          asserted. The main loop updates the thermopile service.
+*/
+static void tmp006_measure_handler(int16_t obj_temp)
+{
+    m_tmp006_obj_temp     = obj_temp;
+    m_tmp006_measuring    = false;
+    m_tmp006_measure_done = true;
+}
+
 /**@brief Function for performing check for the alarm condition.
+*
+* @details The probe temperature is checked right away. The thermopile temperature is converted
+*          and averaged by the TMP006 while the CPU sleeps, and is checked by
+*          thermopile_alarm_check() once tmp006_measure_handler() has the result.
 */
 static void alarm_check(void)
 {
     uint32_t err_code;
 
-    err_code = ble_thermops_level_alarm_check(&m_thermops);  /*check whether the thermopile temperature is out of range*/
+    err_code = ble_probes_level_alarm_check(&m_probes);   /*check whether the probe temperature is out of range*/
     if ((err_code != NRF_SUCCESS) &&
             (err_code != NRF_ERROR_INVALID_STATE) &&
             (err_code != BLE_ERROR_NO_TX_BUFFERS) &&
@@ -200,9 +233,24 @@ static void alarm_check(void)
             )
     {
         APP_ERROR_HANDLER(err_code);
+    } 
+
+    m_tmp006_measuring = true;
+    if (TMP006_MeasureAsync(tmp006_measure_handler) != NRF_SUCCESS)
+    {
+        m_tmp006_measuring    = false;
+        m_tmp006_obj_temp     = TMP006_ObjTempCentiC_last();  /* Same value as a failed read*/
+        m_tmp006_measure_done = true;
     }
+}		
 
-    err_code = ble_probes_level_alarm_check(&m_probes);   /*check whether the probe temperature is out of range*/
+/**@brief Function for performing check for the thermopile alarm condition with the completed measurement.
+*/
+static void thermopile_alarm_check(void)
+{
+    uint32_t err_code;
+
+    err_code = ble_thermops_level_alarm_update(&m_thermops, m_tmp006_obj_temp);  /*check whether the thermopile temperature is out of range*/
     if ((err_code != NRF_SUCCESS) &&
             (err_code != NRF_ERROR_INVALID_STATE) &&
             (err_code != BLE_ERROR_NO_TX_BUFFERS) &&
@@ -210,9 +258,66 @@ static void alarm_check(void)
             )
     {
         APP_ERROR_HANDLER(err_code);
-    } 
+    }
+}
+
+/**@brief Function for comparing a reading with the levels set by the user.
+*
+* @return      RESET_ALARM, SET_ALARM_LOW or SET_ALARM_HIGH.
+*/
+static uint8_t level_alarm_get(uint8_t alarm_set, uint16_t value, uint16_t low_value, uint16_t high_value)
+{
+    if (alarm_set == 0x00)
+    {
+        return RESET_ALARM;
+    }
+    if (value < low_value)
+    {
+        return SET_ALARM_LOW;
+    }
+    if (value > high_value)
+    {
+        return SET_ALARM_HIGH;
+    }
+    return RESET_ALARM;
+}
+
+
+/**@brief Function for getting the alarm state of the readings taken in broadcast mode.
+*
+* @details The readings are compared with the levels and alarm set flags written over GATT in
+*          connectable mode, the same way the alarm services compare them. The alarm services
+*          themselves are not run in broadcast mode, so their alarm values are left unchanged.
+*
+* @param[in]   p_readings   Manufacturer data of the broadcast packet: thermopile temperature
+*                           (THERMOP_CHAR_SIZE bytes, see TMP006_ObjTemp_encode()) and probe
+*                           temperature (1 byte).
+*
+* @return      Alarm byte, one BROADCAST_ALARM() per reading.
+*/
+uint8_t broadcast_alarm_get(const uint8_t * p_readings)
+{
+    uint8_t alarm = RESET_ALARM;
+    int16_t thermopile_value = TMP006_ObjTemp_decode(p_readings);
+
+    if (m_thermops.thermo_thermopile_alarm_set != 0x00)
+    {
+        if (thermopile_value < m_thermops.thermo_thermopile_low_level)
+        {
+            alarm |= BROADCAST_ALARM(0, SET_ALARM_THERMOP_LOW);
+        }
+        else if (thermopile_value > m_thermops.thermo_thermopile_high_level)
+        {
+            alarm |= BROADCAST_ALARM(0, SET_ALARM_THERMOP_HIGH);
+        }
+    }
+    alarm |= BROADCAST_ALARM(1, level_alarm_get(m_probes.probe_temp_alarm_set,
+                                                p_readings[THERMOP_CHAR_SIZE],
+                                                m_probes.probe_temp_low_level,
+                                                m_probes.probe_temp_high_level));
+    return alarm;
+}
 
-}		
 
 /**@brief Function for performing a thermo parmaters level measurement, and  check for the alarm condition.
 */
@@ -265,6 +370,7 @@ static void real_time_timeout_handler(void * p_context)
     }
 
     // Increment time stamp
+    m_uptime_seconds++;
     m_time_stamp.seconds += 1;
     if (m_time_stamp.seconds > 59)
     {
@@ -328,6 +434,8 @@ static void timers_init(void)
     real_time_timeout_handler);
     APP_ERROR_CHECK(err_code);
 
+    battery_init();                                  /* Timer of the battery sample under radio load*/
+
 } 
 
 
@@ -388,39 +496,50 @@ static void gap_params_init(void)
 static void advertising_init(void)
 {
     uint32_t      err_code;
-    ble_advdata_t advdata,advdata2;
-    uint8_t       flags = BLE_GAP_ADV_FLAGS_LE_ONLY_GENERAL_DISC_MODE;
+    static uint8_t flags = BLE_GAP_ADV_FLAGS_LE_ONLY_GENERAL_DISC_MODE;
     static uint8_t Vendor_Spec_Uuid[16] = {0x49, 0x7B, 0x8E, 0x4D, 0xB6, 0x1E, 0x4F, 0x82, 0x8F, 0xE9, 0xB1, 0x2C, 0xF2, 0x49, 0x73, 0x38};
-    ble_advdata_manuf_data_t   manuf_data;
+    static ble_advdata_manuf_data_t manuf_data;
 
     manuf_data.company_identifier = COMPANY_IDENTIFER; 
     manuf_data.data.size          = 16;
     manuf_data.data.p_data        = Vendor_Spec_Uuid;
 
-    ble_uuid_t adv_uuids[] = 
+    static ble_uuid_t adv_uuids[] = 
     {
         {THERMO_PROFILE_SERVICE_UUID,									BLE_UUID_TYPE_BLE}, 
         {THERMO_PROFILE_PROBES_SERVICE_UUID, 				  BLE_UUID_TYPE_BLE}, 	
     };
 
     // Build and set advertising data
-    memset(&advdata, 0, sizeof(advdata));
-
-    advdata.name_type               = BLE_ADVDATA_FULL_NAME;
-    advdata.include_appearance      = true;
-    advdata.flags.size              = sizeof(flags);
-    advdata.flags.p_data            = &flags;
-    advdata.uuids_complete.uuid_cnt = sizeof(adv_uuids) / sizeof(adv_uuids[0]);
-    advdata.uuids_complete.p_uuids  = adv_uuids;
-
-    memset(&advdata2, 0, sizeof(advdata2));
-
-    advdata2.name_type               = BLE_ADVDATA_NO_NAME;
-    advdata2.include_appearance      = false;
-    advdata2.flags.size              = 0;
-    advdata2.p_manuf_specific_data   = &manuf_data; 
-
-    err_code = ble_advdata_set(&advdata, &advdata2);
+    memset(&m_advdata, 0, sizeof(m_advdata));
+
+    m_advdata.name_type               = BLE_ADVDATA_FULL_NAME;
+    m_advdata.flags.size              = sizeof(flags);
+    m_advdata.flags.p_data            = &flags;
+
+    memset(&m_srdata, 0, sizeof(m_srdata));
+
+    m_srdata.name_type                = BLE_ADVDATA_NO_NAME;
+    m_srdata.include_appearance       = false;
+    m_srdata.flags.size               = 0;
+    m_srdata.p_manuf_specific_data    = &manuf_data;
+
+#if (LIVE_BEACON_ENABLE == FEATURE_ENABLED)
+    // The sensor readings take the place of the appearance and the service UUIDs, which move to the scan response
+    m_beacon_manuf_data.company_identifier = COMPANY_IDENTIFER;
+    m_beacon_manuf_data.data.size          = sizeof(m_beacon_data);
+    m_beacon_manuf_data.data.p_data        = m_beacon_data;
+
+    m_advdata.p_manuf_specific_data   = &m_beacon_manuf_data;
+    m_srdata.uuids_complete.uuid_cnt  = sizeof(adv_uuids) / sizeof(adv_uuids[0]);
+    m_srdata.uuids_complete.p_uuids   = adv_uuids;
+#else
+    m_advdata.include_appearance      = true;
+    m_advdata.uuids_complete.uuid_cnt = sizeof(adv_uuids) / sizeof(adv_uuids[0]);
+    m_advdata.uuids_complete.p_uuids  = adv_uuids;
+#endif
+
+    err_code = ble_advdata_set(&m_advdata, &m_srdata);
     APP_ERROR_CHECK(err_code);
 
     // Initialize advertising parameters (used when starting advertising)
@@ -434,6 +553,23 @@ static void advertising_init(void)
 }
 
 
+#if (LIVE_BEACON_ENABLE == FEATURE_ENABLED)
+/**@brief Function for refreshing the sensor readings carried in the advertising data.
+*/
+static void beacon_update(void)
+{
+    uint32_t err_code;
+
+    // Same layout as the manufacturer data in broadcast mode, thermopile as read on the last alarm check
+    memcpy(m_beacon_data, current_thermopile_temp_store, THERMOP_CHAR_SIZE);
+    m_beacon_data[THERMOP_CHAR_SIZE] = read_probe_temp_level();
+
+    err_code = ble_advdata_set(&m_advdata, &m_srdata);
+    APP_ERROR_CHECK(err_code);
+}
+#endif
+
+
 /**@brief Function for initializing services that will be used by the application.
 *
 * @details Initialize the Temperature alarm and Device Information services.
@@ -501,17 +637,8 @@ static void thermops_init(void)
     thermops_init.p_report_ref         = NULL; 
 
     /* Set the default low value and high value of temperature alarm*/
-    thermops_init.thermo_thermopile_low_level[0]    = THERMOP_DEFAULT_LOW_VALUE;
-    thermops_init.thermo_thermopile_low_level[1]    = THERMOP_DEFAULT_LOW_VALUE;
-    thermops_init.thermo_thermopile_low_level[2]    = PERIOD;
-    thermops_init.thermo_thermopile_low_level[3]    = THERMOP_DEFAULT_LOW_VALUE;
-    thermops_init.thermo_thermopile_low_level[4]    = THERMOP_DEFAULT_LOW_VALUE;
-
-    thermops_init.thermo_thermopile_high_level[0]   = THERMOP_DEFAULT_HIGH_VALUE;
-    thermops_init.thermo_thermopile_high_level[1]   = THERMOP_DEFAULT_HIGH_VALUE;
-    thermops_init.thermo_thermopile_high_level[2]   = PERIOD;
-    thermops_init.thermo_thermopile_high_level[3]   = THERMOP_DEFAULT_HIGH_VALUE;
-    thermops_init.thermo_thermopile_high_level[4]   = THERMOP_DEFAULT_HIGH_VALUE;
+    thermops_init.thermo_thermopile_low_level       = THERMOP_DEFAULT_LOW_LEVEL;
+    thermops_init.thermo_thermopile_high_level      = THERMOP_DEFAULT_HIGH_LEVEL;
     thermops_init.thermo_thermopile_alarm           = RESET_ALARM;                                                        
     thermops_init.thermo_thermopile_alarm_set       = DEFAULT_ALARM_SET;
 
@@ -860,7 +987,12 @@ static void button_event_handler(uint8_t pin_no)
 */
 static void gpiote_init(void)
 {
+    uint32_t err_code;
+
     APP_GPIOTE_INIT(APP_GPIOTE_MAX_USERS);
+
+    err_code = TMP006_MeasureAsyncInit();                 /* Register TMP006 DRDY, uses one application timer*/
+    APP_ERROR_CHECK(err_code);
 }
 
 
@@ -947,6 +1079,8 @@ void radio_active_evt_handler(bool radio_active)
 {
     m_radio_event = radio_active;
     ble_flash_on_radio_active_evt(m_radio_event);                        /*call the event handler in ble_flash.c*/
+    radio_notification_callback(radio_active);      /* Schedule a refresh of the broadcast packet*/
+    battery_on_radio_evt(radio_active);             /* Start the pending battery samples*/
 }
 
 /**@brief Function for initializing the Radio Notification events.
@@ -981,8 +1115,13 @@ static void create_log_data(uint32_t * data)
     data[0]=(m_time_stamp.year<<16)|(m_time_stamp.month<<8)|m_time_stamp.day;				 /*firt word writeen to memory contains date (YYYYMMDD)*/
     data[1]=(m_time_stamp.hours<<16)|(m_time_stamp.minutes<<8)|m_time_stamp.seconds; /*second word contains time 00HHMMSS*/
 
+#if (THERMOP_BINARY_ENABLE == FEATURE_ENABLED)
+    data[2]=current_thermopile_temp_store[0]<<8|current_thermopile_temp_store[1];                                    /*third word contains current thermopile in 0.01 degrees C*/
+    data[3]=current_probe_temp_level;                                                                                 /*fourth word contains current probe temperature level*/
+#else
     data[2]=current_thermopile_temp_store[0]<<24|current_thermopile_temp_store[1]<<16|current_thermopile_temp_store[2]<<8|current_thermopile_temp_store[3];
     data[3]=current_thermopile_temp_store[4]<<24|current_probe_temp_level;                                           /*fourth word contains current thermopile and probe temperature level*/
+#endif
 }
 
 /**@brief Function for checking whether to log data.
@@ -998,11 +1137,14 @@ static void data_log_check()
     }
 }
 
-/**@brief Function for application main entry.
+/**@brief Function for initializing the stack, timers, sensors and services.
+*
+* @details Called once at start-up. Both modes share the SoftDevice, the BLE event dispatch,
+*          Radio Notification, the application timers and the sensor configuration, so
+*          switching modes only swaps the advertising data and parameters.
 */
-void connectable_mode(void)
-{    
-    uint32_t err_code;
+void connectable_mode_init(void)
+{
     // Initialize.
     ble_stack_init();
     twi_master_init();                    /*configure twi*/
@@ -1011,23 +1153,47 @@ void connectable_mode(void)
     buttons_init();
     bond_manager_init();
     gap_params_init();
-    advertising_init();
     services_init();
     conn_params_init();
     sec_params_init();
     radio_notification_init();
+#if (TMP006_FIXED_POINT_BENCHMARK_ENABLE == FEATURE_ENABLED)
+    TMP006_ObjTempBenchmark();             /* Cycles of the object temperature calculation, read from the debugger */
+#endif
     twi_turn_OFF();
+}
+
+
+/**@brief Function for application main entry.
+*
+* @details Expects connectable_mode_init() to have been called. Returns once BROADCAST_MODE is
+*          set and no client is connected, with advertising and the measurement timer stopped.
+*/
+void connectable_mode(void)
+{
+    uint32_t err_code;
+
+    gap_params_init();                    /* Restore the name and advertising data replaced in broadcast mode*/
+    advertising_init();
 
     // Start execution.
     application_timers_start();    
+#if (LIVE_BEACON_ENABLE == FEATURE_ENABLED)
+    beacon_update();
+#endif
     advertising_start();
 
     // Enter main loop.
     for (;;)
     {  
-        if((BROADCAST_MODE) && (!THERMOPS_CONNECTED_STATE) && (!PROBES_CONNECTED_STATE))  /*If the broadcast mode flag is true and services are not connected stop advertising and exit*/
+        if((BROADCAST_MODE) && (!m_tmp006_measuring) && (!THERMOPS_CONNECTED_STATE) && (!PROBES_CONNECTED_STATE))  /*If the broadcast mode flag is true, the TMP006 is idle and services are not connected stop advertising and exit*/
         {
+#if (MODE_SWITCH_BENCHMARK_ENABLE == FEATURE_ENABLED)
+            benchmark_start_prescaled(BENCHMARK_PRESCALER_32US);
+#endif
             sd_ble_gap_adv_stop();			/*stop advertising */
+            err_code = app_timer_stop(thermop_measurement_timer);   /* Only the broadcast refresh samples the sensors*/
+            APP_ERROR_CHECK(err_code);
             break;
         }
 
@@ -1065,10 +1231,23 @@ void connectable_mode(void)
         if (CHECK_ALARM_TIMEOUT)                              /*Check for sensor measurement time-out*/
         {
             alarm_check();                                    /* Checks for alarm in all services*/
-            battery_start();		                              /* Measure battery level*/    
+            if (++m_battery_poll_count >= BATTERY_POLL_COUNT)
+            {
+                m_battery_poll_count = 0;
+                battery_start();                             /* Report the battery level, sample it at the next radio events*/
+            }
             CHECK_ALARM_TIMEOUT=false;                        /* Reset the flag*/
         }
 
+        if (m_tmp006_measure_done)                            /* Thermopile conversion has completed*/
+        {
+            m_tmp006_measure_done = false;
+            thermopile_alarm_check();                         /* Checks for alarm in thermopile service*/
+#if (LIVE_BEACON_ENABLE == FEATURE_ENABLED)
+            beacon_update();                                  /* Refresh the readings in the advertising data*/
+#endif
+        }
+
         power_manage(); 
     }
 }
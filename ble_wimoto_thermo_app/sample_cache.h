@@ -0,0 +1,62 @@
+/** @file
+*
+* @brief Cache of the sensor samples taken in connectable mode.
+*
+* @details The alarm check, the data logger and the live beacon read the same sensors, often within
+*          the same second. A sensor read function keeps its last sample and returns it again while
+*          it is younger than SAMPLE_CACHE_MAX_AGE_SECONDS, instead of starting another conversion.
+*          Age is counted in m_uptime_seconds, so the default of 1 shares the samples of one real
+*          time tick and 0 disables the cache. m_sample_cache_hits counts the conversions saved.
+*/
+
+#ifndef SAMPLE_CACHE_H__
+#define SAMPLE_CACHE_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "nrf.h"
+
+#define SAMPLE_CACHE_MAX_AGE_SECONDS         1                                         /**< Maximum age of a reused sample in seconds, 0 disables the cache. */
+
+/**@brief State of a cached sample. The sample itself is kept by the read function. */
+typedef struct
+{
+    bool     valid;                                                                    /**< A sample has been taken. */
+    uint32_t time;                                                                     /**< m_uptime_seconds when the sample was taken. */
+} sample_cache_t;
+
+extern uint32_t m_uptime_seconds;                                                      /**< Seconds since power on, counted by connect.c. */
+extern volatile uint32_t m_sample_conversions;                                         /**< Sensor conversions done by the read functions. */
+extern volatile uint32_t m_sample_cache_hits;                                          /**< Sensor conversions saved by the cache. */
+
+/**@brief Function for checking whether the cached sample can be reused.
+*
+* @param[in]  p_cache   Cache of the sensor.
+*
+* @return     true if the sample is fresh enough and the caller returns it unchanged.
+*/
+static __INLINE bool sample_cache_fresh(sample_cache_t * p_cache)
+{
+    if (p_cache->valid && ((m_uptime_seconds - p_cache->time) < SAMPLE_CACHE_MAX_AGE_SECONDS))
+    {
+        m_sample_cache_hits++;
+        return true;
+    }
+
+    return false;
+}
+
+/**@brief Function for recording that a new sample has been taken.
+*
+* @param[in]  p_cache   Cache of the sensor.
+*/
+static __INLINE void sample_cache_update(sample_cache_t * p_cache)
+{
+    p_cache->valid = true;
+    p_cache->time  = m_uptime_seconds;
+    m_sample_conversions++;
+}
+
+#endif // SAMPLE_CACHE_H__
+
+/** @} */
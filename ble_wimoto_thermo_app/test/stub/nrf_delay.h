@@ -0,0 +1 @@
+/* Empty on the host, wimoto_sensors.h only needs the declarations of the host build */
@@ -0,0 +1,136 @@
+/** 
+*@file     Host test of TMP006_ObjTempCentiC_calculate().
+*
+*Sweeps the die temperature and V-object range and compares the fixed-point result with the
+*equations of section 5.1 in the TMP006 user guide evaluated in double precision. Fails if the
+*error at any point exceeds the bound derived on the function from the quantisation of each stage.
+*/
+
+#include <stdio.h>
+#include <math.h>
+#include "wimoto_sensors.h"
+
+#define DIE_STEP        1                 /**< Every die temperature code from -40 to 125 C */
+#define VOBJ_STEP       7                 /**< Every 7th V-object code */
+#define VOBJ_LSB        156.25e-9         /**< V-object LSB in V */
+#define U_K4            (256.0 / (160.0 * 160.0 * 160.0 * 160.0))  /**< Unit of Tdie^4 and Tobj^4 in the calculation, 2^8 (1/160 K)^4 */
+
+/* Temperature bands of the report, by object temperature in C */
+static const double m_bands[] = {-40.0, -150.0, -200.0, -250.0, -274.0};
+
+#define BAND_COUNT      (sizeof(m_bands) / sizeof(m_bands[0]))
+
+/* Same equations as the float calculation the driver used before, in double precision */
+static int reference_c(int16_t raw_die, int16_t raw_vobj, double * p_tobj, double * p_s, double * p_vx)
+{
+    double Tdie = raw_die * 0.03125 + 273.15;
+    double Vobj = raw_vobj * VOBJ_LSB;
+    double tdie_tref = Tdie - TMP006_TREF;
+    double s   = 1 + (TMP006_A1 * tdie_tref) + (TMP006_A2 * tdie_tref * tdie_tref);
+    double S   = s * TMP006_S0 * 1e-14;
+    double Vos = TMP006_B0 + (TMP006_B1 * tdie_tref) + (TMP006_B2 * tdie_tref * tdie_tref);
+    double fVobj = (Vobj - Vos) + (TMP006_C2 * (Vobj - Vos) * (Vobj - Vos));
+    double obj4 = (Tdie * Tdie * Tdie * Tdie) + (fVobj / S);
+
+    *p_s  = s;
+    *p_vx = fabs(Vobj - Vos) / VOBJ_LSB;
+    if (obj4 <= 0)
+    {
+        return 0;
+    }
+    *p_tobj = sqrt(sqrt(obj4)) - 273.15;
+    return 1;
+}
+
+/* Error bound in C of TMP006_ObjTempCentiC_calculate(), derived from the quantisation of each stage as
+   documented on the function. tobj_k is the reference object temperature, 0 where it has none */
+static double error_bound_c(int16_t raw_die, double s, double vx_lsb, double tobj_k)
+{
+    double tdie_k = raw_die * 0.03125 + 273.15;
+    double tq     = fabs((double)raw_die - TMP006_TREF_RAW);
+    double tq2    = tq * tq;
+    double d_a1   = fabs(TMP006_A1_Q32 - TMP006_A1 / 32 * 4294967296.0);
+    double d_a2   = fabs(TMP006_A2_Q44 - TMP006_A2 / 1024 * 17592186044416.0);
+    double d_b0   = fabs(TMP006_B0_Q16 - TMP006_B0 / VOBJ_LSB * 65536.0);
+    double d_b1   = fabs(TMP006_B1_Q16 - TMP006_B1 / VOBJ_LSB / 32 * 65536.0);
+    double d_b2   = fabs(TMP006_B2_Q32 - TMP006_B2 / VOBJ_LSB / 1024 * 4294967296.0);
+    double d_c2   = fabs(TMP006_C2_Q40 - TMP006_C2 * VOBJ_LSB * 1099511627776.0);
+    double c2_q16 = TMP006_C2 * VOBJ_LSB * vx_lsb * vx_lsb * 65536.0;          /* C2 term of f in Q16 */
+    double rel_s, err_vos, err_f, d4, t4, t1, t2;
+
+    /* 1.Constants rounded to integers, and the truncating shifts of the S / S0 and Vos terms */
+    rel_s   = (d_a1 * tq / 16 + d_a2 * tq2 / 65536 + 2) / (s * 268435456.0);
+    err_vos = d_b0 + d_b1 * tq + d_b2 * tq2 / 65536 + 1;
+
+    /* 2.f(Vobj - Vos): the Vos error with the slope of f, the C2 constant and two truncations, in Q16 */
+    err_f   = err_vos * (1 + 2 * TMP006_C2 * VOBJ_LSB * vx_lsb) + c2_q16 * d_c2 / TMP006_C2_Q40 +
+              TMP006_C2_Q40 / 4294967296.0 + 1;
+
+    /* 3.Tobj^4: relative error of S and of the division, the error of f over S, two truncations */
+    rel_s  += s * 268435456.0 / (double)TMP006_S_DIVIDEND;
+    t4      = tobj_k * tobj_k * tobj_k * tobj_k;
+    d4      = rel_s * fabs(t4 - tdie_k * tdie_k * tdie_k * tdie_k) +
+              err_f / 65536.0 * VOBJ_LSB / (s * TMP006_S0 * 1e-14) + 2 * U_K4;
+
+    /* 4.Fourth root of the lowered Tobj^4, the two floored square roots and the rounding to 0.01 C */
+    t1 = sqrt(sqrt((t4 > d4) ? (t4 - d4) : 0));
+    t2 = t1 * t1 - sqrt(U_K4);
+    t2 = (t2 > 0) ? sqrt(t2) : 0;
+
+    return (tobj_k - t2) + ((t4 > 0) ? 0 : sqrt(sqrt(d4))) + 1 / 2560.0 + 0.005;
+}
+
+int main(void)
+{
+    double   max_error[BAND_COUNT] = {0};
+    double   max_bound[BAND_COUNT] = {0};
+    unsigned failures = 0;
+    unsigned i;
+    int32_t  raw_die, raw_vobj;
+
+    for (raw_die = TMP006_DIE_RAW_MIN; raw_die <= TMP006_DIE_RAW_MAX; raw_die += DIE_STEP)
+    {
+        for (raw_vobj = -32768; raw_vobj <= 32767; raw_vobj += VOBJ_STEP)
+        {
+            double  tobj_ref, s, vx_lsb, bound;
+            int16_t tobj = TMP006_ObjTempCentiC_calculate((int16_t)raw_die, (int16_t)raw_vobj);
+            double  error;
+
+            if (!reference_c((int16_t)raw_die, (int16_t)raw_vobj, &tobj_ref, &s, &vx_lsb))
+            {
+                bound = error_bound_c((int16_t)raw_die, s, vx_lsb, 0);
+                if (tobj / 100.0 > -273.15 + bound)
+                {
+                    printf("die %ld vobj %ld: no real temperature, got %d\n", (long)raw_die, (long)raw_vobj, tobj);
+                    failures++;
+                }
+                continue;
+            }
+
+            error = fabs(tobj / 100.0 - tobj_ref);
+            bound = error_bound_c((int16_t)raw_die, s, vx_lsb, tobj_ref + 273.15);
+            if (error > bound)
+            {
+                printf("die %ld vobj %ld: error %.4f C above the bound %.4f C\n", (long)raw_die, (long)raw_vobj, error, bound);
+                failures++;
+            }
+
+            for (i = 0; i < BAND_COUNT; i++)
+            {
+                if (tobj_ref > m_bands[i])
+                {
+                    max_error[i] = (error > max_error[i]) ? error : max_error[i];
+                    max_bound[i] = (bound > max_bound[i]) ? bound : max_bound[i];
+                }
+            }
+        }
+    }
+
+    for (i = 0; i < BAND_COUNT; i++)
+    {
+        printf("above %7.1f C: max error %.4f C (derived bound up to %.4f C)\n", m_bands[i], max_error[i], max_bound[i]);
+    }
+
+    printf("%s\n", (failures == 0) ? "PASS" : "FAIL");
+    return (failures == 0) ? 0 : 1;
+}
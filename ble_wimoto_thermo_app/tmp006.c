@@ -6,6 +6,24 @@
 */
 
 #include "wimoto_sensors.h"
+#include "wimoto.h"
+#include "app_timer.h"
+#include "app_gpiote.h"
+#include "nrf_error.h"
+#include <string.h>
+#if (TMP006_FIXED_POINT_BENCHMARK_ENABLE == FEATURE_ENABLED)
+#include "benchmark.h"
+#endif
+
+/********************************************************************************************/
+/* PRIVATE VARIABLES																		*/
+/********************************************************************************************/
+static int16_t m_tmp006_obj_temp = 0;                                 /**< Object temperature in 0.01 C of the last successful read, returned when a read fails */
+
+#if (TMP006_FIXED_POINT_BENCHMARK_ENABLE == FEATURE_ENABLED)
+volatile uint32_t m_bench_tmp006_float_cycles = 0;                    /**< Cycles of the float calculation of one object temperature. */
+volatile uint32_t m_bench_tmp006_fixed_cycles = 0;                    /**< Cycles of the fixed-point calculation of one object temperature. */
+#endif
 
 /********************************************************************************************/
 /* PRIVATE FUNCTIONS																		*/
@@ -190,24 +208,20 @@ int16_t readRawVoltage()
     return raw;
 }
 
-// Calculate object temperature based on raw sensor temp and thermopile voltage
-float TMP006_ObjTempC_conversion() 
+#if (TMP006_FIXED_POINT_BENCHMARK_ENABLE == FEATURE_ENABLED)
+/**
+*@brief   Float calculation the driver used before the fixed-point one, kept as the benchmark reference
+*@details Equations for calculating temperature found in section 5.1 in the user guide
+*/
+static float TMP006_ObjTempC_calculate_float(int16_t raw_die, int16_t raw_vobj)
 {
-    static float previous_val = 0;
-    if (false == TMP006_enable_continuous_conversion()) 
-    {	
-        return previous_val;
-    }
-    nrf_delay_ms(1100);
-
-    volatile float Tdie = readRawDieTemperature();
-    volatile float Vobj = readRawVoltage();
+    volatile float Tdie = raw_die;
+    volatile float Vobj = raw_vobj;
     Vobj *= 156.25; // 156.25 nV per LSB
     Vobj /= 1000000000; // nV -> V
     Tdie *= 0.03125; // convert to celsius
     Tdie += 273.15; // convert to kelvin
 
-    // Equations for calculating temperature found in section 5.1 in the user guide
     volatile float tdie_tref = Tdie - TMP006_TREF;
     volatile float S = (1 + (TMP006_A1*tdie_tref) + (TMP006_A2*tdie_tref*tdie_tref));
     S *= TMP006_S0;
@@ -222,12 +236,27 @@ float TMP006_ObjTempC_conversion()
 
     Tobj -= 273.15; // Kelvin -> *C
 
+    return Tobj;
+}
+#endif
+
+// Calculate object temperature in 0.01 C based on raw sensor temp and thermopile voltage, waiting for the conversion
+int16_t TMP006_ObjTempCentiC_conversion() 
+{
+    if (false == TMP006_enable_continuous_conversion()) 
+    {	
+        return m_tmp006_obj_temp;
+    }
+    nrf_delay_ms(TMP006_CONVERSION_TIME_MS + TMP006_CONVERSION_MARGIN_MS);
+
+    int16_t Tobj = TMP006_ObjTempCentiC_calculate(readRawDieTemperature(), readRawVoltage());
+
     if (false == TMP006_enable_powerdown_mode())
     {	
-        return previous_val;
+        return m_tmp006_obj_temp;
     }
 
-    previous_val= Tobj;
+    m_tmp006_obj_temp = Tobj;
 
     return Tobj;
 
@@ -240,6 +269,173 @@ float TMP006_readDieTempC(void)
     Tdie *= 0.03125; // convert to Celsius
     return Tdie;
 }
+
+/********************************************************************************************/
+/* ASYNCHRONOUS MEASUREMENT																	*/
+/********************************************************************************************/
+static app_gpiote_user_id_t     m_tmp006_drdy_gpiote;                 /**< GPIOTE user of the DRDY pin */
+static app_timer_id_t           m_tmp006_timer_id;                    /**< Timer giving up a measurement if DRDY is not asserted */
+static tmp006_measure_handler_t m_tmp006_handler = NULL;              /**< Handler of the measurement in progress, NULL when idle */
+
+/**
+*@brief   Function to end the measurement in progress
+*@details Reads the result if DRDY was asserted, switches TMP006 back to power down mode, which also
+*           releases DRDY, and passes the object temperature, or the last one if the read failed, to the
+*           handler. The TWI is only powered for the transfers. The driver is idle again before the handler
+*           is called, so the handler can start the next measurement
+*/
+static void TMP006_MeasureComplete(bool data_ready)
+{
+    tmp006_measure_handler_t handler = m_tmp006_handler;
+
+    m_tmp006_handler = NULL;
+
+    twi_turn_ON();
+    if (data_ready)
+    {
+        m_tmp006_obj_temp = TMP006_ObjTempCentiC_calculate(readRawDieTemperature(), readRawVoltage());
+    }
+    (void)TMP006_enable_powerdown_mode();
+    twi_turn_OFF();
+
+    handler(m_tmp006_obj_temp);
+}
+
+/**
+*@brief   GPIOTE handler of the DRDY pin
+*@details Runs in the GPIOTE interrupt when TMP006 pulls DRDY low at the end of the averaged conversion
+*/
+static void TMP006_DrdyHandler(uint32_t event_pins_low_to_high, uint32_t event_pins_high_to_low)
+{
+    if ((m_tmp006_handler == NULL) || ((event_pins_high_to_low & TMP006_DRDY_PINS_HIGH_TO_LOW_MASK) == 0))
+    {
+        return;
+    }
+
+    (void)app_gpiote_user_disable(m_tmp006_drdy_gpiote);
+    (void)app_timer_stop(m_tmp006_timer_id);
+    TMP006_MeasureComplete(true);
+}
+
+/**
+*@brief   Timeout handler of a measurement started with TMP006_MeasureAsync()
+*@details Ends the measurement without reading if DRDY was not asserted within TMP006_DRDY_TIMEOUT_MS.
+*           DRDY is disabled first, so it cannot end the same measurement a second time
+*/
+static void TMP006_MeasureTimeoutHandler(void * p_context)
+{
+    (void)p_context;
+    (void)app_gpiote_user_disable(m_tmp006_drdy_gpiote);
+
+    if (m_tmp006_handler != NULL)
+    {
+        TMP006_MeasureComplete(false);
+    }
+}
+
+/**
+*@brief   Function to prepare asynchronous measurements
+*@details Configures the DRDY pin and registers it with the GPIOTE handler, and creates the timeout timer.
+*           Must be called after APP_GPIOTE_INIT() and APP_TIMER_INIT()
+*/
+uint32_t TMP006_MeasureAsyncInit(void)
+{
+    uint32_t err_code;
+
+    nrf_gpio_cfg_input(TMP006_DRDY_GPIOTE_PIN, NRF_GPIO_PIN_PULLUP);   /* DRDY is open drain */
+
+    err_code = app_gpiote_user_register(&m_tmp006_drdy_gpiote,
+                                        0,
+                                        TMP006_DRDY_PINS_HIGH_TO_LOW_MASK,
+                                        TMP006_DrdyHandler);
+    if (err_code != NRF_SUCCESS)
+    {
+        return err_code;
+    }
+
+    return app_timer_create(&m_tmp006_timer_id, APP_TIMER_MODE_SINGLE_SHOT, TMP006_MeasureTimeoutHandler);
+}
+
+/**
+*@brief   Function to start an object temperature measurement without waiting for it
+*@details Enables continuous conversion with the DRDY pin and returns. The handler is called from the
+*           GPIOTE interrupt once the averaged conversion is ready, after TMP006_CONVERSION_TIME_MS, while
+*           the CPU sleeps. The TWI is powered by the driver for the transfers only.
+*           Returns NRF_ERROR_BUSY if a measurement is in progress and NRF_ERROR_INTERNAL if TMP006
+*           does not respond
+*/
+uint32_t TMP006_MeasureAsync(tmp006_measure_handler_t handler)
+{
+    uint32_t err_code;
+    bool     started;
+
+    if (m_tmp006_handler != NULL)
+    {
+        return NRF_ERROR_BUSY;
+    }
+
+    twi_turn_ON();
+    started = TMP006_enable_continuous_conversion();
+    twi_turn_OFF();
+    if (!started)
+    {
+        return NRF_ERROR_INTERNAL;
+    }
+
+    m_tmp006_handler = handler;
+
+    err_code = app_timer_start(m_tmp006_timer_id,
+                               APP_TIMER_TICKS(TMP006_DRDY_TIMEOUT_MS, TMP006_APP_TIMER_PRESCALER),
+                               NULL);
+    if (err_code == NRF_SUCCESS)
+    {
+        err_code = app_gpiote_user_enable(m_tmp006_drdy_gpiote);
+    }
+
+    if (err_code != NRF_SUCCESS)
+    {
+        m_tmp006_handler = NULL;
+        (void)app_timer_stop(m_tmp006_timer_id);
+        twi_turn_ON();
+        (void)TMP006_enable_powerdown_mode();
+        twi_turn_OFF();
+    }
+
+    return err_code;
+}
+
+/**
+*@brief   Function to get the object temperature in 0.01 C of the last successful measurement
+*/
+int16_t TMP006_ObjTempCentiC_last(void)
+{
+    return m_tmp006_obj_temp;
+}
+
+#if (TMP006_FIXED_POINT_BENCHMARK_ENABLE == FEATURE_ENABLED)
+/**
+*@brief   Function to measure the cycles of one object temperature calculation
+*@details Calculates 25 C die temperature and a V-object of -200 LSB (about 21 C) with the float reference
+*           and with TMP006_ObjTempCentiC_calculate(), and leaves the cycles in m_bench_tmp006_float_cycles
+*           and m_bench_tmp006_fixed_cycles for reading with the debugger. Uses TIMER1, see benchmark.h
+*/
+void TMP006_ObjTempBenchmark(void)
+{
+    volatile float   obj_float;
+    volatile int16_t obj_fixed;
+
+    benchmark_start();
+    obj_float = TMP006_ObjTempC_calculate_float(TMP006_TREF_RAW, -200);
+    m_bench_tmp006_float_cycles = benchmark_stop();
+
+    benchmark_start();
+    obj_fixed = TMP006_ObjTempCentiC_calculate(TMP006_TREF_RAW, -200);
+    m_bench_tmp006_fixed_cycles = benchmark_stop();
+
+    (void)obj_float;
+    (void)obj_fixed;
+}
+#endif
 /*-----------------------------------------------------------------------------
 *  Function:	convert
 *  Brief:		converting int value to char
@@ -398,15 +594,6 @@ void float_to_str(double source , char *dest)
 }
 
 
-void do_thermopile_measurement(uint8_t *temp_str, float *fTemp)
-{
-    static float obj_temp;
-    obj_temp=TMP006_ObjTempC_conversion();
-    *fTemp = obj_temp;
-    float_to_str(obj_temp,(char *)temp_str);
-    return;
-}
-
 /*-----------------------------------------------------------------------------
 *  Function:	stof
 *  Brief:		converting character value to float
@@ -435,3 +622,48 @@ float stof(char* s)
 }
 
 
+/**
+*@brief   Function to encode an object temperature for the thermopile characteristics and broadcast data
+*@details With THERMOP_BINARY_ENABLE the value is sent as int16 in 0.01 C, MSB first. Without it, it is
+*           formatted as the 5 ASCII characters of the original firmware, for clients not yet updated
+*/
+void TMP006_ObjTemp_encode(int16_t obj_temp, uint8_t * p_encoded)
+{
+#if (THERMOP_BINARY_ENABLE == FEATURE_ENABLED)
+    p_encoded[0] = (uint8_t)((uint16_t)obj_temp >> 8);
+    p_encoded[1] = (uint8_t)((uint16_t)obj_temp & LOWER_BYTE_MASK);
+#else
+    char obj_temp_str[10] = {0};                                      /* float_to_str() output is NUL terminated and may be longer than the field */
+
+    float_to_str((double)obj_temp / 100, obj_temp_str);
+    memcpy(p_encoded, obj_temp_str, THERMOP_CHAR_SIZE);
+#endif
+}
+
+/**
+*@brief   Function to decode a thermopile characteristic value to an object temperature in 0.01 C
+*@details Called when a client writes a level, so the alarm checks only compare integers
+*/
+int16_t TMP006_ObjTemp_decode(const uint8_t * p_encoded)
+{
+#if (THERMOP_BINARY_ENABLE == FEATURE_ENABLED)
+    return (int16_t)(((uint16_t)p_encoded[0] << 8) | p_encoded[1]);
+#else
+    char  obj_temp_str[THERMOP_CHAR_SIZE + 1];
+    float obj_temp;
+
+    memcpy(obj_temp_str, p_encoded, THERMOP_CHAR_SIZE);
+    obj_temp_str[THERMOP_CHAR_SIZE] = '\0';
+    obj_temp = stof(obj_temp_str) * 100.0f;
+
+    if (obj_temp >= 32767.0f)
+    {
+        return INT16_MAX;
+    }
+    if (obj_temp <= -32768.0f)
+    {
+        return INT16_MIN;
+    }
+    return (int16_t)((obj_temp < 0) ? (obj_temp - 0.5f) : (obj_temp + 0.5f));
+#endif
+}
@@ -0,0 +1,114 @@
+/** 
+*@file     This file contains the fixed-point object temperature calculation of the TMP006 driver.
+*
+*The calculation has no hardware dependencies, so test/ builds it on a host and sweeps it against
+*the same equations in double precision.
+*/
+
+#include "wimoto_sensors.h"
+
+/**
+*@brief   Function to compute the integer square root
+*@details Bit by bit, with shifts and subtractions only. Returns the square root rounded down
+*/
+static uint32_t TMP006_isqrt(uint64_t value)
+{
+    uint64_t root = 0;
+    uint64_t bit  = (uint64_t)1 << 62;
+
+    while (bit > value)
+    {
+        bit >>= 2;
+    }
+
+    while (bit != 0)
+    {
+        if (value >= root + bit)
+        {
+            value -= root + bit;
+            root   = (root >> 1) + bit;
+        }
+        else
+        {
+            root >>= 1;
+        }
+        bit >>= 2;
+    }
+
+    return (uint32_t)root;
+}
+
+/**
+*@brief   Function to calculate the object temperature from raw readings with fixed-point arithmetic
+*@details Same equations as section 5.1 in the user guide, Tobj = (Tdie^4 + f(Vobj - Vos) / S)^(1/4), without
+*           floats or libm. With tq = Tdie - TREF in raw units of 1/32 C:
+*             1.S / S0 is evaluated in Q28 and Vos in Q16 of the V-object LSB, with 64 bit products
+*             2.f(Vobj - Vos) / S is scaled with one 64 bit division to units of 2^8 (1/160 K)^4, the unit of
+*               Tdie^4, which is exact because 273.15 K is 43704 / 160 K
+*             3.Two integer square roots give Tobj in 1/2560 K, which is rounded to 0.01 C
+*         The die temperature is clamped to the specified -40 to 125 C, which keeps every intermediate within
+*           64 bits over the whole V-object range. The result is at most 303.68 C.
+*         Error against the same equations in double precision, from the quantisation of each stage:
+*             1.The Q constants are the exact coefficients rounded to integers, off by dA1 0.024, dA2 0.205, dB0 0.24,
+*               dB1 0.104, dB2 0.384 and dC2 0.471 of their last bit, and every right shift truncates by below 1.
+*               So S / S0 is off by at most dA1 * |tq| / 16 + dA2 * tq^2 / 2^16 + 2 in Q28 and Vos by at most
+*               dB0 + dB1 * |tq| + dB2 * tq^2 / 2^16 + 1 in Q16, 394 or 0.006 of an LSB at the die limits
+*             2.f(Vobj - Vos) carries the Vos error times its slope 1 + 2 * C2 * (Vobj - Vos), plus dC2 / C2_Q40 of the
+*               C2 term and 2 for its two shifts
+*             3.Tobj^4 is off by the relative error of S / S0 and of the division, at most s_q28 / S_DIVIDEND, times
+*               |Tobj^4 - Tdie^4|, plus the f error divided by S, plus one unit for each of the two shifts
+*             4.A Tobj^4 error d4 moves Tobj by at most Tobj - (Tobj^4 - d4)^(1/4). The first square root floors by
+*               below 1/1600 K^2, the second by below 1/2560 K, and the rounding to 0.01 C adds 0.005 C
+*         test/tmp006_calc_test.c evaluates that bound at every die temperature and every 7th V-object code and fails
+*           if the result exceeds it anywhere. The bound stays within 0.006 C for object temperatures above -40 C and
+*           0.008 C above -150 C, mostly the rounding to 0.01 C, within 0.018 C above -200 C and 0.32 C above -250 C.
+*           Towards absolute zero the fourth root amplifies the Tobj^4 error, up to 4.1 C. Where the inputs give no
+*           real temperature the result is within d4^(1/4) of 0 K. The float calculation it replaces is within
+*           0.0001 C of double precision above -40 C and 0.01 C below.
+*         Returns -27315 (0 K) if the inputs give no real temperature
+*/
+int16_t TMP006_ObjTempCentiC_calculate(int16_t raw_die, int16_t raw_vobj)
+{
+    int32_t  tq;
+    int64_t  tq2, s_q28, vos_q16, vx_q16, fv_q16, dividend_q;
+    int64_t  obj4;
+    uint32_t tdie_160, tdie2, tobj2, tobj_2560;
+    int32_t  tobj;
+
+    if (raw_die < TMP006_DIE_RAW_MIN)
+    {
+        raw_die = TMP006_DIE_RAW_MIN;
+    }
+    else if (raw_die > TMP006_DIE_RAW_MAX)
+    {
+        raw_die = TMP006_DIE_RAW_MAX;
+    }
+
+    tq  = (int32_t)raw_die - TMP006_TREF_RAW;
+    tq2 = (int64_t)tq * tq;
+
+    s_q28   = ((int64_t)1 << 28) + (((int64_t)TMP006_A1_Q32 * tq) >> 4) + ((TMP006_A2_Q44 * tq2) >> 16);
+    vos_q16 = TMP006_B0_Q16 + ((int64_t)TMP006_B1_Q16 * tq) + ((TMP006_B2_Q32 * tq2) >> 16);
+
+    vx_q16  = ((int64_t)raw_vobj << 16) - vos_q16;
+    fv_q16  = vx_q16 + ((((vx_q16 * vx_q16) >> 24) * TMP006_C2_Q40) >> 32);
+
+    dividend_q = (int64_t)(TMP006_S_DIVIDEND / (uint64_t)s_q28);
+
+    tdie_160 = (uint32_t)((int32_t)raw_die * 5 + TMP006_ZERO_C_160);
+    tdie2    = tdie_160 * tdie_160;
+    obj4     = (int64_t)(((uint64_t)tdie2 * tdie2) >> 8) + ((fv_q16 * dividend_q) >> 5);
+
+    if (obj4 <= 0)
+    {
+        return -27315;
+    }
+
+    tobj2     = TMP006_isqrt((uint64_t)obj4);                 /* Tobj^2 in 1/2560^2 K^2 * 2^12 */
+    tobj_2560 = TMP006_isqrt((uint64_t)tobj2 << 12);         /* Tobj in 1/2560 K */
+
+    tobj = ((int32_t)tobj_2560 - TMP006_ZERO_C_2560) * 100;
+    tobj = (tobj + ((tobj < 0) ? -1280 : 1280)) / 2560;       /* Round to 0.01 C */
+
+    return (int16_t)tobj;
+}
@@ -0,0 +1,59 @@
+/** @file
+*
+* @brief Cycle counter used for on-target benchmarks.
+*
+* @details The nRF51 has no SysTick or DWT cycle counter, so TIMER1 is run from the 16 MHz
+*          clock without prescaling and one timer tick equals one CPU cycle. TIMER1 is a 16 bit
+*          timer, so a single measurement must stay below 65535 cycles (~4 ms). Longer operations
+*          are measured with a prescaled clock, see benchmark_start_prescaled().
+*          TIMER1 is not used by the SoftDevice or by the application while benchmarking.
+*/
+
+#ifndef BENCHMARK_H__
+#define BENCHMARK_H__
+
+#include <stdint.h>
+#include "nrf.h"
+#include "nrf51_bitfields.h"
+
+#define BENCHMARK_TIMER                      NRF_TIMER1                                /**< Timer used to count CPU cycles. */
+#define BENCHMARK_PRESCALER_CYCLES           0                                         /**< 16 MHz, one tick per CPU cycle, measurements up to ~4 ms. */
+#define BENCHMARK_PRESCALER_32US             9                                         /**< 31.25 kHz, one tick per 32 us, measurements up to ~2 s. */
+
+/**@brief Function for starting a measurement with a given timer resolution.
+*
+* @param[in]  prescaler   Value of the TIMER1 PRESCALER register, one of BENCHMARK_PRESCALER_*.
+*/
+static __INLINE void benchmark_start_prescaled(uint8_t prescaler)
+{
+    BENCHMARK_TIMER->TASKS_STOP  = 1;
+    BENCHMARK_TIMER->MODE        = TIMER_MODE_MODE_Timer;
+    BENCHMARK_TIMER->BITMODE     = TIMER_BITMODE_BITMODE_16Bit << TIMER_BITMODE_BITMODE_Pos;
+    BENCHMARK_TIMER->PRESCALER   = prescaler;
+    BENCHMARK_TIMER->TASKS_CLEAR = 1;
+    BENCHMARK_TIMER->TASKS_START = 1;
+}
+
+/**@brief Function for starting a cycle count measurement.
+*/
+static __INLINE void benchmark_start(void)
+{
+    benchmark_start_prescaled(BENCHMARK_PRESCALER_CYCLES);
+}
+
+/**@brief Function for ending a cycle count measurement.
+*
+* @return     Number of timer ticks since benchmark_start() (CPU cycles) or
+*             benchmark_start_prescaled().
+*/
+static __INLINE uint32_t benchmark_stop(void)
+{
+    BENCHMARK_TIMER->TASKS_CAPTURE[0] = 1;
+    BENCHMARK_TIMER->TASKS_STOP       = 1;
+
+    return BENCHMARK_TIMER->CC[0];
+}
+
+#endif // BENCHMARK_H__
+
+/** @} */
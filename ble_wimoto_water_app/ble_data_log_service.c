@@ -35,6 +35,7 @@ uint32_t 				write_pg;                     /*flash page number to which data is
 
 static uint32_t *write_addr;                  /*write_address of the word to which data is being written*/
 static uint32_t pg_end;           						/*last page in the buffer*/ 
+static unsigned char write_cycle = 0;              /* 0x01 once the cyclic buffer has been written fully*/
 
 bool     	      DLOGS_CONNECTED_STATE=false;  /*Indicates whether the data logger service is connected or not*/
 
@@ -533,7 +534,6 @@ void write_data_flash(uint32_t *data)
     static uint32_t i=0;
     static uint32_t pg_size;          /*size of a page*/
     static bool first_write=true;     /*flag indicates whether a write is done for the first time in the flash*/
-    static unsigned char write_cycle=0;
 
     if(first_write)																	/*for the first write cycle set the start address and erase the page*/
     {
@@ -603,6 +603,29 @@ void write_data_flash(uint32_t *data)
     }	
 }
 
+/**@brief Function for getting how much of the cyclic buffer holds logged data.
+*
+* @return      Fill level in percent, 100 once the buffer has wrapped around and the oldest
+*              data is being overwritten.
+*/
+uint8_t data_log_fill_level(void)
+{
+    uint32_t page_size = NRF_FICR->CODEPAGESIZE;
+    uint32_t used;
+
+    if (write_addr == NULL)                           /* nothing logged since power on*/
+    {
+        return 0;
+    }
+    if (write_cycle != 0x00)
+    {
+        return 100;
+    }
+
+    used = (uint32_t)write_addr - (page_size * DATA_LOGGER_BUFFER_START_PAGE);
+    return (uint8_t)((used * 100) / (page_size * (DATA_LOGGER_BUFFER_END_PAGE - DATA_LOGGER_BUFFER_START_PAGE + 1)));
+}
+
 /**@brief Function to send data to the connected BLE central device.
 *
 * @param[in]   ble_dlogs        Data logger service structure.
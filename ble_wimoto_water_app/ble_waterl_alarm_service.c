@@ -21,6 +21,7 @@
 #include "app_util.h"
 #include "wimoto.h"
 #include "wimoto_sensors.h"
+#include "sample_cache.h"
 
 bool            WATERLS_CONNECTED_STATE=false;      /*This flag indicates whether a client is connected to the peripheral in water level service*/
 extern bool 	  BROADCAST_MODE;
@@ -779,13 +780,17 @@ uint32_t ble_waterls_level_alarm_check(ble_waterls_t * p_waterls)
 */
 uint8_t read_waterl_level()   
 {
-    static uint8_t current_waterl_level = 0x00; 
+    static uint8_t current_waterl_level = 0x00;
+    static sample_cache_t waterl_cache;
 
-    // Initialize ADC for interfacing the water level sensor
-    adc_init();		
+    if (sample_cache_fresh(&waterl_cache))
+    {
+        return current_waterl_level;                /* Reuse the sample of this tick*/
+    }
 
     // Read water level level from ADC 
     current_waterl_level = do_waterl_adc_measurement(); 
+    sample_cache_update(&waterl_cache);
 
     return current_waterl_level;
 }	
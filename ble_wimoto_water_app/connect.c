@@ -47,6 +47,7 @@
 #include "wimoto.h"
 #include "ble_device_mgmt_service.h"
 #include "battery.h"
+#include "benchmark.h"
 
 #define SEND_MEAS_BUTTON_PIN_NO              16                                         /**< Button used for sending a measurement. */
 #define BONDMNGR_DELETE_BUTTON_PIN_NO        17                                         /**< Button used for deleting all bonded masters during startup. */
@@ -59,9 +60,11 @@
 
 #define APP_ADV_INTERVAL                     0x81A                                      /**< The advertising interval (in units of 0.625 ms. This value corresponds to 25 ms). */
 #define APP_ADV_TIMEOUT_IN_SECONDS           0x0000                                     /**< The advertising timeout in units of seconds. */
+#define LIVE_BEACON_ENABLE                   0x01                                       /**< 0x00 - Disabled 0x01 - Enabled, connectable advertising also carries the live sensor readings */
+#define BEACON_DATA_LEN                      2                                          /**< Length of the sensor readings carried in the advertising data. */
 
 #define APP_TIMER_PRESCALER                  0                                          /**< Value of the RTC1 PRESCALER register. */
-#define APP_TIMER_MAX_TIMERS                 5                                          /**< Maximum number of simultaneously created timers. */
+#define APP_TIMER_MAX_TIMERS                 6                                          /**< Maximum number of simultaneously created timers. */
 #define APP_TIMER_OP_QUEUE_SIZE              4                                          /**< Size of timer operation queues. */
 
 #define WATER_LEVEL_MEAS_INTERVAL            APP_TIMER_TICKS(60000, APP_TIMER_PRESCALER) /**< water level measurement interval (ticks). */
@@ -100,6 +103,12 @@
 static uint16_t                              m_conn_handle = BLE_CONN_HANDLE_INVALID;   /**< Handle of the current connection. */
 static ble_gap_sec_params_t                  m_sec_params;                              /**< Security requirements for this application. */
 static ble_gap_adv_params_t                  m_adv_params;                              /**< Parameters to be passed to the stack when starting advertising. */
+static ble_advdata_t                         m_advdata;                                 /**< Advertising data, kept so that it can be re-encoded with new readings. */
+static ble_advdata_t                         m_srdata;                                  /**< Scan response data. */
+#if (LIVE_BEACON_ENABLE == FEATURE_ENABLED)
+static ble_advdata_manuf_data_t              m_beacon_manuf_data;                       /**< Manufacturer data carrying the live sensor readings. */
+static uint8_t                               m_beacon_data[BEACON_DATA_LEN];            /**< Live sensor readings. */
+#endif
 static ble_waterps_t                         m_waterps;                                 /**< Structure used to identify the water presence service. */
 static ble_waterls_t                         m_waterls;                                 /**< Structure used to identify the water level alarm service. */
 static ble_dlogs_t                           m_dlogs;																	  /**< Structure used to identify the data logger service. */
@@ -110,6 +119,9 @@ static app_timer_id_t                        real_time_timer;
 
 app_gpiote_user_id_t 								         waterp_measurement_gpiote;                 /**< water presence measurement gpiote. */
 ble_date_time_t                              m_time_stamp;                              /**< Time stamp. */
+uint32_t                                     m_uptime_seconds = 0;                      /**< Seconds since power on, counted in both modes. */
+volatile uint32_t                            m_sample_conversions = 0;                  /**< Sensor conversions done by the read functions, see sample_cache.h. */
+volatile uint32_t                            m_sample_cache_hits = 0;                   /**< Sensor conversions saved by the sample cache. */
 
 uint8_t 																		 battery_level=0;                           /**< Battery level variable */
 
@@ -199,6 +211,55 @@ static void alarm_check(void)
     }                                                    
 }
 
+/**@brief Function for comparing a reading with the levels set by the user.
+*
+* @return      RESET_ALARM, SET_ALARM_LOW or SET_ALARM_HIGH.
+*/
+static uint8_t level_alarm_get(uint8_t alarm_set, uint16_t value, uint16_t low_value, uint16_t high_value)
+{
+    if (alarm_set == 0x00)
+    {
+        return RESET_ALARM;
+    }
+    if (value < low_value)
+    {
+        return SET_ALARM_LOW;
+    }
+    if (value > high_value)
+    {
+        return SET_ALARM_HIGH;
+    }
+    return RESET_ALARM;
+}
+
+
+/**@brief Function for getting the alarm state of the readings taken in broadcast mode.
+*
+* @details The readings are compared with the levels and alarm set flags written over GATT in
+*          connectable mode, the same way the alarm services compare them. The alarm services
+*          themselves are not run in broadcast mode, so their alarm values are left unchanged.
+*
+* @param[in]   p_readings   Manufacturer data of the broadcast packet: water presence and water
+*                           level, 1 byte each.
+*
+* @return      Alarm byte, one BROADCAST_ALARM() per reading.
+*/
+uint8_t broadcast_alarm_get(const uint8_t * p_readings)
+{
+    uint8_t alarm = RESET_ALARM;
+
+    if ((m_waterps.water_waterpresence_alarm_set != 0x00) && (p_readings[0] == WATER_NOT_PRESENT))
+    {
+        alarm |= BROADCAST_ALARM(0, SET_ALARM_NO_WATER);
+    }
+    alarm |= BROADCAST_ALARM(1, level_alarm_get(m_waterls.waterl_level_alarm_set,
+                                                p_readings[1],
+                                                m_waterls.waterl_level_low_level,
+                                                m_waterls.waterl_level_high_level));
+    return alarm;
+}
+
+
 /**@brief Function for performing a water parmaters level measurement, and  check for the alarm condition.
 */
 static void water_param_meas_timeout_handler(void * p_context)
@@ -248,6 +309,7 @@ static void real_time_timeout_handler(void * p_context)
     }
 
     //Increment the time stamp
+    m_uptime_seconds++;
     m_time_stamp.seconds += 1;
     if (m_time_stamp.seconds > 59)
     {
@@ -309,6 +371,8 @@ static void timers_init(void)
     real_time_timeout_handler);
     APP_ERROR_CHECK(err_code);
 
+    battery_init();                                  /* Timer of the battery sample under radio load*/
+
 } 
 
 
@@ -368,42 +432,51 @@ static void gap_params_init(void)
 static void advertising_init(void)
 {
     uint32_t      err_code;
-    ble_advdata_t advdata,advdata2;
-    uint8_t       flags = BLE_GAP_ADV_FLAGS_LE_ONLY_GENERAL_DISC_MODE;
+    static uint8_t flags = BLE_GAP_ADV_FLAGS_LE_ONLY_GENERAL_DISC_MODE;
 
     static uint8_t manuf_advertising_data[16] = {0x35, 0xD8, 0xC7, 0xDA, 0x9D, 0x78, 0x43,0xC2, 0xAB,0x2E, 0x0E, 0x48, 0xCA, 0xC2, 0xDB, 0xDA};
-    ble_advdata_manuf_data_t   manuf_data;
+    static ble_advdata_manuf_data_t manuf_data;
 
     manuf_data.company_identifier = COMPANY_IDENTIFER;                           /*COMPANY_IDENTIFIER;*/
     manuf_data.data.size          = 16;
     manuf_data.data.p_data        = manuf_advertising_data;
 
-    ble_uuid_t adv_uuids[] = 
+    static ble_uuid_t adv_uuids[] = 
     {
         {WATER_PROFILE_WATERPS_SERVICE_UUID,                  BLE_UUID_TYPE_BLE},
         {WATER_PROFILE_WATERLS_SERVICE_UUID,									BLE_UUID_TYPE_BLE}, 
     };
 
     // Build and set advertising data
-    memset(&advdata, 0, sizeof(advdata));
-
-    advdata.name_type               = BLE_ADVDATA_FULL_NAME;
-    advdata.include_appearance      = true;
-    advdata.flags.size              = sizeof(flags);
-    advdata.flags.p_data            = &flags;
-    advdata.uuids_complete.uuid_cnt = sizeof(adv_uuids) / sizeof(adv_uuids[0]);
-    advdata.uuids_complete.p_uuids  = adv_uuids;
-
-    memset(&advdata2, 0, sizeof(advdata2));
-
-    advdata2.name_type               = BLE_ADVDATA_NO_NAME;
-    advdata2.include_appearance      = false;
-    advdata2.flags.size              = 0;
-    advdata2.p_manuf_specific_data   = &manuf_data;    
-
-
-
-    err_code = ble_advdata_set(&advdata, &advdata2);
+    memset(&m_advdata, 0, sizeof(m_advdata));
+
+    m_advdata.name_type               = BLE_ADVDATA_FULL_NAME;
+    m_advdata.flags.size              = sizeof(flags);
+    m_advdata.flags.p_data            = &flags;
+
+    memset(&m_srdata, 0, sizeof(m_srdata));
+
+    m_srdata.name_type                = BLE_ADVDATA_NO_NAME;
+    m_srdata.include_appearance       = false;
+    m_srdata.flags.size               = 0;
+    m_srdata.p_manuf_specific_data    = &manuf_data;
+
+#if (LIVE_BEACON_ENABLE == FEATURE_ENABLED)
+    // The sensor readings take the place of the appearance and the service UUIDs, which move to the scan response
+    m_beacon_manuf_data.company_identifier = COMPANY_IDENTIFER;
+    m_beacon_manuf_data.data.size          = sizeof(m_beacon_data);
+    m_beacon_manuf_data.data.p_data        = m_beacon_data;
+
+    m_advdata.p_manuf_specific_data   = &m_beacon_manuf_data;
+    m_srdata.uuids_complete.uuid_cnt  = sizeof(adv_uuids) / sizeof(adv_uuids[0]);
+    m_srdata.uuids_complete.p_uuids   = adv_uuids;
+#else
+    m_advdata.include_appearance      = true;
+    m_advdata.uuids_complete.uuid_cnt = sizeof(adv_uuids) / sizeof(adv_uuids[0]);
+    m_advdata.uuids_complete.p_uuids  = adv_uuids;
+#endif
+
+    err_code = ble_advdata_set(&m_advdata, &m_srdata);
     APP_ERROR_CHECK(err_code);
 
     // Initialize advertising parameters (used when starting advertising)
@@ -417,6 +490,23 @@ static void advertising_init(void)
 }
 
 
+#if (LIVE_BEACON_ENABLE == FEATURE_ENABLED)
+/**@brief Function for refreshing the sensor readings carried in the advertising data.
+*/
+static void beacon_update(void)
+{
+    uint32_t err_code;
+
+    // Same layout as the manufacturer data in broadcast mode
+    m_beacon_data[0] = nrf_gpio_pin_read(WATERP_GPIOTE_PIN);
+    m_beacon_data[1] = read_waterl_level();
+
+    err_code = ble_advdata_set(&m_advdata, &m_srdata);
+    APP_ERROR_CHECK(err_code);
+}
+#endif
+
+
 /**@brief Function for initializing services that will be used by the application.
 *
 * @details Initialize the water alarm and Device Information services.
@@ -927,6 +1017,8 @@ void radio_active_evt_handler(bool radio_active)
 {
     m_radio_event = radio_active;
     ble_flash_on_radio_active_evt(m_radio_event);  /* Call the event handler in ble_flash.c*/
+    radio_notification_callback(radio_active);      /* Schedule a refresh of the broadcast packet*/
+    battery_on_radio_evt(radio_active);             /* Start the pending battery samples*/
 }
 
 /**@brief Function for initializing the Radio Notification events.
@@ -981,12 +1073,14 @@ static void data_log_check()
     }
 }
 
-/**@brief Function for application main entry.
+/**@brief Function for initializing the stack, timers, sensors and services.
+*
+* @details Called once at start-up. Both modes share the SoftDevice, the BLE event dispatch,
+*          Radio Notification, the application timers and the sensor configuration, so
+*          switching modes only swaps the advertising data and parameters.
 */
-void connectable_mode(void)
+void connectable_mode_init(void)
 {
-    uint32_t err_code;
-
     // Initialization.
     ble_stack_init();											        
     timers_init();
@@ -994,12 +1088,28 @@ void connectable_mode(void)
     buttons_init();
     bond_manager_init();
     gap_params_init();
-    advertising_init();
     services_init();
     conn_params_init();
     sec_params_init();
     radio_notification_init();
+}
+
+
+/**@brief Function for application main entry.
+*
+* @details Expects connectable_mode_init() to have been called. Returns once BROADCAST_MODE is
+*          set and no client is connected, with advertising and the measurement timer stopped.
+*/
+void connectable_mode(void)
+{
+    uint32_t err_code;
+
+    gap_params_init();                    /* Restore the name and advertising data replaced in broadcast mode*/
+    advertising_init();
     application_timers_start();   
+#if (LIVE_BEACON_ENABLE == FEATURE_ENABLED)
+    beacon_update();
+#endif
     advertising_start();
 
     // Enter main loop.
@@ -1008,7 +1118,12 @@ void connectable_mode(void)
         // If the broadcast mode flag is true and services are not connected stop advertising and exit
         if((BROADCAST_MODE)  && (!WATERPS_CONNECTED_STATE) && (!WATERLS_CONNECTED_STATE) ) 
         {
+#if (MODE_SWITCH_BENCHMARK_ENABLE == FEATURE_ENABLED)
+            benchmark_start_prescaled(BENCHMARK_PRESCALER_32US);
+#endif
             sd_ble_gap_adv_stop();		     /* Stop advertising */
+            err_code = app_timer_stop(water_measurement_timer);   /* Only the broadcast refresh samples the sensors*/
+            APP_ERROR_CHECK(err_code);
             break;
         }
 
@@ -1069,7 +1184,10 @@ void connectable_mode(void)
         if (CHECK_ALARM_TIMEOUT)                                        /* Check for sensor measurement time-out*/
         {
             alarm_check();
-            battery_start();																					   /* Start battery measurement*/
+            battery_start();                                  /* Report the battery level, sample it at the next radio events*/
+#if (LIVE_BEACON_ENABLE == FEATURE_ENABLED)
+            beacon_update();                                  /* Refresh the readings in the advertising data*/
+#endif
             CHECK_ALARM_TIMEOUT=false;                                  /* Reset the flag*/
         }
 
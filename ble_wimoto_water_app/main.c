@@ -30,9 +30,15 @@
 #include "twi_master.h"
 #include "wimoto_sensors.h"
 #include "wimoto.h"
+#include "benchmark.h"
 
 bool 	  BROADCAST_MODE = false;									/* Flag used to switch between broadcast and connectable modes*/
 
+#if (MODE_SWITCH_BENCHMARK_ENABLE == FEATURE_ENABLED)
+volatile uint32_t m_bench_init_ticks   = 0;                 /**< One time initialization in 32 us ticks, this used to be repeated on every switch to broadcast mode */
+volatile uint32_t m_bench_switch_ticks = 0;                 /**< Switch from connectable to broadcast mode in 32 us ticks, from stopping advertising to broadcasting the first packet */
+#endif
+
 int main()
 {
     /*
@@ -44,6 +50,14 @@ int main()
 
     NRF_POWER->GPREGRET = 0;  /*Initialize the value of general purpose retention register to 0 */
 
+#if (MODE_SWITCH_BENCHMARK_ENABLE == FEATURE_ENABLED)
+    benchmark_start_prescaled(BENCHMARK_PRESCALER_32US);
+#endif
+    connectable_mode_init();  /*Initialize the stack, timers, sensors and services once for both modes */
+#if (MODE_SWITCH_BENCHMARK_ENABLE == FEATURE_ENABLED)
+    m_bench_init_ticks = benchmark_stop();
+#endif
+
     for(;;)
     {			
         connectable_mode();   /* Advertise water parameter alarm service */	